@@ -42,6 +42,12 @@
 #include <stdarg.h>
 #include <list>
 
+#if BUILD_MOVE_SEMANTICS
+#include <utility>
+#include <chrono>
+#include <type_traits>
+#endif
+
 //# if 0 // TBR
 #ifdef WIN32
 #pragma warning (disable:4786)
@@ -73,6 +79,8 @@
    typedef boost::mutex Mutex;
 #endif
 
+   typedef pthread_rwlock_t RwMutex;
+
 
 //-----------------------------------------------------------------------------
 namespace boost { namespace stm {
@@ -108,12 +116,6 @@ enum transaction_state
 
 
 #if BUILD_MOVE_SEMANTICS
-template <class T>
-inline typename std::remove_reference<T>::type&& draco_move(T &&t)
-{
-   return t;
-}
-
 bool const kDracoMoveSemanticsCompiled = true;
 #else
 bool const kDracoMoveSemanticsCompiled = false;
@@ -174,6 +176,12 @@ typedef aborted_transaction_exception aborted_tx;
    inline int trylock(PLOCK &lock) { return pthread_mutex_trylock(&lock); }
    inline int trylock(PLOCK *lock) { return pthread_mutex_trylock(lock); }
 
+   // deadline is absolute, on CLOCK_REALTIME
+   inline int timedlock(PLOCK &lock, timespec const &deadline)
+   { return pthread_mutex_timedlock(&lock, &deadline); }
+   inline int timedlock(PLOCK *lock, timespec const &deadline)
+   { return pthread_mutex_timedlock(lock, &deadline); }
+
    inline int unlock(PLOCK &lock) { return pthread_mutex_unlock(&lock); }
    inline int unlock(PLOCK *lock) { return pthread_mutex_unlock(lock); }
 #endif
@@ -188,6 +196,22 @@ typedef aborted_transaction_exception aborted_tx;
    inline void unlock(PLOCK *lock) { lock->unlock(); }
 #endif
 
+   //--------------------------------------------------------------------------
+   // the absolute CLOCK_REALTIME deadline timeOut from now, as the pthread
+   // timed waits take it
+   //--------------------------------------------------------------------------
+   inline timespec deadline_after(std::chrono::nanoseconds timeOut)
+   {
+      using namespace std::chrono;
+      nanoseconds const deadline =
+         duration_cast<nanoseconds>(system_clock::now().time_since_epoch()) + timeOut;
+
+      timespec ts;
+      ts.tv_sec = deadline.count() / 1000000000;
+      ts.tv_nsec = deadline.count() % 1000000000;
+      return ts;
+   }
+
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -256,16 +280,18 @@ public:
 protected:
 
 #if USE_STM_MEMORY_MANAGER
-    static void return_mem(void *mem, size_t size)
-    {
-      light_auto_lock auto_lock(transactionObjectMutex_);
+   //--------------------------------------------------------------------------
+   // the pool serves allocations from per-thread caches, so no lock is
+   // needed here
+   //--------------------------------------------------------------------------
+   static void return_mem(void *mem, size_t size)
+   {
       memory_.returnChunk(mem, size);
-    }
+   }
 
    static void* retrieve_mem(size_t size)
    {
-     light_auto_lock auto_lock(transactionObjectMutex_);
-     return memory_.retrieveChunk(size);
+      return memory_.retrieveChunk(size);
    }
 #endif // USE_STM_MEMORY_MANAGER
 
@@ -290,8 +316,7 @@ private:
    mutable size_t newMemory_;
 
 #if USE_STM_MEMORY_MANAGER
-   static Mutex transactionObjectMutex_;
-   static MemoryPool<base_transaction_object> memory_;
+   static CachingMemoryPool<base_transaction_object> memory_;
 #endif
 };
 
@@ -310,10 +335,16 @@ public:
    }
 
 #if BUILD_MOVE_SEMANTICS
+   //--------------------------------------------------------------------------
+   // the shadow copy is discarded right after commit, so its state can be
+   // moved into the original rather than copied. a move that may throw could
+   // leave both objects half updated, so only nothrow move assignment is
+   // used; everything else falls back to copy_state
+   //--------------------------------------------------------------------------
    virtual void move_state(base_transaction_object * rhs)
    {
-      static_cast<Derived &>(*this) = draco_move
-         (*(static_cast<Derived*>(rhs)));
+      move_or_copy_state(static_cast<Derived*>(rhs),
+         std::is_nothrow_move_assignable<Derived>());
    }
 #endif
 
@@ -323,11 +354,27 @@ public:
       return retrieve_mem(size);
    }
 
-   void operator delete(void* mem)
+   //--------------------------------------------------------------------------
+   // the sized form receives the size of the dynamic type, which is the size
+   // operator new was called with, so the chunk goes back to its own class
+   //--------------------------------------------------------------------------
+   void operator delete(void* mem, size_t size)
+   {
+      return_mem(mem, size);
+   }
+#endif
+
+#if BUILD_MOVE_SEMANTICS
+private:
+
+   void move_or_copy_state(Derived *rhs, std::true_type)
+   {
+      static_cast<Derived &>(*this) = std::move(*rhs);
+   }
+
+   void move_or_copy_state(Derived *rhs, std::false_type)
    {
-      static Derived elem;
-      static size_t elemSize = sizeof(elem);
-      return_mem(mem, elemSize);
+      copy_state(rhs);
    }
 #endif
 
@@ -375,9 +422,12 @@ public:
    //--------------------------------------------------
    // move semantics
    //--------------------------------------------------
-   native_trans(native_trans &&rhs) { value_ = rhs.value_;}
+   native_trans& operator=(native_trans const &rhs) { value_ = rhs.value_; return *this; }
+
+   native_trans(native_trans &&rhs) : value_(std::move(rhs.value_)) {}
    native_trans& operator=(native_trans &&rhs)
-   { value_ = rhs.value_; return *this; }
+      noexcept(std::is_nothrow_move_assignable<T>::value)
+   { value_ = std::move(rhs.value_); return *this; }
 #endif
 
    T& value() { return value_; }
@@ -422,6 +472,19 @@ public:
    virtual void perform_isolated_tx_wait_priority_promotion(boost::stm::transaction &) = 0;
    virtual void perform_irrevocable_tx_wait_priority_promotion(boost::stm::transaction &) = 0;
 
+   //--------------------------------------------------------------------------
+   // life cycle notifications for managers which keep state per transaction.
+   // on_abort is called from inside the abort, possibly with STM locks held,
+   // so it must not block. on_restart is called by restart() once the
+   // transaction has aborted, with no STM lock held, before it goes back in
+   // flight; it is where a manager may make the transaction wait
+   //--------------------------------------------------------------------------
+   virtual void on_abort(boost::stm::transaction &) {}
+   virtual void on_restart(boost::stm::transaction &) {}
+   virtual void on_commit(boost::stm::transaction &) {}
+
+   virtual char const * name() const { return "DracoSTM"; }
+
    virtual ~base_contention_manager() {};
 };
 
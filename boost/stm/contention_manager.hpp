@@ -80,11 +80,28 @@ public:
    void abort_on_new(boost::stm::transaction const &t) {}
 };
 
+////////////////////////////////////////////////////////////////////////////
+//
+// sleeps or spins for about us microseconds; waits too short for the
+// scheduler to honour are spun
+//
+////////////////////////////////////////////////////////////////////////////
+void backoff_for(uint64 us);
+
+// a pseudo random number which differs between threads backing off together
+uint64 backoff_random(size_t threadId);
+
 ////////////////////////////////////////////////////////////////////////////
 //
 // this class backs off (and sleeps) when aborting. this is commonly known
 // as "exponential backoff" for locking mechanisms.
 //
+// before restarting after an abort the transaction waits a random time
+// below a window which starts at initialSleepTime microseconds and grows
+// by sleepIncrease with each consecutive abort, up to maxIncreases times.
+// the randomness keeps the threads which aborted together from retrying
+// together.
+//
 ////////////////////////////////////////////////////////////////////////////
 class ExceptAndBackOffOnAbortNoticeCM : public boost::stm::base_contention_manager
 {
@@ -92,10 +109,11 @@ public:
 
    ExceptAndBackOffOnAbortNoticeCM(int const initialSleepTime, int const sleepIncrease,
       int const maxIncreases)
-      : sleepTime_(initialSleepTime), kSleepFactorIncrease_(sleepIncrease),
-        kMaxIncreases_(maxIncreases), initialSleepTime_(initialSleepTime)
+      : kSleepFactorIncrease_(sleepIncrease), kMaxIncreases_(maxIncreases),
+        initialSleepTime_(initialSleepTime)
    {
-      kMaxSleepTime_ = kSleepFactorIncrease_ * sleepTime_ * kMaxIncreases_;
+      kMaxSleepTime_ = initialSleepTime_;
+      for (int i = 0; i < kMaxIncreases_; ++i) kMaxSleepTime_ *= kSleepFactorIncrease_;
    }
 
    ////////////////////////////////////////////////////////////////////////////
@@ -339,6 +357,13 @@ public:
    }
 
 
+   virtual char const * name() const;
+
+   virtual void on_restart(boost::stm::transaction &t);
+
+   // the window of the wait after the given number of consecutive aborts
+   uint64 backoff_window_us(size_t aborts) const;
+
    virtual bool allow_lock_to_abort_tx
    (int const & lockWaitTime, int const &lockAborted,
    bool txTryingToAbortIsIrrevocable, boost::stm::transaction const &rhs)
@@ -358,11 +383,359 @@ public:
 
 private:
 
-   int sleepTime_;
    int const kSleepFactorIncrease_;
-   int kMaxSleepTime_;
+   uint64 kMaxSleepTime_;
    int const kMaxIncreases_;
    int const initialSleepTime_;
 };
 
+////////////////////////////////////////////////////////////////////////////
+//
+// the policy contention managers below are the published managers of the
+// DSTM / RSTM literature, adapted to how DracoSTM resolves conflicts: the
+// committing transaction (lhs) asks permission to abort each in-flight
+// transaction it conflicts with (rhs). a committer can not wait while it
+// holds the commit locks, so where the original policy makes the attacker
+// wait, here the committer aborts itself and waits in on_restart() before
+// its next attempt. the state a policy keeps across retries (karma, age)
+// is therefore only kept by transactions which are restarted, as in the
+// atomic macros, rather than destroyed and constructed again.
+//
+////////////////////////////////////////////////////////////////////////////
+class PolicyContentionManager : public boost::stm::DefaultContentionManager
+{
+public:
+
+   //--------------------------------------------------------------------------
+   // the committer may abort the whole list only if it wins against each
+   //--------------------------------------------------------------------------
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &lhs, boost::stm::transaction const &rhs) = 0;
+
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &lhs,
+       std::list<boost::stm::transaction*> &rhs)
+   {
+      for (std::list<boost::stm::transaction*>::iterator i = rhs.begin(); i != rhs.end(); ++i)
+      {
+         if (!permission_to_abort(lhs, **i)) return false;
+      }
+      return true;
+   }
+
+protected:
+
+   // true if lhs began before rhs, the thread id breaks ties
+   static bool older(boost::stm::transaction const &lhs, boost::stm::transaction const &rhs)
+   {
+      if (lhs.begin_stamp() != rhs.begin_stamp()) return lhs.begin_stamp() < rhs.begin_stamp();
+      return lhs.thread_id() < rhs.thread_id();
+   }
+
+   // waits a random time in [0, 2^exponent * kBackoffUnitUs) microseconds
+   static void random_backoff(boost::stm::transaction const &t, size_t exponent);
+
+   static size_t const kBackoffUnitUs = 4;
+   static size_t const kMaxBackoffExponent = 10;
+};
+
+////////////////////////////////////////////////////////////////////////////
+// Aggressive: the committer always aborts the transactions in its way
+////////////////////////////////////////////////////////////////////////////
+class AggressiveCM : public PolicyContentionManager
+{
+public:
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &, boost::stm::transaction const &)
+   { return true; }
+
+   using PolicyContentionManager::permission_to_abort;
+
+   virtual char const * name() const { return "aggressive"; }
+};
+
+////////////////////////////////////////////////////////////////////////////
+// Passive (Scherer and Scott's "timid"): the committer never aborts another
+// transaction, it aborts itself instead
+////////////////////////////////////////////////////////////////////////////
+class PassiveCM : public PolicyContentionManager
+{
+public:
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &, boost::stm::transaction const &)
+   { return false; }
+
+   using PolicyContentionManager::permission_to_abort;
+
+   virtual char const * name() const { return "passive"; }
+};
+
+////////////////////////////////////////////////////////////////////////////
+// Karma (Scherer and Scott): the priority of a transaction is the work it
+// has done, the objects it opened, accumulated over its aborted attempts
+// and reset when it commits. the transaction with more karma wins
+////////////////////////////////////////////////////////////////////////////
+class KarmaCM : public PolicyContentionManager
+{
+public:
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &lhs, boost::stm::transaction const &rhs)
+   { return karma(lhs) >= karma(rhs); }
+
+   using PolicyContentionManager::permission_to_abort;
+
+   virtual void on_abort(boost::stm::transaction &t) { t.set_priority(karma(t)); }
+   virtual void on_commit(boost::stm::transaction &t) { t.set_priority(0); }
+
+   virtual char const * name() const { return "karma"; }
+
+protected:
+
+   static size_t karma(boost::stm::transaction const &t)
+   {
+      return t.priority() + t.attempt_reads() + t.writes();
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////
+// Polka (Scherer and Scott): karma, plus randomized exponential backoff.
+// the attacker backs off once per point of karma it lacks before it aborts
+// its enemy; here every denied commit is one back off, so a committer wins
+// once its consecutive aborts make up for the karma gap
+////////////////////////////////////////////////////////////////////////////
+class PolkaCM : public KarmaCM
+{
+public:
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &lhs, boost::stm::transaction const &rhs)
+   { return karma(lhs) + lhs.consecutive_aborts() >= karma(rhs); }
+
+   using PolicyContentionManager::permission_to_abort;
+
+   virtual void on_restart(boost::stm::transaction &t)
+   {
+      random_backoff(t, t.consecutive_aborts());
+   }
+
+   virtual char const * name() const { return "polka"; }
+};
+
+////////////////////////////////////////////////////////////////////////////
+// Timestamp (Scherer and Scott): the older transaction wins. a younger
+// committer waits a fixed interval per denial and, once an older enemy has
+// held it back kTimestampPatience times, takes it to be defunct and aborts it
+////////////////////////////////////////////////////////////////////////////
+class TimestampCM : public PolicyContentionManager
+{
+public:
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &lhs, boost::stm::transaction const &rhs)
+   {
+      return older(lhs, rhs) || lhs.consecutive_aborts() >= kTimestampPatience;
+   }
+
+   using PolicyContentionManager::permission_to_abort;
+
+   virtual void on_restart(boost::stm::transaction &t);
+
+   virtual char const * name() const { return "timestamp"; }
+
+private:
+
+   static size_t const kTimestampPatience = 16;
+   static size_t const kTimestampWaitUs = 20;
+};
+
+////////////////////////////////////////////////////////////////////////////
+// Greedy (Guerraoui, Herlihy and Pochon): the older transaction always wins
+// and never waits for a younger one, which bounds the time any transaction
+// takes to commit. committers never wait while in flight in DracoSTM, so
+// Greedy's "abort a waiting enemy" rule has nothing to apply to
+////////////////////////////////////////////////////////////////////////////
+class GreedyCM : public PolicyContentionManager
+{
+public:
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &lhs, boost::stm::transaction const &rhs)
+   { return older(lhs, rhs); }
+
+   using PolicyContentionManager::permission_to_abort;
+
+   virtual char const * name() const { return "greedy"; }
+};
+
+////////////////////////////////////////////////////////////////////////////
+// Serializing: a transaction which has aborted takes a global token before
+// it retries and keeps it until it commits or aborts again. retried
+// transactions therefore run one at a time, and the token holder wins
+// every conflict, so it commits unless it aborts itself
+////////////////////////////////////////////////////////////////////////////
+class SerializingCM : public PolicyContentionManager
+{
+public:
+
+   SerializingCM() : owner_(0), ownerThread_(0) {}
+
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &, boost::stm::transaction const &rhs)
+   { return &rhs != owner_.load(std::memory_order_relaxed); }
+
+   using PolicyContentionManager::permission_to_abort;
+
+   // the transaction holding the token, 0 when it is free
+   boost::stm::transaction const * owner() const { return owner_.load(); }
+
+   virtual void on_abort(boost::stm::transaction &t) { release(t); }
+   virtual void on_commit(boost::stm::transaction &t) { release(t); }
+   virtual void on_restart(boost::stm::transaction &t);
+
+   virtual char const * name() const { return "serializing"; }
+
+private:
+
+   void release(boost::stm::transaction const &t)
+   {
+      boost::stm::transaction const *expected = &t;
+      if (owner_.compare_exchange_strong(expected, 0)) ownerThread_.store(0);
+   }
+
+   std::atomic<boost::stm::transaction const*> owner_;
+   std::atomic<size_t> ownerThread_;
+};
+
+////////////////////////////////////////////////////////////////////////////
+//
+// AdaptiveCM switches between registered policies while transactions run.
+// the policies are ordered from the most optimistic to the most
+// conservative; by default aggressive, backoff (polka), priority (greedy)
+// and serializing.
+//
+// every kAdaptiveWindowNs one thread, as it commits or restarts, samples
+// from the bookkeeping the commits, the aborts and the objects opened by
+// committed and by aborted attempts since the last sample. over the last
+// kAdaptiveWindows samples the contention is the larger of the abort ratio
+// and the fraction of the work wasted by aborted attempts. work is counted
+// in objects rather than time so neither the waits a cautious policy adds
+// nor preemption keep a policy in place. the
+// manager moves one policy up when contention stays above kAdaptiveEscalate
+// for kAdaptiveConfirm samples in a row, and one down when it stays below
+// kAdaptiveRelax as long; the gap between the two and the confirmation keep
+// it from flapping.
+//
+// decisions go to the current policy only, but every policy sees the
+// on_abort / on_commit notifications, so the state each keeps per
+// transaction (karma, tokens) stays right across a switch and in-flight
+// transactions never need to be restarted.
+//
+////////////////////////////////////////////////////////////////////////////
+class AdaptiveCM : public boost::stm::base_contention_manager
+{
+public:
+
+   AdaptiveCM();
+   explicit AdaptiveCM(std::vector<boost::stm::base_contention_manager*> const &policies);
+   ~AdaptiveCM();
+
+   boost::stm::base_contention_manager & current() const
+   { return *policies_[current_.load(std::memory_order_relaxed)]; }
+
+   size_t switches() const { return switches_.load(std::memory_order_relaxed); }
+
+   //--------------------------------------------------------------------------
+   // feeds one sample window and moves the policy if the trend asks for it.
+   // the manager feeds the bookkeeping deltas every kAdaptiveWindowNs on its
+   // own, tests feed windows of their choosing
+   //--------------------------------------------------------------------------
+   void add_sample(uint64 commits, uint64 aborts, uint64 committedWork, uint64 abortedWork);
+
+   //--------------------------------------------------------------------------
+   void abort_on_new(boost::stm::transaction const &t) { current().abort_on_new(t); }
+   void abort_on_delete(boost::stm::transaction const &t,
+      boost::stm::base_transaction_object const &in) { current().abort_on_delete(t, in); }
+   void abort_on_read(boost::stm::transaction const &t,
+      boost::stm::base_transaction_object const &in) { current().abort_on_read(t, in); }
+   void abort_on_write(boost::stm::transaction &t,
+      boost::stm::base_transaction_object const &in) { current().abort_on_write(t, in); }
+
+   virtual bool abort_before_commit(boost::stm::transaction const &t)
+   { return current().abort_before_commit(t); }
+
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &lhs, boost::stm::transaction const &rhs)
+   { return current().permission_to_abort(lhs, rhs); }
+
+   virtual bool permission_to_abort
+      (boost::stm::transaction const &lhs, std::list<boost::stm::transaction*> &rhs)
+   { return current().permission_to_abort(lhs, rhs); }
+
+   virtual bool allow_lock_to_abort_tx(int const & lockWaitTime, int const &lockAborted,
+      bool txIsIrrevocable, boost::stm::transaction const &rhs)
+   { return current().allow_lock_to_abort_tx(lockWaitTime, lockAborted, txIsIrrevocable, rhs); }
+
+   virtual int lock_sleep_time() { return current().lock_sleep_time(); }
+
+   virtual void perform_isolated_tx_wait_priority_promotion(boost::stm::transaction &t)
+   { current().perform_isolated_tx_wait_priority_promotion(t); }
+   virtual void perform_irrevocable_tx_wait_priority_promotion(boost::stm::transaction &t)
+   { current().perform_irrevocable_tx_wait_priority_promotion(t); }
+
+   virtual void on_abort(boost::stm::transaction &t)
+   {
+      for (size_t i = 0; i < policies_.size(); ++i) policies_[i]->on_abort(t);
+   }
+
+   virtual void on_commit(boost::stm::transaction &t)
+   {
+      for (size_t i = 0; i < policies_.size(); ++i) policies_[i]->on_commit(t);
+      sample();
+   }
+
+   virtual void on_restart(boost::stm::transaction &t)
+   {
+      sample();
+      current().on_restart(t);
+   }
+
+   virtual char const * name() const { return "adaptive"; }
+
+private:
+
+   struct window
+   {
+      window() : commits_(0), aborts_(0), committedWork_(0), abortedWork_(0) {}
+
+      uint64 commits_;
+      uint64 aborts_;
+      uint64 committedWork_;
+      uint64 abortedWork_;
+   };
+
+   void sample();
+   void take_sample();
+   void adapt(window const &w);
+
+   std::vector<boost::stm::base_contention_manager*> policies_;
+   std::atomic<size_t> current_;
+   std::atomic<size_t> switches_;
+   std::atomic<uint64> lastSample_;
+
+   // only touched by the thread holding sampleMutex_
+   pthread_mutex_t sampleMutex_;
+   window total_;
+   std::vector<window> windows_;
+   size_t nextWindow_;
+   size_t above_;
+   size_t below_;
+
+   static uint64 const kAdaptiveWindowNs = 10000000;
+   static size_t const kAdaptiveWindows = 8;
+   static size_t const kAdaptiveConfirm = 3;
+   static double const kAdaptiveEscalate;
+   static double const kAdaptiveRelax;
+
+   // undefined intentionally
+   AdaptiveCM(AdaptiveCM const &);
+   AdaptiveCM& operator=(AdaptiveCM const &);
+};
+
 #endif // CONTENTION_MANAGER_H
@@ -20,6 +20,8 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <chrono>
 #include <boost/stm/detail/datatypes.hpp>
 #include <boost/stm/base_transaction.hpp>
 
@@ -52,12 +54,16 @@ private:
 };
 
 
+//-----------------------------------------------------------------------------
+// auto_lock keeps the locks each thread holds through it in a small set of
+// the thread's own, so a thread taking a lock it already holds does not take
+// it again. the set is thread specific data, so guards share no bookkeeping
+// across threads.
+//-----------------------------------------------------------------------------
 class auto_lock
 {
 public:
-   typedef std::pair<size_t const, Mutex*> ThreadedLockPair;
-   typedef std::multimap<size_t const, Mutex*> ThreadedLockContainer;
-   typedef ThreadedLockContainer::iterator ThreadedLockIter;
+   typedef std::vector<Mutex*> ThreadLocks;
 
    auto_lock(Mutex &mutex) : donePostStep_(false), hasLock_(false), lock_(NULL)
    {
@@ -70,14 +76,32 @@ public:
    }
 
 
+   //--------------------------------------------------------------------------
+   // timed locks throw timer_lock_exception if the mutex is not obtained
+   // within timeOut, given in milliseconds or as a std::chrono duration
+   //--------------------------------------------------------------------------
    auto_lock(size_t timeOut, Mutex &mutex) : donePostStep_(false), hasLock_(false), lock_(NULL)
    {
-      do_timed_auto_lock(timeOut, &mutex);
+      do_timed_auto_lock(std::chrono::milliseconds(timeOut), &mutex);
    }
 
    auto_lock(size_t timeOut, Mutex *mutex) : donePostStep_(false), hasLock_(false), lock_(NULL)
    {
-      do_timed_auto_lock(timeOut, mutex);
+      do_timed_auto_lock(std::chrono::milliseconds(timeOut), mutex);
+   }
+
+   template <typename Rep, typename Period>
+   auto_lock(std::chrono::duration<Rep, Period> const &timeOut, Mutex &mutex) : 
+      donePostStep_(false), hasLock_(false), lock_(NULL)
+   {
+      do_timed_auto_lock(std::chrono::duration_cast<std::chrono::nanoseconds>(timeOut), &mutex);
+   }
+
+   template <typename Rep, typename Period>
+   auto_lock(std::chrono::duration<Rep, Period> const &timeOut, Mutex *mutex) : 
+      donePostStep_(false), hasLock_(false), lock_(NULL)
+   {
+      do_timed_auto_lock(std::chrono::duration_cast<std::chrono::nanoseconds>(timeOut), mutex);
    }
 
    ~auto_lock() { do_auto_unlock(); }
@@ -105,32 +129,42 @@ public:
 
 private:
 
-   void do_timed_auto_lock(size_t timeOut, Mutex *mutex)
+   void do_timed_auto_lock(std::chrono::nanoseconds timeOut, Mutex *mutex)
    {
+      using namespace std::chrono;
+
       lock_ = mutex;
 
       if (thread_has_lock(mutex)) return;
 
-      for (size_t i = 0; i < timeOut; ++i)
+#ifndef BOOST_STM_USE_BOOST_MUTEX
+      //-----------------------------------------------------------------------
+      // the mutex is tried once even if the deadline has passed, as
+      // pthread_mutex_timedlock() does
+      //-----------------------------------------------------------------------
+      if (0 != timedlock(lock_, deadline_after(timeOut))) throw timer_lock_exception( "lock timed out" );
+#else
+      nanoseconds const deadline = 
+         duration_cast<nanoseconds>(system_clock::now().time_since_epoch()) + timeOut;
+
+      while (!trylock(lock_))
       {
-         if (0 == trylock(lock_))
+         if (duration_cast<nanoseconds>(system_clock::now().time_since_epoch()) >= deadline)
          {
-            hasLock_ = true;
-            insert_into_threaded_lock_map(mutex);
-            return;
+            throw timer_lock_exception( "lock timed out" );
          }
 
          SLEEP(1);
       }
+#endif
 
-      throw timer_lock_exception( "lock timed out" );
+      hasLock_ = true;
+      insert_into_threaded_lock_map(mutex);
    }
 
    void insert_into_threaded_lock_map(Mutex* mutex)
    {
-      lock(global_lock());
-      threaded_locks().insert(ThreadedLockPair(THREAD_ID, mutex));
-      unlock(global_lock());
+      thread_locks().push_back(mutex);
    }
 
    void do_auto_lock(Mutex *mutex)
@@ -156,53 +190,60 @@ private:
 
    bool thread_has_lock(Mutex *rhs)
    {
-      lock(global_lock());
+      ThreadLocks &locks = thread_locks();
+      return locks.end() != std::find(locks.begin(), locks.end(), rhs);
+   }
+
+   void remove_thread_has_lock(Mutex *rhs)
+   {
+      ThreadLocks &locks = thread_locks();
 
-      for (ThreadedLockIter i = threaded_locks().begin(); 
-      i != threaded_locks().end(); ++i)
+      //------------------------------------------------------------------------
+      // guards are released in the reverse order they were taken in, so the
+      // lock is usually the last one
+      //------------------------------------------------------------------------
+      for (ThreadLocks::size_type i = locks.size(); i > 0; --i)
       {
-         if (i->first == THREAD_ID && i->second == rhs)
+         if (locks[i - 1] == rhs)
          {
-            unlock(global_lock());
-            return true;
+            locks.erase(locks.begin() + (i - 1));
+            break;
          }
       }
-
-      unlock(global_lock());
-      return false;
    }
 
-   void remove_thread_has_lock(Mutex *rhs)
+   //---------------------------------------------------------------------------
+   // the locks of the calling thread, made on its first guard and deleted
+   // when it exits
+   //---------------------------------------------------------------------------
+   static ThreadLocks &thread_locks()
    {
-      lock(global_lock());
+      static pthread_key_t const key = new_thread_locks_key();
 
-      for (ThreadedLockIter i = threaded_locks().begin(); 
-      i != threaded_locks().end(); ++i)
+      ThreadLocks *locks = static_cast<ThreadLocks*>(pthread_getspecific(key));
+
+      if (0 == locks)
       {
-         if (i->first == THREAD_ID && i->second == rhs)
-         {
-            threaded_locks().erase(i);
-            break;
-         }
+         locks = new ThreadLocks;
+         pthread_setspecific(key, locks);
       }
 
-      unlock(global_lock());
+      return *locks;
    }
 
-   static Mutex *global_lock()
+   static pthread_key_t new_thread_locks_key()
    {
-#ifndef BOOST_STM_USE_BOOST_MUTEX
-      static Mutex globalLock = PTHREAD_MUTEX_INITIALIZER;
-#else
-      static Mutex globalLock;
-#endif       
-      return &globalLock;
+      pthread_key_t key;
+      if (0 != pthread_key_create(&key, delete_thread_locks))
+      {
+         throw "unable to create the auto_lock thread locks key";
+      }
+      return key;
    }
 
-   static ThreadedLockContainer &threaded_locks()
+   static void delete_thread_locks(void *locks)
    {
-      static ThreadedLockContainer localThreadedLocks;
-      return localThreadedLocks;
+      delete static_cast<ThreadLocks*>(locks);
    }
 
    //auto_lock(auto_lock const &);
@@ -213,6 +254,83 @@ private:
    Mutex *lock_;
 };
 
+#if PERFORMING_LATM
+//-----------------------------------------------------------------------------
+// elided_lock runs the critical section of a lock as an attempt of the given
+// transaction rather than taking the lock. the lock is made a conflicting
+// lock of the transaction (tm or tx lock protection; under full protection
+// every lock is), so a thread really taking it aborts the section. once the
+// transaction has aborted transaction::lock_elision_retries() times in a
+// row, or if it is irrevocable, the attempt takes the lock inside the
+// transaction with the LATM semantics in use. the data the section shares
+// must be accessed through the transaction.
+//-----------------------------------------------------------------------------
+class elided_lock
+{
+public:
+
+   elided_lock(transaction &t, Mutex &mutex) : hasLock_(false), lock_(NULL)
+   {
+      do_elided_lock(t, &mutex);
+   }
+
+   elided_lock(transaction &t, Mutex *mutex) : hasLock_(false), lock_(NULL)
+   {
+      do_elided_lock(t, mutex);
+   }
+
+   ~elided_lock() { do_unlock(); }
+
+   // true if this attempt took the lock rather than eliding it
+   bool has_lock() const { return hasLock_; }
+
+   //--------------------------------------------------------------------------
+   // under tm lock protection the lock is made tm conflicting before the
+   // transaction begins: tm_lock_conflict() waits for latmMutex_, which a
+   // direct updating locker holds until the in-flight transactions are gone
+   //--------------------------------------------------------------------------
+   static bool tm_lock_conflict(Mutex &mutex) { return tm_lock_conflict(&mutex); }
+
+   static bool tm_lock_conflict(Mutex *mutex)
+   {
+      transaction::tm_lock_conflict(mutex);
+      return true;
+   }
+
+private:
+
+   void do_elided_lock(transaction &t, Mutex *mutex)
+   {
+      lock_ = mutex;
+
+#if USING_TRANSACTION_SPECIFIC_LATM
+      if (transaction::doing_tx_lock_protection()) t.lock_conflict(mutex);
+#endif
+
+      if (t.irrevocable() || t.consecutive_aborts() >= transaction::lock_elision_retries())
+      {
+         transaction::lock_(mutex);
+         hasLock_ = true;
+      }
+   }
+
+   void do_unlock()
+   {
+      if (hasLock_)
+      {
+         hasLock_ = false;
+         transaction::unlock_(lock_);
+      }
+   }
+
+   elided_lock(elided_lock const &);
+   elided_lock& operator=(elided_lock const &);
+
+   bool hasLock_;
+   Mutex *lock_;
+};
+#endif
+
 #define use_lock(L) if (0 != rand()+1) for (boost::stm::auto_lock ___l(L); !___l.done_post_step(); ___l.post_step())
 #define use_timed_lock(T, L) if (0 != rand()+1) for (boost::stm::auto_lock ___l(T, L); !___l.done_post_step(); ___l.post_step())
 
@@ -220,6 +338,15 @@ private:
 #define catch_lock_timeout(E) } catch (boost::stm::timer_lock_exception &E)
 #define lock_timeout } catch (boost::stm::timer_lock_exception &E)
 
+//-----------------------------------------------------------------------------
+// use_elided_lock(T, L) { ... } end_elided_lock - the critical section of L
+// run as the atomic block of transaction T, see elided_lock
+//-----------------------------------------------------------------------------
+#if PERFORMING_LATM
+#define use_elided_lock(T, L) if (!boost::stm::elided_lock::tm_lock_conflict(L)) {} else atomic(T) { boost::stm::elided_lock ___l(T, L);
+#define end_elided_lock } end_atom
+#endif
+
 } // core namespace 
 }
 
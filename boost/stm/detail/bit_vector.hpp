@@ -18,6 +18,7 @@
 #include <cstdio>
 #include <math.h>
 #include <iostream>
+#include <atomic>
 
 //---------------------------------------------------------------------------
 // smaller allocation size: potentially more conflicts but more chance to
@@ -36,6 +37,10 @@
 namespace boost { namespace stm {
 
 //---------------------------------------------------------------------------
+// one thread at a time sets the bits of a bit_vector, but other threads may
+// test them while it does: a LATM locker looks at the blooms of the in-flight
+// txs. the chunks are relaxed atomics, which costs plain loads and stores;
+// the ordering the locker needs comes from its own fences
 //---------------------------------------------------------------------------
 class bit_vector
 {
@@ -65,7 +70,7 @@ public:
       const chunk_type chunk_bit_pos = idx_to_chunk_idx(idx);
       // (3) perform bitwise AND, this'll leave "chunk_bit_pos" set to 1 if
       //     the bits_ array has a 1 in the specific bit location
-      const chunk_type new_chunk = bits_[bit_idx] & ((chunk_type)1 << chunk_bit_pos);
+      const chunk_type new_chunk = load(bit_idx) & ((chunk_type)1 << chunk_bit_pos);
       // (4) shift it back to the first bit location so we return a 0 or 1
       //     it is probably better than casting to bool here, since the
       //     compiler would have to perform a comparison
@@ -77,7 +82,10 @@ public:
    //------------------------------------------------------------------------
    void clear()
    {
-      memset(bits_, 0, sizeof(bits_));
+      for (size_t i = 0; i < sizeof(bits_)/sizeof(bits_[0]); ++i)
+      {
+         bits_[i].store(0, std::memory_order_relaxed);
+      }
    }
 
    //------------------------------------------------------------------------
@@ -101,7 +109,7 @@ public:
      const chunk_type chunk_bit_pos = idx_to_chunk_idx(idx);
      // (3) perform bitwise AND, this'll leave "chunk_bit_pos" set to 1 if
      //     the bits_ array has a 1 in the specific bit location
-      bits_[bit_idx] |=  ((chunk_type)1 << chunk_bit_pos);
+      store(bit_idx, load(bit_idx) | ((chunk_type)1 << chunk_bit_pos));
    }
 
    //------------------------------------------------------------------------
@@ -111,7 +119,7 @@ public:
    {
       // Compute a mask by first having the target bit set to 1 and reversing
       chunk_type mask = ~((chunk_type)1 << (idx & chunk_shift_bits));
-      bits_[idx_to_bit_idx(idx)] &= mask;
+      store(idx_to_bit_idx(idx), load(idx_to_bit_idx(idx)) & mask);
    }
 
    //------------------------------------------------------------------------
@@ -127,13 +135,24 @@ public:
    {
       for (register size_t i = 0; i < sizeof(bits_)/sizeof(bits_[0]); ++i)
       {
-         if (bits_[i] & rhs.bits_[i]) return 1;
+         if (load(i) & rhs.load(i)) return 1;
       }
 
       return 0;
    }
 
 private:
+   chunk_type load(size_t const i) const
+   {
+      return bits_[i].load(std::memory_order_relaxed);
+   }
+
+   // only the thread owning the bits sets them, so no read-modify-write
+   void store(size_t const i, chunk_type const chunk)
+   {
+      bits_[i].store(chunk, std::memory_order_relaxed);
+   }
+
    // Select the correct chunk from the bits_ array.
    static const size_t idx_to_bit_idx(size_t const idx) {
       // Hopefully the compiler generates a shift because sizeof() is
@@ -151,7 +170,7 @@ private:
    // The real array containing the data. Size is know at compile time
    // The "+1" is only useful if "def_bit_vector_size" is not a multiple
    // of sizeof(chunk_type)
-   chunk_type bits_[def_bit_vector_size/sizeof(chunk_type)+1];
+   std::atomic<chunk_type> bits_[def_bit_vector_size/sizeof(chunk_type)+1];
 };
 
 }
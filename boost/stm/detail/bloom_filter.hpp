@@ -51,11 +51,12 @@ public:
 #endif
     {}
    //------------------------------------------------------------------------
+   // the address itself is hashed, not the memory it points to
    //------------------------------------------------------------------------
    void insert(const void *rhs)
    {
       h1_ = h2_ = 0;
-      hashlittle2(rhs, size_of_size_t, &h1_, &h2_);
+      hashlittle2(&rhs, size_of_size_t, &h1_, &h2_);
       bit_vector1_.set( h1_ & bitwiseAndOp );
       bit_vector2_.set( h2_ & bitwiseAndOp );
    }
@@ -65,7 +66,7 @@ public:
    bool exists(const void *rhs)
    {
       h1_ = h2_ = 0;
-      hashlittle2(rhs, size_of_size_t, &h1_, &h2_);
+      hashlittle2(&rhs, size_of_size_t, &h1_, &h2_);
       return bit_vector1_.test( h1_ & bitwiseAndOp ) &&
          bit_vector2_.test( h2_ & bitwiseAndOp );
    }
@@ -33,12 +33,13 @@
 #define PERFORMING_LATM 1
 #define PERFORMING_COMPOSITION 1
 //#define USE_STM_MEMORY_MANAGER 1
-#define BUILD_MOVE_SEMANTICS 0
+#define BUILD_MOVE_SEMANTICS 1
 #define USING_TRANSACTION_SPECIFIC_LATM 1
 #define USE_BLOOM_FILTER 1
 #define PERFORMING_WRITE_BLOOM 1
 //#define ALWAYS_ALLOW_ABORT 1
 //#define LOGGING_BLOCKS 1
+//#define MEASURING_LATENCIES 1
 #define USE_SINGLE_THREAD_CONTEXT_MAP 1
 #define BOOST_STM_TX_CONTAINS_REFERENCES_TO_TSS_FIELDS 1
 #define BOOST_STM_USES_AS_NEW 1
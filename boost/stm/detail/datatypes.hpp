@@ -87,4 +87,7 @@ typedef unsigned short int uint16;
 typedef long int int32;
 typedef unsigned long int uint32;
 
+typedef long long int int64;
+typedef unsigned long long int uint64;
+
 #endif // dataTypes_header_file
@@ -101,6 +101,13 @@ inline bool boost::stm::transaction::def_do_core_full_pthread_lock_mutex
          (*it)->force_to_abort();
       }
 
+      //-----------------------------------------------------------------------
+      // the owner is recorded before the in-flight mutex is released, it
+      // closes the begin gate. a tx going in-flight after the scan would
+      // otherwise not be forced to abort and could commit under the lock
+      //-----------------------------------------------------------------------
+      set_latm_lock_owner(mutex);
+
       unlock_general_access();
       unlock_inflight_access();
    }
@@ -130,7 +137,7 @@ inline int boost::stm::transaction::def_full_pthread_lock_mutex(Mutex *mutex)
 
       t->commit_deferred_update_tx();
       lock_latm_access();
-      latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+      set_latm_lock_owner(mutex);
       unlock_latm_access();
 
       // TBR if (hadLock) return 0;
@@ -174,7 +181,7 @@ inline int boost::stm::transaction::def_full_pthread_lock_mutex(Mutex *mutex)
       ++aborted;
    }
 
-   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   set_latm_lock_owner(mutex);
    unlock(&latmMutex_);
    return 0;
 }
@@ -186,19 +193,40 @@ inline int boost::stm::transaction::def_full_pthread_trylock_mutex(Mutex *mutex)
 {
    if (transaction* t = get_inflight_tx_of_same_thread(false))
    {
-      t->make_isolated();
-
+      //-----------------------------------------------------------------------
+      // nothing here may wait, so the lock is tried before the tx is made
+      // isolated: a busy lock leaves the other in-flight txs untouched
+      //-----------------------------------------------------------------------
       bool hadLock = t->is_currently_locked_lock(mutex);
+      if (!hadLock)
+      {
+         int val = trylock(mutex);
+         if (0 != val) return val;
+      }
+
+      bool isolated = false;
+      try { isolated = t->try_make_isolated(); }
+      catch (...)
+      {
+         if (!hadLock) unlock(mutex);
+         throw;
+      }
+
+      if (!isolated)
+      {
+         if (!hadLock) unlock(mutex);
+         return EBUSY;
+      }
+
       t->add_to_currently_locked_locks(mutex);
       t->add_to_obtained_locks(mutex);
 
       t->commit_deferred_update_tx();
       lock_latm_access();
-      latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+      set_latm_lock_owner(mutex);
       unlock_latm_access();
 
-      if (hadLock) return 0;
-      else return trylock(mutex);
+      return 0;
    }
 
    int val = trylock(mutex);
@@ -215,7 +243,7 @@ inline int boost::stm::transaction::def_full_pthread_trylock_mutex(Mutex *mutex)
       {
          unlock(mutex);
          unlock(&latmMutex_);
-         return -1;
+         return EBUSY;
       }
    }
    catch (...)
@@ -225,7 +253,7 @@ inline int boost::stm::transaction::def_full_pthread_trylock_mutex(Mutex *mutex)
       throw;
    }
 
-   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   set_latm_lock_owner(mutex);
    unlock(&latmMutex_);
    // note: we do not release the transactionsInFlightMutex - this will prevents 
    // new transactions from starting until this lock is released
@@ -256,9 +284,7 @@ inline int boost::stm::transaction::def_full_pthread_unlock_mutex(Mutex *mutex)
 
    latmLockedLocks_.erase(mutex);
 
-   if (latmLockedLocks_.empty()) unlock_inflight_access();
-
-   latmLockedLocksOfThreadMap_.erase(mutex);
+   clear_latm_lock_owner(mutex);
    unlock(&latmMutex_);
 
    // TBR if (hasLock) return unlock(mutex);
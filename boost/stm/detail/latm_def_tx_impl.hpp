@@ -68,68 +68,16 @@ inline bool boost::stm::transaction::def_do_core_tx_conflicting_lock_pthread_loc
    //--------------------------------------------------------------------------
    var_auto_lock<PLOCK> autolock(general_lock(), inflight_lock(), 0);
 
-   std::list<transaction *> txList;
-   std::set<size_t> txThreadId;
-
-   for (InflightTxes::iterator i = transactionsInFlight_.begin(); 
-      i != transactionsInFlight_.end(); ++i)
+   if (!abort_txs_conflicting_with_latm_lock(mutex, lockWaitTime, lockAborted, txIsIrrevocable))
    {
-      transaction *t = (transaction*)*i;
-
-      // if this tx is part of this thread, skip it (it's an LiT)
-      if (t->threadId_ == THREAD_ID) continue;
-
-      // if this mutex has a conflict with an inflight tx
-      if (t->get_tx_conflicting_locks().find(mutex) != t->get_tx_conflicting_locks().end())
-      {
-         if (txIsIrrevocable || (!t->irrevocable() && 
-            cm_->allow_lock_to_abort_tx(lockWaitTime, lockAborted, txIsIrrevocable, *t)))
-         {
-            txList.push_back(t);
-         }
-         else return false;
-      }
+      return false;
    }
 
-   if (!txList.empty()) 
-   {
 #if LOGGING_BLOCKS
-      logFile_ << "----------------------\nbefore locked mutex: " << mutex << endl << endl;
-      logFile_ << outputBlockedThreadsAndLockedLocks() << endl;
+   logFile_ << "----------------------\nafter locked mutex: " << mutex << endl << endl;
+   logFile_ << outputBlockedThreadsAndLockedLocks() << endl;
 #endif
 
-      for (std::list<transaction*>::iterator it = txList.begin(); txList.end() != it; ++it)
-      {
-         transaction *t = (transaction*)*it;
-
-         t->force_to_abort();
-         t->block();
-         txThreadId.insert(t->threadId_);
-      }
-
-      try { 
-         latmLockedLocksAndThreadIdsMap_.insert
-         (std::make_pair<Mutex*, ThreadIdSet>(mutex, txThreadId)); 
-      }
-      catch (...) 
-      { 
-         for (std::set<size_t>::iterator it = txThreadId.begin(); 
-         txThreadId.end() != it; ++it) 
-         {
-            if (0 == thread_id_occurance_in_locked_locks_map(*it))
-            {
-               blocked(*it) = false;
-            }
-         }
-         throw; 
-      }
-
-#if LOGGING_BLOCKS
-      logFile_ << "----------------------\nafter locked mutex: " << mutex << endl << endl;
-      logFile_ << outputBlockedThreadsAndLockedLocks() << endl;
-#endif
-   }
-
    return true;
 }
 
@@ -163,7 +111,7 @@ inline int boost::stm::transaction::def_tx_conflicting_lock_pthread_lock_mutex(M
    if (transaction* t = get_inflight_tx_of_same_thread(false))
    {
       t->must_be_in_conflicting_lock_set(mutex);
-      t->make_irrevocable();
+      t->make_irrevocable_unless_aborted();
 
       if (!t->is_currently_locked_lock(mutex))
       {
@@ -215,7 +163,7 @@ inline int boost::stm::transaction::def_tx_conflicting_lock_pthread_lock_mutex(M
       ++aborted;
    }
 
-   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   set_latm_lock_owner(mutex);
    unlock(&latmMutex_);
 
    // note: we do not release the transactionsInFlightMutex - this will prevents 
@@ -229,35 +177,62 @@ inline int boost::stm::transaction::def_tx_conflicting_lock_pthread_lock_mutex(M
 inline int boost::stm::transaction::def_tx_conflicting_lock_pthread_trylock_mutex(Mutex *mutex)
 {
    //--------------------------------------------------------------------------
+   // as pthread_lock, but nothing here may wait. the lock is tried before the
+   // tx is made irrevocable, which is safe as neither step stalls, and a busy
+   // result leaves the other in-flight txs untouched
+   //--------------------------------------------------------------------------
+   if (transaction* t = get_inflight_tx_of_same_thread(false))
+   {
+      t->must_be_in_conflicting_lock_set(mutex);
 
-   throw "might not be possible to implement trylock for this";
-
-   bool txIsIrrevocable = false;
+      bool hadLock = t->is_currently_locked_lock(mutex);
+      if (!hadLock)
+      {
+         int val = trylock(mutex);
+         if (0 != val) return val;
+      }
 
-   int val = trylock(mutex);
-   if (0 != val) return val;
+      if (!t->try_make_irrevocable())
+      {
+         if (!hadLock) unlock(mutex);
+         return EBUSY;
+      }
 
-   lock(&latmMutex_);
+      if (t->forced_to_abort())
+      {
+         if (!hadLock) unlock(mutex);
+         t->lock_and_abort();
+         throw aborted_transaction_exception
+         ("aborting tx forced to abort before obtaining lock");
+      }
 
-   if (transaction* t = get_inflight_tx_of_same_thread(false))
-   {
-      txIsIrrevocable = true;
-      t->must_be_in_conflicting_lock_set(mutex);
-      t->make_irrevocable();
+      t->add_to_currently_locked_locks(mutex);
       t->add_to_obtained_locks(mutex);
       t->commit_deferred_update_tx();
+
+      lock(&latmMutex_);
+      def_do_core_tx_conflicting_lock_pthread_lock_mutex
+         (mutex, 0, 0, true);
+      unlock(&latmMutex_);
+
+      return 0;
    }
 
+   int val = trylock(mutex);
+   if (0 != val) return val;
+
+   lock(&latmMutex_);
+
    try 
    { 
       //-----------------------------------------------------------------------
       // if !core done, since trylock, we cannot stall & retry - just exit
       //-----------------------------------------------------------------------
-      if (!def_do_core_tx_conflicting_lock_pthread_lock_mutex(mutex, 0, 0, txIsIrrevocable)) 
+      if (!def_do_core_tx_conflicting_lock_pthread_lock_mutex(mutex, 0, 0, false)) 
       {
          unlock(mutex);
          unlock(&latmMutex_);
-         return -1;
+         return EBUSY;
       }
    }
    catch (...)
@@ -267,9 +242,8 @@ inline int boost::stm::transaction::def_tx_conflicting_lock_pthread_trylock_mute
       throw;
    }
 
-   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   set_latm_lock_owner(mutex);
    unlock(&latmMutex_);
-
    // note: we do not release the transactionsInFlightMutex - this will prevents 
    // new transactions from starting until this lock is released
    return 0;
@@ -297,6 +271,9 @@ inline int boost::stm::transaction::def_tx_conflicting_lock_pthread_unlock_mutex
       t->remove_from_currently_locked_locks(mutex);
    }
 
+   // the objects bound to the mutex may be touched again
+   release_latm_protected_lock(mutex);
+
    //--------------------------------------------------------------------------
    // if this mutex is on the tmConflictingLocks_ set, then we need to remove
    // it from the latmLocks and any txs on the full thread list that are
@@ -308,7 +285,10 @@ inline int boost::stm::transaction::def_tx_conflicting_lock_pthread_unlock_mutex
       logFile_ << "----------------------\nbefore unlocked mutex: " << mutex << endl << endl;
       logFile_ << outputBlockedThreadsAndLockedLocks() << endl;
 #endif
-      latmLockedLocksAndThreadIdsMap_.erase(mutex);
+      {
+         var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+         unblock_threads_on_latm_lock(mutex);
+      }
       unblock_conflicting_threads(mutex);
 
 #if LOGGING_BLOCKS
@@ -317,7 +297,7 @@ inline int boost::stm::transaction::def_tx_conflicting_lock_pthread_unlock_mutex
 #endif
    }
 
-   latmLockedLocksOfThreadMap_.erase(mutex);
+   clear_latm_lock_owner(mutex);
    unblock_threads_if_locks_are_empty();
 
    // TBR if (hasLock) return unlock(mutex);
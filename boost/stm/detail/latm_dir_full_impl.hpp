@@ -66,7 +66,7 @@
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
 inline bool boost::stm::transaction::dir_do_core_full_pthread_lock_mutex
-(Mutex *mutex, int lockWaitTime, int lockAborted)
+(Mutex *mutex, int lockWaitTime, int lockAborted, bool blocking)
 {
    //--------------------------------------------------------------------------
    // if the lock-aware tm lock set is empty, lock the in-flight trans mutex
@@ -77,6 +77,14 @@ inline bool boost::stm::transaction::dir_do_core_full_pthread_lock_mutex
       lock_general_access();
       lock_inflight_access();
 
+      // the in-flight txs would have to be waited for
+      if (!blocking && !transactionsInFlight_.empty())
+      {
+         unlock_general_access();
+         unlock_inflight_access();
+         return false;
+      }
+
       std::list<transaction*> txList;
       for (InflightTxes::iterator i = transactionsInFlight_.begin(); 
          i != transactionsInFlight_.end(); ++i)
@@ -113,7 +121,7 @@ inline bool boost::stm::transaction::dir_do_core_full_pthread_lock_mutex
       // now we must stall until all in-flight transactions are gone, otherwise 
       // global memory may still be in an inconsistent state
       //-----------------------------------------------------------------------
-      while (!transactionsInFlight_.empty()) { SLEEP(10); }
+      if (!wait_until_in_flight_txs_are_gone()) return false;
    }
 
    try { latmLockedLocks_.insert(mutex); }
@@ -142,7 +150,7 @@ inline int boost::stm::transaction::dir_full_pthread_lock_mutex(Mutex *mutex)
 
       // this method locks LATM and keeps it locked upon returning if param true
       wait_until_all_locks_are_released(true);
-      latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+      set_latm_lock_owner(mutex);
       unlock_latm_access();
 
       if (hadLock) return 0;
@@ -184,7 +192,7 @@ inline int boost::stm::transaction::dir_full_pthread_lock_mutex(Mutex *mutex)
       ++aborted;
    }
 
-   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   set_latm_lock_owner(mutex);
    unlock(&latmMutex_);
    return 0;
 }
@@ -196,19 +204,43 @@ inline int boost::stm::transaction::dir_full_pthread_trylock_mutex(Mutex *mutex)
 {
    if (transaction* t = get_inflight_tx_of_same_thread(false))
    {
-      t->make_isolated();
-
+      //-----------------------------------------------------------------------
+      // nothing here may wait, so the lock is tried before the tx is made
+      // isolated: a busy lock leaves the other in-flight txs untouched
+      //-----------------------------------------------------------------------
       bool hadLock = t->is_currently_locked_lock(mutex);
+      if (!hadLock)
+      {
+         int val = trylock(mutex);
+         if (0 != val) return val;
+      }
+
+      // pthread_lock waits for the other latm locks to be released
+      lock_latm_access();
+
+      bool isolated = false;
+      try { isolated = latmLockedLocks_.empty() && t->try_make_isolated(); }
+      catch (...)
+      {
+         unlock_latm_access();
+         if (!hadLock) unlock(mutex);
+         throw;
+      }
+
+      if (!isolated)
+      {
+         unlock_latm_access();
+         if (!hadLock) unlock(mutex);
+         return EBUSY;
+      }
+
       t->add_to_currently_locked_locks(mutex);
       t->add_to_obtained_locks(mutex);
 
-      // this method locks LATM and keeps it locked upon returning if param true
-      wait_until_all_locks_are_released(true);
-      latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+      set_latm_lock_owner(mutex);
       unlock_latm_access();
 
-      if (hadLock) return 0;
-      else return trylock(mutex);
+      return 0;
    }
 
    int val = trylock(mutex);
@@ -221,11 +253,11 @@ inline int boost::stm::transaction::dir_full_pthread_trylock_mutex(Mutex *mutex)
       //-----------------------------------------------------------------------
       // if !core done, since trylock, we cannot stall & retry - just exit
       //-----------------------------------------------------------------------
-      if (!dir_do_core_full_pthread_lock_mutex(mutex, 0, 0)) 
+      if (!dir_do_core_full_pthread_lock_mutex(mutex, 0, 0, false)) 
       {
          unlock(mutex);
          unlock(&latmMutex_);
-         return -1;
+         return EBUSY;
       }
    }
    catch (...)
@@ -235,7 +267,7 @@ inline int boost::stm::transaction::dir_full_pthread_trylock_mutex(Mutex *mutex)
       throw;
    }
 
-   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   set_latm_lock_owner(mutex);
    unlock(&latmMutex_);
    // note: we do not release the transactionsInFlightMutex - this will prevents 
    // new transactions from starting until this lock is released
@@ -275,7 +307,7 @@ inline int boost::stm::transaction::dir_full_pthread_unlock_mutex(Mutex *mutex)
       unlock_general_access();
    }
 
-   latmLockedLocksOfThreadMap_.erase(mutex);
+   clear_latm_lock_owner(mutex);
    unlock(&latmMutex_);
 
    // TBR if (hasLock) return unlock(mutex);
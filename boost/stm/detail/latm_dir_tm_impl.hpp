@@ -67,7 +67,7 @@
 //
 //----------------------------------------------------------------------------
 inline bool boost::stm::transaction::dir_do_core_tm_conflicting_lock_pthread_lock_mutex
-(Mutex *mutex, int lockWaitTime, int lockAborted)
+(Mutex *mutex, int lockWaitTime, int lockAborted, bool blocking)
 {
    //--------------------------------------------------------------------------
    // if this mutex is on the tmConflictingLocks_ set, then we need to stop
@@ -86,6 +86,14 @@ inline bool boost::stm::transaction::dir_do_core_tm_conflicting_lock_pthread_loc
          lock_general_access();
          lock_inflight_access();
 
+         // the in-flight txs would have to be waited for
+         if (!blocking && !transactionsInFlight_.empty())
+         {
+            unlock_general_access();
+            unlock_inflight_access();
+            return false;
+         }
+
          std::list<transaction*> txList;
          for (InflightTxes::iterator i = transactionsInFlight_.begin(); 
             i != transactionsInFlight_.end(); ++i)
@@ -122,7 +130,7 @@ inline bool boost::stm::transaction::dir_do_core_tm_conflicting_lock_pthread_loc
          // now we must stall until all in-flight transactions are gone, otherwise 
          // global memory may still be in an inconsistent state
          //-----------------------------------------------------------------------
-         while (!transactionsInFlight_.empty()) { SLEEP(10); }
+         if (!wait_until_in_flight_txs_are_gone()) return false;
       }
 
       latmLockedLocks_.insert(mutex);
@@ -141,10 +149,16 @@ dir_tm_conflicting_lock_pthread_lock_mutex(Mutex *mutex)
    {
       transaction::must_be_in_tm_conflicting_lock_set(mutex);
       t->make_isolated();
+
+      bool hadLock = t->is_currently_locked_lock(mutex);
+      t->add_to_currently_locked_locks(mutex);
+      t->add_to_obtained_locks(mutex);
+
       lock_latm_access();
-      latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+      set_latm_lock_owner(mutex);
       unlock_latm_access();
-      lock(mutex);
+
+      if (!hadLock) lock(mutex);
       return 0;
    }
 
@@ -184,7 +198,7 @@ dir_tm_conflicting_lock_pthread_lock_mutex(Mutex *mutex)
       ++aborted;
    }
 
-   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   set_latm_lock_owner(mutex);
    unlock(&latmMutex_);
 
    return 0;
@@ -199,11 +213,40 @@ dir_tm_conflicting_lock_pthread_trylock_mutex(Mutex *mutex)
    if (transaction* t = get_inflight_tx_of_same_thread(false))
    {
       transaction::must_be_in_tm_conflicting_lock_set(mutex);
-      t->make_isolated();
+
+      //-----------------------------------------------------------------------
+      // nothing here may wait, so the lock is tried before the tx is made
+      // isolated: a busy lock leaves the other in-flight txs untouched
+      //-----------------------------------------------------------------------
+      bool hadLock = t->is_currently_locked_lock(mutex);
+      if (!hadLock)
+      {
+         int val = trylock(mutex);
+         if (0 != val) return val;
+      }
+
+      bool isolated = false;
+      try { isolated = t->try_make_isolated(); }
+      catch (...)
+      {
+         if (!hadLock) unlock(mutex);
+         throw;
+      }
+
+      if (!isolated)
+      {
+         if (!hadLock) unlock(mutex);
+         return EBUSY;
+      }
+
+      t->add_to_currently_locked_locks(mutex);
+      t->add_to_obtained_locks(mutex);
+
       lock_latm_access();
-      latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+      set_latm_lock_owner(mutex);
       unlock_latm_access();
-      return trylock(mutex);
+
+      return 0;
    }
 
    int val = trylock(mutex);
@@ -216,11 +259,11 @@ dir_tm_conflicting_lock_pthread_trylock_mutex(Mutex *mutex)
       //-----------------------------------------------------------------------
       // if !core done, since trylock, we cannot stall & retry - just exit
       //-----------------------------------------------------------------------
-      if (!dir_do_core_tm_conflicting_lock_pthread_lock_mutex(mutex, 0, 0)) 
+      if (!dir_do_core_tm_conflicting_lock_pthread_lock_mutex(mutex, 0, 0, false)) 
       {
          unlock(mutex);
          unlock(&latmMutex_);
-         return -1;
+         return EBUSY;
       }
    }
    catch (...)
@@ -230,7 +273,7 @@ dir_tm_conflicting_lock_pthread_trylock_mutex(Mutex *mutex)
       throw;
    }
 
-   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   set_latm_lock_owner(mutex);
    unlock(&latmMutex_);
    // note: we do not release the transactionsInFlightMutex - this will prevents 
    // new transactions from starting until this lock is released
@@ -279,7 +322,7 @@ dir_tm_conflicting_lock_pthread_unlock_mutex(Mutex *mutex)
       }
    }
 
-   latmLockedLocksOfThreadMap_.erase(mutex);
+   clear_latm_lock_owner(mutex);
    unlock(&latmMutex_);
 
    //if (hasLock) return unlock(mutex);
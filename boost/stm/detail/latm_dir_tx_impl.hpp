@@ -61,7 +61,7 @@
 //
 //----------------------------------------------------------------------------
 inline bool boost::stm::transaction::dir_do_core_tx_conflicting_lock_pthread_lock_mutex
-(Mutex *mutex, int lockWaitTime, int lockAborted, bool txIsIrrevocable)
+(Mutex *mutex, int lockWaitTime, int lockAborted, bool txIsIrrevocable, bool blocking)
 {
    //--------------------------------------------------------------------------
    // see if this mutex is part of any of the in-flight transactions conflicting
@@ -72,88 +72,53 @@ inline bool boost::stm::transaction::dir_do_core_tx_conflicting_lock_pthread_loc
    lock_general_access();
    lock_inflight_access();
 
-   std::list<transaction *> txList;
-   std::set<size_t> txThreadId;
-   //transaction *txToMakeIsolated = NULL;
-
-   for (InflightTxes::iterator i = transactionsInFlight_.begin(); 
-      i != transactionsInFlight_.end(); ++i)
+   // the conflicting in-flight txs would have to be waited for
+   if (!blocking && tx_conflicting_with_latm_lock_in_flight(mutex, false))
    {
-      transaction *t = (transaction*)*i;
-
-      // if this tx is part of this thread, skip it (it's an LiT)
-      if (t->threadId_ == THREAD_ID) continue;
-
-      if (t->get_tx_conflicting_locks().find(mutex) != t->get_tx_conflicting_locks().end())
-      {
-         if (txIsIrrevocable || (!t->irrevocable() && 
-            cm_->allow_lock_to_abort_tx(lockWaitTime, lockAborted, txIsIrrevocable, *t)))
-         {
-            txList.push_back(t);
-         }
-         else 
-         {
-            unlock_general_access();
-            unlock_inflight_access();
-            return false;
-         }
-      }
+      unlock_general_access();
+      unlock_inflight_access();
+      return false;
    }
 
-   if (!txList.empty()) 
+   bool blockedTxs = false;
+
+   try
    {
-      for (std::list<transaction*>::iterator it = txList.begin(); txList.end() != it; ++it)
+      if (!abort_txs_conflicting_with_latm_lock(mutex, lockWaitTime, lockAborted, txIsIrrevocable))
       {
-         transaction *t = (transaction*)*it;
-
-         t->force_to_abort();
-         t->block();
-         txThreadId.insert(t->threadId_);
+         unlock_general_access();
+         unlock_inflight_access();
+         return false;
       }
 
-      try 
-      { 
-         latmLockedLocksAndThreadIdsMap_.insert
-         (std::make_pair<Mutex*, ThreadIdSet>(mutex, txThreadId)); 
-         latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
-      }
-      catch (...) 
-      { 
-         for (std::set<size_t>::iterator it = txThreadId.begin(); 
-         txThreadId.end() != it; ++it) 
-         {
-            if (0 == thread_id_occurance_in_locked_locks_map(*it))
-            {
-               blocked(*it) = false;
-            }
-         }
-         throw; 
-      }
+      blockedTxs = latmLockedLocksAndThreadIdsMap_.end() != 
+         latmLockedLocksAndThreadIdsMap_.find(mutex);
+      if (blockedTxs) set_latm_lock_owner(mutex);
+   }
+   catch (...)
+   {
+      unlock_general_access();
+      unlock_inflight_access();
+      throw;
+   }
 
+   if (blockedTxs) 
+   {
       unlock_general_access();
       unlock_inflight_access();
 
       //-----------------------------------------------------------------------
       // now wait until all the txs which conflict with this mutex are no longer
-      // in-flight
+      // in-flight. only the txs forced to abort above may have written in
+      // place; the ones begun since block once they see the lock, which they
+      // can't before latmMutex_ is released
       //-----------------------------------------------------------------------
       for (;;)
       {
-         bool conflictingTxInFlight = false;
-
          lock_general_access();
          lock_inflight_access();
 
-         for (InflightTxes::iterator i = transactionsInFlight_.begin(); 
-            i != transactionsInFlight_.end(); ++i)
-         {
-            transaction *t = (transaction*)*i;
-
-            if (t->get_tx_conflicting_locks().find(mutex) != t->get_tx_conflicting_locks().end())
-            {
-               conflictingTxInFlight = true;
-            }
-         }
+         bool conflictingTxInFlight = tx_conflicting_with_latm_lock_in_flight(mutex, true);
 
          unlock_general_access();
          unlock_inflight_access();
@@ -199,7 +164,7 @@ inline int boost::stm::transaction::dir_tx_conflicting_lock_pthread_lock_mutex(M
    if (transaction* t = get_inflight_tx_of_same_thread(false))
    {
       t->must_be_in_conflicting_lock_set(mutex);
-      t->make_irrevocable();
+      t->make_irrevocable_unless_aborted();
 
       if (!t->is_currently_locked_lock(mutex))
       {
@@ -252,7 +217,7 @@ inline int boost::stm::transaction::dir_tx_conflicting_lock_pthread_lock_mutex(M
       ++aborted;
    }
 
-   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   set_latm_lock_owner(mutex);
    unlock(&latmMutex_);
 
    // note: we do not release the transactionsInFlightMutex - this will prevents 
@@ -266,33 +231,61 @@ inline int boost::stm::transaction::dir_tx_conflicting_lock_pthread_lock_mutex(M
 inline int boost::stm::transaction::dir_tx_conflicting_lock_pthread_trylock_mutex(Mutex *mutex)
 {
    //--------------------------------------------------------------------------
-   throw "might not be possible to implement trylock for this";
+   // as pthread_lock, but nothing here may wait. the lock is tried before the
+   // tx is made irrevocable, which is safe as neither step stalls, and a busy
+   // result leaves the other in-flight txs untouched
+   //--------------------------------------------------------------------------
+   if (transaction* t = get_inflight_tx_of_same_thread(false))
+   {
+      t->must_be_in_conflicting_lock_set(mutex);
+
+      bool hadLock = t->is_currently_locked_lock(mutex);
+      if (!hadLock)
+      {
+         int val = trylock(mutex);
+         if (0 != val) return val;
+      }
 
-   bool txIsIrrevocable = false;
+      if (!t->try_make_irrevocable())
+      {
+         if (!hadLock) unlock(mutex);
+         return EBUSY;
+      }
+
+      if (t->forced_to_abort())
+      {
+         if (!hadLock) unlock(mutex);
+         t->lock_and_abort();
+         throw aborted_transaction_exception
+         ("aborting tx forced to abort before obtaining lock");
+      }
+
+      t->add_to_currently_locked_locks(mutex);
+      t->add_to_obtained_locks(mutex);
+
+      lock(&latmMutex_);
+      def_do_core_tx_conflicting_lock_pthread_lock_mutex
+         (mutex, 0, 0, true);
+      unlock(&latmMutex_);
+
+      return 0;
+   }
 
    int val = trylock(mutex);
    if (0 != val) return val;
 
    lock(&latmMutex_);
 
-   if (transaction* t = get_inflight_tx_of_same_thread(false))
-   {
-      txIsIrrevocable = true;
-      t->must_be_in_conflicting_lock_set(mutex);
-      t->make_irrevocable();
-      t->add_to_obtained_locks(mutex); 
-   }
-
    try 
    { 
       //-----------------------------------------------------------------------
       // if !core done, since trylock, we cannot stall & retry - just exit
       //-----------------------------------------------------------------------
-      if (!dir_do_core_tx_conflicting_lock_pthread_lock_mutex(mutex, 0, 0, txIsIrrevocable)) 
+      if (!dir_do_core_tx_conflicting_lock_pthread_lock_mutex(mutex, 0, 0, false, false)) 
       {
          unlock(mutex);
          unlock(&latmMutex_);
-         return -1;
+         return EBUSY;
       }
    }
    catch (...)
@@ -302,9 +295,8 @@ inline int boost::stm::transaction::dir_tx_conflicting_lock_pthread_trylock_mute
       throw;
    }
 
-   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   set_latm_lock_owner(mutex);
    unlock(&latmMutex_);
-
    // note: we do not release the transactionsInFlightMutex - this will prevents 
    // new transactions from starting until this lock is released
    return 0;
@@ -332,6 +324,9 @@ inline int boost::stm::transaction::dir_tx_conflicting_lock_pthread_unlock_mutex
       t->remove_from_currently_locked_locks(mutex);
    }
 
+   // the objects bound to the mutex may be touched again
+   release_latm_protected_lock(mutex);
+
    //--------------------------------------------------------------------------
    // if this mutex is on the tmConflictingLocks_ set, then we need to remove
    // it from the latmLocks and any txs on the full thread list that are
@@ -339,11 +334,14 @@ inline int boost::stm::transaction::dir_tx_conflicting_lock_pthread_unlock_mutex
    //--------------------------------------------------------------------------
    if (latmLockedLocksAndThreadIdsMap_.find(mutex) != latmLockedLocksAndThreadIdsMap_.end())
    {
-      latmLockedLocksAndThreadIdsMap_.erase(mutex);
+      {
+         var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+         unblock_threads_on_latm_lock(mutex);
+      }
       unblock_conflicting_threads(mutex);
    }
 
-   latmLockedLocksOfThreadMap_.erase(mutex);
+   clear_latm_lock_owner(mutex);
    unblock_threads_if_locks_are_empty();
 
    // TBR if (hasLock) return unlock(mutex);
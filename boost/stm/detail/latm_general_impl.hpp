@@ -62,25 +62,80 @@
 
 
 //----------------------------------------------------------------------------
+// waits at the begin gate, which clear_latm_lock_owner() wakes under
+// latmMutex_ whenever a lock is unlocked. the waiter takes latmGateMutex_
+// before it releases latmMutex_, so the wake can't slip in between
 //----------------------------------------------------------------------------
 inline void boost::stm::transaction::wait_until_all_locks_are_released(bool keepLatmLocked)
 {
+   ++latmGateWaiters_;
+
    while (true) 
    {
       lock_latm_access();
       if (latmLockedLocks_.empty()) break;
+
+      lock(&latmGateMutex_);
       unlock_latm_access();
-      SLEEP(10);
+      timed_wait_at_latm_gate();
+      unlock(&latmGateMutex_);
    }
 
+   --latmGateWaiters_;
+
    if (!keepLatmLocked) unlock_latm_access();
 }
 
+//----------------------------------------------------------------------------
+// the drain of a direct updating full or tm conflicting lock, once it has
+// forced the in-flight txs to abort and blocked every thread. txs can still
+// go in-flight until the lock is recorded as locked, so the ones which do
+// are forced to abort as well. an irrevocable one can't be and may need
+// latmMutex_ to finish, so the threads are unblocked and false is returned
+// for the locker to back off and retry
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+//
+//----------------------------------------------------------------------------
+inline bool boost::stm::transaction::wait_until_in_flight_txs_are_gone()
+{
+   for (;;)
+   {
+      {
+         var_auto_lock<PLOCK> autolock(general_lock(), inflight_lock(), 0);
+
+         if (transactionsInFlight_.empty()) return true;
+
+         for (InflightTxes::iterator i = transactionsInFlight_.begin(); 
+            i != transactionsInFlight_.end(); ++i)
+         {
+            if (((transaction*)*i)->irrevocable())
+            {
+               thread_conflicting_mutexes_set_all(false);
+               return false;
+            }
+         }
+
+         for (InflightTxes::iterator i = transactionsInFlight_.begin(); 
+            i != transactionsInFlight_.end(); ++i)
+         {
+            ((transaction*)*i)->force_to_abort();
+         }
+      }
+
+      SLEEP(10);
+   }
+}
+
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
 inline void boost::stm::transaction::add_to_obtained_locks(Mutex* m)
 {
-   obtainedLocksRef().insert(m);
+   if (obtainedLocksRef().insert(m).second)
+   {
+      var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+      ++latmObtainedLockCounts_[m];
+   }
 
 #if LOGGING_BLOCKS
    logFile_ << "----------------------\ntx has obtained mutex: " << m << endl << endl;
@@ -125,6 +180,7 @@ inline void boost::stm::transaction::clear_latm_obtained_locks()
       Mutex* m = *i;
       obtainedLocksRef().erase(i);
       i = obtainedLocksRef().begin();
+      forget_obtained_lock(m);
 
 #if LOGGING_BLOCKS
       logFile_ << "----------------------\nbefore tx release unlocked mutex: " << m << endl << endl;
@@ -142,6 +198,30 @@ inline void boost::stm::transaction::clear_latm_obtained_locks()
    unblock_threads_if_locks_are_empty();
 
    currentlyLockedLocksRef().clear();
+   forget_latm_rw_holds();
+}
+
+//----------------------------------------------------------------------------
+// a lock taken inside a tx which has aborted since is unlocked outside of
+// any tx, e.g. by an auto_lock or elided_lock unwinding the abort. the lock
+// is taken off the thread's lists before it is unlocked, the retry would
+// otherwise find it still locked and skip locking it, and the conflicting
+// threads are unblocked as a commit would. false if it is no such lock
+//----------------------------------------------------------------------------
+inline bool boost::stm::transaction::release_aborted_tx_lock(Mutex *mutex)
+{
+   if (0 != get_inflight_tx_of_same_thread(false)) return false;
+
+   MutexSet &locked = currentlyLockedLocksRef(THREAD_ID);
+   if (locked.end() == locked.find(mutex)) return false;
+   locked.erase(mutex);
+
+   bool const obtained = 0 != obtainedLocksRef(THREAD_ID).erase(mutex);
+   if (obtained) forget_obtained_lock(mutex);
+
+   pthread_unlock(mutex);
+   if (obtained) unblock_conflicting_threads(mutex);
+   return true;
 }
 
 //----------------------------------------------------------------------------
@@ -152,15 +232,37 @@ inline void boost::stm::transaction::clear_latm_obtained_locks()
 //----------------------------------------------------------------------------
 inline bool boost::stm::transaction::mutex_is_on_obtained_tx_list(Mutex *mutex)
 {
-   for (ThreadMutexSetContainer::iterator iter = threadObtainedLocks_.begin();
-   threadObtainedLocks_.end() != iter; ++iter)
+   var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+   return latmObtainedLockCounts_.end() != latmObtainedLockCounts_.find(mutex);
+}
+
+//----------------------------------------------------------------------------
+// true if a thread other than this tx's thread has the mutex on its obtained
+// locks list
+//
+// PRE-CONDITION: latmIndexMutex_ is obtained prior to calling this method.
+//
+//----------------------------------------------------------------------------
+inline bool boost::stm::transaction::mutex_is_obtained_by_other_thread(Mutex *mutex)
+{
+   MutexCountMap::iterator i = latmObtainedLockCounts_.find(mutex);
+   if (latmObtainedLockCounts_.end() == i) return false;
+
+   return i->second > (is_on_obtained_locks_list(mutex) ? 1u : 0u);
+}
+
+//----------------------------------------------------------------------------
+// the mutex has been taken off one thread's obtained locks list
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::forget_obtained_lock(Mutex *mutex)
+{
+   var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+   MutexCountMap::iterator i = latmObtainedLockCounts_.find(mutex);
+   if (latmObtainedLockCounts_.end() != i && 0 == --i->second)
    {
-      if (iter->second->find(mutex) != iter->second->end())
-      {
-         return true;
-      }
+      latmObtainedLockCounts_.erase(i);
    }
-   return false;
 }
 
 //----------------------------------------------------------------------------
@@ -282,7 +384,18 @@ inline void boost::stm::transaction::tm_lock_conflict(Mutex *inLock)
    //-------------------------------------------------------------------------
    // insert can throw an exception
    //-------------------------------------------------------------------------
-   try { tmConflictingLocks_.insert(inLock); } 
+   try 
+   { 
+      //----------------------------------------------------------------------
+      // a lock which is already locked is recounted as tm conflicting
+      //----------------------------------------------------------------------
+      MutexThreadMap::iterator i = latmLockedLocksOfThreadMap_.find(inLock);
+      bool const locked = latmLockedLocksOfThreadMap_.end() != i;
+
+      if (locked) count_latm_lock_owner(inLock, i->second, false);
+      tmConflictingLocks_.insert(inLock);
+      if (locked) count_latm_lock_owner(inLock, i->second, true);
+   } 
    catch (...) 
    {
       unlock(&latmMutex_);
@@ -296,7 +409,25 @@ inline void boost::stm::transaction::tm_lock_conflict(Mutex *inLock)
 inline void boost::stm::transaction::clear_tm_conflicting_locks()
 {
    lock(&latmMutex_);
+
+   //-------------------------------------------------------------------------
+   // uncount the locked tm conflicting locks as plain locks, then recount
+   // them without the set
+   //-------------------------------------------------------------------------
+   for (MutexThreadMap::iterator i = latmLockedLocksOfThreadMap_.begin();
+      i != latmLockedLocksOfThreadMap_.end(); ++i)
+   {
+      count_latm_lock_owner(i->first, i->second, false);
+   }
+
    tmConflictingLocks_.clear();
+
+   for (MutexThreadMap::iterator i = latmLockedLocksOfThreadMap_.begin();
+      i != latmLockedLocksOfThreadMap_.end(); ++i)
+   {
+      count_latm_lock_owner(i->first, i->second, true);
+   }
+
    unlock(&latmMutex_);
 }
 
@@ -326,33 +457,145 @@ inline void boost::stm::transaction::add_tx_conflicting_lock(Mutex *inLock)
 {
    if (!doing_tx_lock_protection()) return;
 
+   lock_latm_access_unless_aborted();
+
+   try
    {
-      var_auto_lock<PLOCK> autol(latm_lock(), general_lock(), inflight_lock(), NULL);
+      var_auto_lock<PLOCK> autol(general_lock(), inflight_lock(), NULL);
 
-      if (get_tx_conflicting_locks().find(inLock) != get_tx_conflicting_locks().end()) return;
-      get_tx_conflicting_locks().insert(inLock);
+      if (get_tx_conflicting_locks().insert(inLock).second)
+      {
+         var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+         latmConflictingThreads_[inLock].insert(threadId_);
+      }
 
-      if (irrevocable()) return;
+      //-----------------------------------------------------------------------
+      // checked even if the lock is in the set already: an aborted attempt
+      // keeps its set, and a locker which came while the thread was between
+      // attempts found no tx of it to block
+      //-----------------------------------------------------------------------
+      if (!irrevocable())
+      {
+         see_if_tx_must_block_due_to_tx_latm();
 
-      see_if_tx_must_block_due_to_tx_latm();
+         //--------------------------------------------------------------------
+         // a direct updating tx has written in place what the shared
+         // holders of the lock may be reading
+         //--------------------------------------------------------------------
+         if (direct_updating() && isWriting() && shared_latm_lock_stops_writes())
+         {
+            force_to_abort();
+         }
+      }
+   }
+   catch (...)
+   {
+      unlock(&latmMutex_);
+      throw;
    }
 
-   if (blocked()) 
+   unlock(&latmMutex_);
+
+   if (irrevocable()) return;
+
+   if (blocked() || forced_to_abort()) 
    {
       lock_and_abort();
       throw aborted_transaction_exception("aborting transaction");
    }
 }
 
+//----------------------------------------------------------------------------
+// lock_latm_access() for an in-flight tx: latmMutex_ is only tried, since a
+// direct updating locker holds it while it waits for the txs it forced to
+// abort to leave. aborts the tx if it is forced to abort meanwhile
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::lock_latm_access_unless_aborted()
+{
+   while (0 != trylock(&latmMutex_))
+   {
+      if (forced_to_abort())
+      {
+         lock_and_abort();
+         throw aborted_transaction_exception("aborting transaction");
+      }
+
+      SLEEP(1);
+   }
+}
+
+//----------------------------------------------------------------------------
+// make_irrevocable() for a tx about to obtain a lock inside itself. a tx
+// forced to abort aborts rather than stalls, since a locker may be waiting
+// for it to leave, and it aborts even once irrevocable if it was forced
+// before: obtaining the lock first, its abort would leave the lock obtained
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::make_irrevocable_unless_aborted()
+{
+   for (;;)
+   {
+      if (forced_to_abort())
+      {
+         lock_and_abort();
+         throw aborted_transaction_exception
+         ("aborting tx forced to abort before obtaining lock");
+      }
+
+      if (try_make_irrevocable()) break;
+
+      SLEEP(10);
+      cm_->perform_irrevocable_tx_wait_priority_promotion(*this);
+   }
+
+   if (forced_to_abort())
+   {
+      lock_and_abort();
+      throw aborted_transaction_exception
+      ("aborting tx forced to abort before obtaining lock");
+   }
+}
+
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
 inline void boost::stm::transaction::clear_tx_conflicting_locks()
 {
    lock_general_access();
-   get_tx_conflicting_locks().clear();
+   forget_tx_conflicting_locks();
    unlock_general_access();
 }
 
+//----------------------------------------------------------------------------
+// clears the tx conflicting locks of this tx's thread and takes the thread
+// off the conflicting threads index of each of them.
+//
+// the thread is unblocked as well: it is only unblocked through the index,
+// so a block left on it (e.g., its tx was forced to abort too late to stop
+// its commit) would never be lifted, and its next tx checks its own
+// conflicting locks from scratch
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::forget_tx_conflicting_locks()
+{
+   if (get_tx_conflicting_locks().empty()) return;
+
+   {
+      var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+      for (MutexSet::iterator k = get_tx_conflicting_locks().begin();
+         k != get_tx_conflicting_locks().end(); ++k)
+      {
+         MutexThreadSetMap::iterator i = latmConflictingThreads_.find(*k);
+         if (latmConflictingThreads_.end() == i) continue;
+
+         i->second.erase(threadId_);
+         if (i->second.empty()) latmConflictingThreads_.erase(i);
+      }
+
+      unblock();
+   }
+
+   get_tx_conflicting_locks().clear();
+}
+
 //----------------------------------------------------------------------------
 // 
 // Exposed client interfaces that act as forwarding calls to the real 
@@ -408,6 +651,8 @@ inline int boost::stm::transaction::pthread_unlock(Mutex *mutex)
 {
    using namespace boost::stm;
 
+   if (release_aborted_tx_lock(mutex)) return 0;
+
    switch (eLatmType_)
    {
    case eFullLatmProtection: 
@@ -443,17 +688,14 @@ inline int boost::stm::transaction::pthread_unlock(Mutex *mutex)
 inline void boost::stm::transaction::see_if_tx_must_block_due_to_tx_latm()
 {
    //--------------------------------------------------------------------------
-   // iterate through all currently locked locks 
+   // iterate through this transaction's conflicting mutex ref - if one of
+   // them is a currently locked lock, we need to block this tx
    //--------------------------------------------------------------------------
-   for (MutexThreadSetMap::iterator iter = latmLockedLocksAndThreadIdsMap_.begin(); 
-   latmLockedLocksAndThreadIdsMap_.end() != iter; ++iter)
+   for (MutexSet::iterator k = get_tx_conflicting_locks().begin(); 
+   k != get_tx_conflicting_locks().end(); ++k)
    {
-      //-----------------------------------------------------------------------
-      // iterate through this transaction's conflicting mutex ref - if one of
-      // the currently locked locks is in this tx's conflicting mutex set,
-      // we need to block this tx
-      //-----------------------------------------------------------------------
-      if (get_tx_conflicting_locks().find(iter->first) != get_tx_conflicting_locks().end())
+      if (latm_protected_objects(*k)) continue;
+      if (latmLockedLocksAndThreadIdsMap_.find(*k) != latmLockedLocksAndThreadIdsMap_.end())
       {
          this->block(); break;
       }
@@ -463,83 +705,355 @@ inline void boost::stm::transaction::see_if_tx_must_block_due_to_tx_latm()
 
    for (MutexSet::iterator k = get_tx_conflicting_locks().begin(); k != get_tx_conflicting_locks().end(); ++k)
    {
-      // if it is locked by our thread, it is ok ... otherwise it is not
-      MutexThreadMap::iterator l = latmLockedLocksOfThreadMap_.find(*k);
+      //-----------------------------------------------------------------------
+      // a lock with objects bound to it only blocks this tx if another thread
+      // claims it and the tx has touched them
+      //-----------------------------------------------------------------------
+      if (latm_protected_objects(*k))
+      {
+         if (!latm_protected_objects_touched(*k)) continue;
+      }
+      else
+      {
+         // if it is locked by our thread, it is ok ... otherwise it is not
+         MutexThreadMap::iterator l = latmLockedLocksOfThreadMap_.find(*k);
+         if (l == latmLockedLocksOfThreadMap_.end() || THREAD_ID == l->second) continue;
+      }
 
-      if (l != latmLockedLocksOfThreadMap_.end() && 
-         THREAD_ID != l->second)
       {
-         MutexThreadSetMap::iterator locksAndThreadsIter = latmLockedLocksAndThreadIdsMap_.find(*k);
+         var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+         block_thread_on_latm_lock(*k, THREAD_ID);
+      }
 
-         if (locksAndThreadsIter == latmLockedLocksAndThreadIdsMap_.end())
-         {
-            ThreadIdSet s;
-            s.insert(THREAD_ID);
+      this->block(); break;
+   }
+
+}
 
-            latmLockedLocksAndThreadIdsMap_.insert
-            (std::make_pair<Mutex*, ThreadIdSet>(*k, s)); 
+//----------------------------------------------------------------------------
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+//
+//----------------------------------------------------------------------------
+inline int boost::stm::transaction::
+thread_id_occurance_in_locked_locks_map(size_t threadId)
+{
+   var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+   return (int)latm_blocks(threadId);
+}
+
+//----------------------------------------------------------------------------
+//
+// PRE-CONDITION: latmIndexMutex_ is obtained prior to calling this method.
+//
+//----------------------------------------------------------------------------
+inline size_t boost::stm::transaction::latm_blocks(size_t threadId)
+{
+   ThreadSizetMap::iterator i = threadLatmBlocks_.find(threadId);
+   return threadLatmBlocks_.end() == i ? 0 : *i->second;
+}
+
+//----------------------------------------------------------------------------
+// unblocks the thread and signals its wait record, see wait_while_blocked()
+//
+// PRE-CONDITION: latmIndexMutex_ is obtained prior to calling this method.
+//
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::wake_latm_blocked_thread(thread_id_t id)
+{
+   int &b = blocked(id);
+   if (!b) return;
+
+   b = false;
+
+   ThreadLatmWaitRecords::iterator i = threadLatmWaits_.find(id);
+   if (threadLatmWaits_.end() == i) return;
+
+   var_auto_lock<PLOCK> a(&i->second->mutex, 0);
+   pthread_cond_signal(&i->second->cond);
+}
+
+//----------------------------------------------------------------------------
+// forces the in-flight txs of other threads which have the mutex in their tx
+// conflicting lock set to abort and blocks their threads until the mutex is
+// unlocked. only the threads found through latmConflictingThreads_ are
+// visited. returns false, touching nothing, if any of the txs may not be
+// aborted.
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+// PRE-CONDITION: general_lock() and inflight_lock() are obtained prior to
+//                calling this method.
+//
+//----------------------------------------------------------------------------
+inline bool boost::stm::transaction::abort_txs_conflicting_with_latm_lock
+(Mutex *mutex, int lockWaitTime, int lockAborted, bool txIsIrrevocable)
+{
+   //--------------------------------------------------------------------------
+   // a mutex with objects bound to it is claimed before the blooms of the
+   // txs are looked at, and only the txs which touched the objects conflict
+   //--------------------------------------------------------------------------
+   bloom_filter *objects = latm_protected_objects(mutex);
+   bool const claimed = 0 != objects && claim_latm_protected_lock(mutex);
+
+   var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+   MutexThreadSetMap::iterator conflicting = latmConflictingThreads_.find(mutex);
+   if (latmConflictingThreads_.end() == conflicting) return true;
+
+   ThreadIdSet &threads = conflicting->second;
+
+   for (ThreadIdSet::iterator i = threads.begin(); threads.end() != i; ++i)
+   {
+      // if this tx is part of this thread, skip it (it's an LiT)
+      if (*i == THREAD_ID) continue;
+
+      InflightOfThread &txs = inflight_of_thread(*i);
+
+      for (InflightOfThread::iterator j = txs.begin(); txs.end() != j; ++j)
+      {
+         transaction *t = *j;
+         if (0 != objects && !t->bloom().intersection(*objects)) continue;
+
+         if (!txIsIrrevocable && (t->irrevocable() || 
+            !cm_->allow_lock_to_abort_tx(lockWaitTime, lockAborted, txIsIrrevocable, *t)))
+         {
+            if (claimed) release_latm_protected_lock(mutex);
+            return false;
          }
-         else
+      }
+   }
+
+#if LOGGING_BLOCKS
+   logFile_ << "----------------------\nbefore locked mutex: " << mutex << endl << endl;
+#endif
+
+   try
+   {
+      for (ThreadIdSet::iterator i = threads.begin(); threads.end() != i; ++i)
+      {
+         if (*i == THREAD_ID) continue;
+
+         InflightOfThread &txs = inflight_of_thread(*i);
+
+         for (InflightOfThread::iterator j = txs.begin(); txs.end() != j; ++j)
          {
-            locksAndThreadsIter->second.insert(THREAD_ID);
+            if (0 != objects && !(*j)->bloom().intersection(*objects)) continue;
+
+            (*j)->force_to_abort();
+            (*j)->block();
+            block_thread_on_latm_lock(mutex, *i);
          }
+      }
+   }
+   catch (...)
+   {
+      unblock_threads_on_latm_lock(mutex);
 
-         this->block(); break;
+      for (ThreadIdSet::iterator i = threads.begin(); threads.end() != i; ++i)
+      {
+         if (*i != THREAD_ID && 0 == latm_blocks(*i)) wake_latm_blocked_thread(*i);
       }
+      if (claimed) release_latm_protected_lock(mutex);
+      throw;
    }
 
+   return true;
 }
 
 //----------------------------------------------------------------------------
+// with forcedOnly, or for a mutex with objects bound to it, only the txs
+// forced to abort count: the others have not touched what the mutex guards
+// and block before they do
 //
 // ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+// PRE-CONDITION: general_lock() and inflight_lock() are obtained prior to
+//                calling this method.
 //
 //----------------------------------------------------------------------------
-inline int boost::stm::transaction::
-thread_id_occurance_in_locked_locks_map(size_t threadId)
+inline bool boost::stm::transaction::tx_conflicting_with_latm_lock_in_flight
+(Mutex *mutex, bool forcedOnly)
 {
-   int count = 0;
+   forcedOnly = forcedOnly || 0 != latm_protected_objects(mutex);
+
+   var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
 
-   for (MutexThreadSetMap::iterator iter = latmLockedLocksAndThreadIdsMap_.begin(); 
-      latmLockedLocksAndThreadIdsMap_.end() != iter; ++iter)
+   MutexThreadSetMap::iterator conflicting = latmConflictingThreads_.find(mutex);
+   if (latmConflictingThreads_.end() == conflicting) return false;
+
+   for (ThreadIdSet::iterator i = conflicting->second.begin(); 
+      conflicting->second.end() != i; ++i)
    {
-      if (iter->second.find(threadId) != iter->second.end()) ++count;
+      InflightOfThread &txs = inflight_of_thread(*i);
+
+      if (!forcedOnly)
+      {
+         if (!txs.empty()) return true;
+         continue;
+      }
+
+      for (InflightOfThread::iterator j = txs.begin(); txs.end() != j; ++j)
+      {
+         if ((*j)->forced_to_abort()) return true;
+      }
    }
 
-   return count;
+   return false;
 }
 
 //----------------------------------------------------------------------------
+// records THREAD_ID as the owner of the locked mutex, keeping the begin gate
+// counters in step with latmLockedLocksOfThreadMap_
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
 //
 //----------------------------------------------------------------------------
-inline boost::stm::transaction* boost::stm::transaction::get_inflight_tx_of_same_thread
-(bool hasTxInFlightMutex)
+inline void boost::stm::transaction::set_latm_lock_owner(Mutex *mutex)
 {
-   if (!hasTxInFlightMutex) lock_inflight_access();
+   MutexThreadMap::iterator i = latmLockedLocksOfThreadMap_.find(mutex);
 
-   for (InflightTxes::iterator i = transactionsInFlight_.begin(); 
-      i != transactionsInFlight_.end(); ++i)
+   if (latmLockedLocksOfThreadMap_.end() != i)
+   {
+      if (THREAD_ID == i->second) return;
+      clear_latm_lock_owner(mutex);
+   }
+
+   latmLockedLocksOfThreadMap_[mutex] = THREAD_ID;
+   count_latm_lock_owner(mutex, THREAD_ID, true);
+}
+
+//----------------------------------------------------------------------------
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+//
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::clear_latm_lock_owner(Mutex *mutex)
+{
+   MutexThreadMap::iterator i = latmLockedLocksOfThreadMap_.find(mutex);
+   if (latmLockedLocksOfThreadMap_.end() != i)
    {
-      transaction *t = (transaction*)*i;
+      size_t const owner = i->second;
+      latmLockedLocksOfThreadMap_.erase(i);
+      count_latm_lock_owner(mutex, owner, false);
+   }
 
-      //--------------------------------------------------------------------
-      // if this tx's thread is the same thread iterating through the in-flight
-      // txs, then this lock is INSIDE this tx - don't abort the tx, just
-      // make it isolated and ensure it is performing direct updating
-      //--------------------------------------------------------------------
-      if (t->thread_id() == THREAD_ID)
+   //-------------------------------------------------------------------------
+   // wake the transactions parked at the begin gate. a parking transaction
+   // counts itself before it checks the gate, under latmGateMutex_, so it
+   // either sees the new counts or is woken here. lockers waiting in
+   // wait_until_all_locks_are_released() are woken by an unowned lock too
+   //-------------------------------------------------------------------------
+   if (0 != latmGateWaiters_)
+   {
+      var_auto_lock<PLOCK> a(&latmGateMutex_, 0);
+      pthread_cond_broadcast(&latmGateCond_);
+   }
+}
+
+//----------------------------------------------------------------------------
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+//
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::count_latm_lock_owner
+(Mutex *mutex, size_t threadId, bool locked)
+{
+   bool const tmConflicting = tmConflictingLocks_.end() != tmConflictingLocks_.find(mutex);
+
+   var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+   ThreadLatmHeldRecords::iterator i = threadLatmHeld_.find(threadId);
+   latm_held_record *record = threadLatmHeld_.end() != i ? i->second : 0;
+
+   //-------------------------------------------------------------------------
+   // the owner's count is raised first and lowered last, so an owner never
+   // sees more of the locks as its own than the total
+   //-------------------------------------------------------------------------
+   if (locked)
+   {
+      if (record) ++record->locks;
+      ++latmHeldLocks_;
+      if (tmConflicting)
       {
-         if (!hasTxInFlightMutex) unlock_inflight_access();
-         return t;
+         if (record) ++record->tmConflictingLocks;
+         ++latmHeldTmConflictingLocks_;
       }
    }
+   else
+   {
+      --latmHeldLocks_;
+      if (record) --record->locks;
+      if (tmConflicting)
+      {
+         --latmHeldTmConflictingLocks_;
+         if (record) --record->tmConflictingLocks;
+      }
+   }
+}
+
+//----------------------------------------------------------------------------
+// adds the thread to the threads blocked by the locked mutex
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+// PRE-CONDITION: latmIndexMutex_ is obtained prior to calling this method.
+//
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::block_thread_on_latm_lock(Mutex *mutex, size_t threadId)
+{
+   if (!latmLockedLocksAndThreadIdsMap_[mutex].insert(threadId).second) return;
+
+   ThreadSizetMap::iterator i = threadLatmBlocks_.find(threadId);
+   if (threadLatmBlocks_.end() != i) ++*i->second;
+}
+
+//----------------------------------------------------------------------------
+// removes the locked mutex and the blocks it holds on its threads; threads
+// are not unblocked here, see unblock_conflicting_threads()
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+// PRE-CONDITION: latmIndexMutex_ is obtained prior to calling this method.
+//
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::unblock_threads_on_latm_lock(Mutex *mutex)
+{
+   MutexThreadSetMap::iterator locked = latmLockedLocksAndThreadIdsMap_.find(mutex);
+   if (latmLockedLocksAndThreadIdsMap_.end() == locked) return;
+
+   for (ThreadIdSet::iterator j = locked->second.begin(); locked->second.end() != j; ++j)
+   {
+      // threads which terminated while blocked are no longer counted
+      ThreadSizetMap::iterator i = threadLatmBlocks_.find(*j);
+      if (threadLatmBlocks_.end() != i) --*i->second;
+   }
+
+   latmLockedLocksAndThreadIdsMap_.erase(locked);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+inline boost::stm::transaction* boost::stm::transaction::get_inflight_tx_of_same_thread
+(bool hasTxInFlightMutex)
+{
+   if (!hasTxInFlightMutex) lock_inflight_access();
+
+   //--------------------------------------------------------------------
+   // if a tx of this thread is in-flight, then this lock is INSIDE this tx -
+   // don't abort the tx, just make it isolated and ensure it is performing
+   // direct updating
+   //--------------------------------------------------------------------
+   transaction *t = NULL;
+   ThreadInflightTxes::iterator i = threadInflightTxes_.find(THREAD_ID);
+
+   if (threadInflightTxes_.end() != i && !i->second->empty()) t = i->second->front();
 
    if (!hasTxInFlightMutex) unlock_inflight_access();
-   return NULL;
+   return t;
 }
 
 #include <boost/stm/detail/latm_def_full_impl.hpp>
 #include <boost/stm/detail/latm_dir_full_impl.hpp>
+#include <boost/stm/detail/latm_rw_impl.hpp>
+#include <boost/stm/detail/latm_object_impl.hpp>
 
 #endif
 
@@ -0,0 +1,185 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+//-----------------------------------------------------------------------------
+//
+// latm_object_impl.hpp
+//
+// This file contains method implementations for transaction.hpp (specifically
+// for tx conflicting locks with objects bound to them).
+//
+// A tx conflicting lock normally conflicts with every tx which has it in its
+// tx conflicting set. Once objects are bound to the lock, kept as a bloom
+// filter of their addresses, it only conflicts with the txs which touch
+// them: the locker claims the lock and aborts the in-flight txs whose blooms
+// intersect it, and a tx which touches one of the objects while another
+// thread claims the lock blocks until the lock is unlocked. The blooms may
+// give false positives, never false negatives, so a tx is at worst aborted
+// without need.
+//
+// Do NOT place these methods in a .cc/.cpp/.cxx file. These methods must be
+// inlined to keep DracoSTM performing fast.
+//
+//-----------------------------------------------------------------------------
+#ifndef BOOST_STM_TRANSACTION_LOCK_AWARE_OBJECT_IMPL_H
+#define BOOST_STM_TRANSACTION_LOCK_AWARE_OBJECT_IMPL_H
+
+#if PERFORMING_LATM
+
+//-----------------------------------------------------------------------------
+//
+//
+//
+//                       LATM LOCK PROTECTED OBJECT METHODS
+//
+//
+//
+//-----------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::add_latm_protected_address
+(Mutex *lock, void const *address)
+{
+#if !USE_BLOOM_FILTER
+   throw "objects bound to LATM locks need USE_BLOOM_FILTER";
+#endif
+
+   var_auto_lock<PLOCK> a(latm_lock(), 0);
+
+   bloom_filter *&objects = latmProtectedObjects_[lock];
+   if (0 == objects) objects = new bloom_filter;
+
+   objects->insert(address);
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::clear_lock_protected_objects(Mutex *lock)
+{
+   var_auto_lock<PLOCK> a(latm_lock(), 0);
+
+   MutexBloomMap::iterator i = latmProtectedObjects_.find(lock);
+   if (latmProtectedObjects_.end() == i) return;
+
+   delete i->second;
+   latmProtectedObjects_.erase(i);
+}
+
+//----------------------------------------------------------------------------
+// the objects bound to the mutex, 0 if it has none
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+//
+//----------------------------------------------------------------------------
+inline boost::stm::bloom_filter* boost::stm::transaction::latm_protected_objects(Mutex *mutex)
+{
+   if (latmProtectedObjects_.empty()) return 0;
+
+   MutexBloomMap::iterator i = latmProtectedObjects_.find(mutex);
+   return latmProtectedObjects_.end() == i ? 0 : i->second;
+}
+
+//----------------------------------------------------------------------------
+// claims the mutex for THREAD_ID, returns false if it was already claimed.
+// the claim is counted and fenced before it returns, pairing with the fence
+// in check_latm_protected_object(), so the blooms looked at afterwards hold
+// every object checked without a claim seen
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+//
+//----------------------------------------------------------------------------
+inline bool boost::stm::transaction::claim_latm_protected_lock(Mutex *mutex)
+{
+   if (!latmProtectedLockClaims_.insert(std::make_pair(mutex, THREAD_ID)).second)
+   {
+      return false;
+   }
+
+   ++latmProtectedClaims_;
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   return true;
+}
+
+//----------------------------------------------------------------------------
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+//
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::release_latm_protected_lock(Mutex *mutex)
+{
+   MutexThreadMap::iterator i = latmProtectedLockClaims_.find(mutex);
+   if (latmProtectedLockClaims_.end() == i) return;
+
+   latmProtectedLockClaims_.erase(i);
+   --latmProtectedClaims_;
+}
+
+//----------------------------------------------------------------------------
+// true if another thread claims the mutex and this tx has touched one of
+// the objects bound to it
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+//
+//----------------------------------------------------------------------------
+inline bool boost::stm::transaction::latm_protected_objects_touched(Mutex *mutex)
+{
+   MutexThreadMap::iterator i = latmProtectedLockClaims_.find(mutex);
+   if (latmProtectedLockClaims_.end() == i || THREAD_ID == i->second) return false;
+
+   bloom_filter *objects = latm_protected_objects(mutex);
+   return 0 != objects && bloom().intersection(*objects);
+}
+
+//----------------------------------------------------------------------------
+// the slow half of check_latm_protected_object(): blocks this tx's thread on
+// the first lock of its tx conflicting set which another thread claims and
+// to which obj is bound, then aborts the tx.
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::block_on_latm_protected_object(void const *obj)
+{
+   lock_latm_access_unless_aborted();
+
+   bool mustBlock = false;
+
+   for (MutexSet::iterator k = get_tx_conflicting_locks().begin();
+      k != get_tx_conflicting_locks().end(); ++k)
+   {
+      MutexThreadMap::iterator i = latmProtectedLockClaims_.find(*k);
+      if (latmProtectedLockClaims_.end() == i || THREAD_ID == i->second) continue;
+
+      bloom_filter *objects = latm_protected_objects(*k);
+      if (0 == objects || !objects->exists(obj)) continue;
+
+      {
+         var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+         block_thread_on_latm_lock(*k, THREAD_ID);
+      }
+
+      this->block();
+      mustBlock = true;
+      break;
+   }
+
+   unlock(&latmMutex_);
+
+   if (mustBlock)
+   {
+      lock_and_abort();
+      throw aborted_transaction_exception("aborting transaction");
+   }
+}
+
+#endif
+
+#endif // BOOST_STM_TRANSACTION_LOCK_AWARE_OBJECT_IMPL_H
@@ -0,0 +1,511 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+//-----------------------------------------------------------------------------
+//
+// latm_rw_impl.hpp
+//
+// This file contains method implementations for transaction.hpp (specifically
+// for reader-writer locks in lock aware transactions).
+//
+// A reader-writer lock keeps its LATM state under a Mutex of its own. An
+// exclusive hold takes that Mutex through pthread_lock(), so it has the
+// exact semantics of the LATM mode in use. A shared hold is recorded in
+// latmSharedLocks_ instead: the txs it conflicts with may run, but direct
+// updating ones wait before writing and deferred updating ones wait before
+// committing writes until the shared holds are released. Read-only txs are
+// never held up by a shared hold.
+//
+// The holds taken inside a tx are remembered for the thread. A commit
+// forgets them, they are the thread's until it unlocks them. An abort of the
+// thread's txs releases the ones still held, see release_latm_rw_holds().
+//
+// Do NOT place these methods in a .cc/.cpp/.cxx file. These methods must be
+// inlined to keep DracoSTM performing fast.
+//
+//-----------------------------------------------------------------------------
+#ifndef BOOST_STM_TRANSACTION_LOCK_AWARE_RW_IMPL_H
+#define BOOST_STM_TRANSACTION_LOCK_AWARE_RW_IMPL_H
+
+#if PERFORMING_LATM
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+//
+//
+//
+//                       READER-WRITER LATM LOCK METHODS
+//
+//
+//
+//-----------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+// the Mutex a reader-writer lock's LATM state is kept under, made on first
+// use and kept for the life of the process
+//----------------------------------------------------------------------------
+inline Mutex* boost::stm::transaction::latm_rw_mutex(RwMutex *lock)
+{
+   var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+   RwMutexLatmMap::iterator i = latmRwMutexes_.find(lock);
+   if (latmRwMutexes_.end() != i) return i->second;
+
+   Mutex *mutex = new Mutex;
+#ifndef BOOST_STM_USE_BOOST_MUTEX
+   pthread_mutex_init(mutex, 0);
+#endif
+
+   try { latmRwMutexes_[lock] = mutex; }
+   catch (...)
+   {
+      delete mutex;
+      throw;
+   }
+
+   return mutex;
+}
+
+//----------------------------------------------------------------------------
+// takes the reader-writer lock for a thread with a tx in flight. the holder
+// may be waiting for that tx to abort, as a LATM lock waits for the txs it
+// forced to abort, so the tx checks for it between timed attempts
+//----------------------------------------------------------------------------
+inline int boost::stm::transaction::lock_rw_in_tx
+(transaction *t, RwMutex *lock, bool shared)
+{
+   for (;;)
+   {
+      timespec const ts = deadline_after(std::chrono::nanoseconds(kLatmRwLockPollNs));
+
+      int val = shared ? pthread_rwlock_timedrdlock(lock, &ts) :
+         pthread_rwlock_timedwrlock(lock, &ts);
+      if (ETIMEDOUT != val) return val;
+
+      if (t->forced_to_abort())
+      {
+         t->lock_and_abort();
+         throw aborted_transaction_exception
+         ("aborting tx waiting for a reader-writer lock");
+      }
+   }
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+inline int boost::stm::transaction::pthread_wrlock(RwMutex *lock)
+{
+   Mutex *mutex = latm_rw_mutex(lock);
+
+   transaction *t = get_inflight_tx_of_same_thread(false);
+   int val = t ? lock_rw_in_tx(t, lock, false) : pthread_rwlock_wrlock(lock);
+   if (0 != val) return val;
+
+   try { val = pthread_lock(mutex); }
+   catch (...)
+   {
+      pthread_rwlock_unlock(lock);
+      throw;
+   }
+
+   if (0 != val) pthread_rwlock_unlock(lock);
+   else if (0 != t) remember_latm_rw_hold(lock, false);
+   return val;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+inline int boost::stm::transaction::pthread_trywrlock(RwMutex *lock)
+{
+   Mutex *mutex = latm_rw_mutex(lock);
+
+   int val = pthread_rwlock_trywrlock(lock);
+   if (0 != val) return val;
+
+   try { val = pthread_trylock(mutex); }
+   catch (...)
+   {
+      pthread_rwlock_unlock(lock);
+      throw;
+   }
+
+   if (0 != val) pthread_rwlock_unlock(lock);
+   else if (0 != get_inflight_tx_of_same_thread(false)) remember_latm_rw_hold(lock, false);
+   return val;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+inline int boost::stm::transaction::pthread_rdlock(RwMutex *lock)
+{
+   Mutex *mutex = latm_rw_mutex(lock);
+
+   transaction *t = get_inflight_tx_of_same_thread(false);
+   int val = t ? lock_rw_in_tx(t, lock, true) : pthread_rwlock_rdlock(lock);
+   if (0 != val) return val;
+
+   try { val = latm_shared_lock(mutex, true); }
+   catch (...)
+   {
+      pthread_rwlock_unlock(lock);
+      throw;
+   }
+
+   if (0 != val) pthread_rwlock_unlock(lock);
+   else if (0 != t) remember_latm_rw_hold(lock, true);
+   return val;
+}
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+inline int boost::stm::transaction::pthread_tryrdlock(RwMutex *lock)
+{
+   Mutex *mutex = latm_rw_mutex(lock);
+
+   int val = pthread_rwlock_tryrdlock(lock);
+   if (0 != val) return val;
+
+   try { val = latm_shared_lock(mutex, false); }
+   catch (...)
+   {
+      pthread_rwlock_unlock(lock);
+      throw;
+   }
+
+   if (0 != val) pthread_rwlock_unlock(lock);
+   else if (0 != get_inflight_tx_of_same_thread(false)) remember_latm_rw_hold(lock, true);
+   return val;
+}
+
+//----------------------------------------------------------------------------
+// a shared hold of this thread is released as such, anything else is the
+// thread's exclusive hold
+//----------------------------------------------------------------------------
+inline int boost::stm::transaction::pthread_rwunlock(RwMutex *lock)
+{
+   Mutex *mutex = latm_rw_mutex(lock);
+   forget_latm_rw_hold(lock);
+
+   if (!latm_shared_unlock(mutex))
+   {
+      int val = pthread_unlock(mutex);
+      if (0 != val) return val;
+   }
+
+   return pthread_rwlock_unlock(lock);
+}
+
+//----------------------------------------------------------------------------
+// remembers a hold taken inside a tx of THREAD_ID. a hold which can't be
+// remembered is released again
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::remember_latm_rw_hold(RwMutex *lock, bool shared)
+{
+   try
+   {
+      var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+      latmRwHolds_[THREAD_ID].push_back(latm_rw_hold(lock, shared));
+   }
+   catch (...)
+   {
+      pthread_rwunlock(lock);
+      throw;
+   }
+}
+
+//----------------------------------------------------------------------------
+// forgets the last hold of the lock THREAD_ID took inside a tx, if any
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::forget_latm_rw_hold(RwMutex *lock)
+{
+   var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+   LatmRwHolds::iterator i = latmRwHolds_.find(THREAD_ID);
+   if (latmRwHolds_.end() == i) return;
+
+   std::vector<latm_rw_hold> &holds = i->second;
+
+   for (size_t j = holds.size(); j > 0; --j)
+   {
+      if (lock == holds[j - 1].lock)
+      {
+         holds.erase(holds.begin() + (j - 1));
+         break;
+      }
+   }
+
+   if (holds.empty()) latmRwHolds_.erase(i);
+}
+
+//----------------------------------------------------------------------------
+// the txs of THREAD_ID have committed, the holds they took stay held
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::forget_latm_rw_holds()
+{
+   var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+   latmRwHolds_.erase(THREAD_ID);
+}
+
+//----------------------------------------------------------------------------
+// releases the holds the txs of this thread took once the last of them has
+// aborted, latest first. an exclusive hold made its tx obtain the Mutex,
+// which is forgotten as a commit would. called where the thread holds no
+// STM lock: when the tx ends, restarts or is destroyed
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::release_latm_rw_holds()
+{
+   if (e_aborted != state_ || 0 != get_inflight_tx_of_same_thread(false)) return;
+
+   std::vector<latm_rw_hold> holds;
+   {
+      var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+      LatmRwHolds::iterator i = latmRwHolds_.find(threadId_);
+      if (latmRwHolds_.end() == i) return;
+
+      holds.swap(i->second);
+      latmRwHolds_.erase(i);
+   }
+
+   for (std::vector<latm_rw_hold>::reverse_iterator i = holds.rbegin();
+      holds.rend() != i; ++i)
+   {
+      Mutex *mutex = latm_rw_mutex(i->lock);
+
+      if (i->shared) latm_shared_unlock(mutex);
+      else
+      {
+         currentlyLockedLocksRef().erase(mutex);
+         bool const obtained = 0 != obtainedLocksRef().erase(mutex);
+         if (obtained) forget_obtained_lock(mutex);
+
+         pthread_unlock(mutex);
+         if (obtained) unblock_conflicting_threads(mutex);
+      }
+
+      pthread_rwlock_unlock(i->lock);
+   }
+}
+
+//----------------------------------------------------------------------------
+// records a shared hold of the mutex for THREAD_ID. under deferred updating
+// nothing is in the way: writes are private until commit and committers
+// check latmSharedLocks_. under direct updating the conflicting txs of other
+// threads which have written in place are aborted first and the hold is only
+// recorded once they are gone. if blocking is false EBUSY is returned rather
+// than aborting or waiting for them.
+//
+// unlike an exclusive hold, a shared one taken inside a tx does not make
+// the tx isolated or irrevocable: what it reads under the lock can be read
+// again if the tx aborts, and the thread's own shared holds never stop its
+// txs from writing
+//----------------------------------------------------------------------------
+inline int boost::stm::transaction::latm_shared_lock(Mutex *mutex, bool blocking)
+{
+   int waitTime = 0, aborted = 0;
+
+   for (;;)
+   {
+      {
+         var_auto_lock<PLOCK> a(latm_lock(), general_lock(), inflight_lock(), 0);
+
+         bool const allTxs = doing_full_lock_protection() ||
+            (doing_tm_lock_protection() &&
+            tmConflictingLocks_.end() != tmConflictingLocks_.find(mutex));
+
+         if (!direct_updating() || abort_txs_writing_under_shared_latm_lock
+            (mutex, allTxs, waitTime, aborted, blocking))
+         {
+            latm_shared_record &record = latmSharedLocks_[mutex];
+            if (record.holders.empty()) record.stopsAllWriters = allTxs;
+            record.holders.push_back(THREAD_ID);
+            return 0;
+         }
+      }
+
+      if (!blocking) return EBUSY;
+
+      SLEEP(cm_->lock_sleep_time());
+      waitTime += cm_->lock_sleep_time();
+      ++aborted;
+   }
+}
+
+//----------------------------------------------------------------------------
+// releases a shared hold of the mutex of THREAD_ID, returns false if the
+// thread has none
+//----------------------------------------------------------------------------
+inline bool boost::stm::transaction::latm_shared_unlock(Mutex *mutex)
+{
+   var_auto_lock<PLOCK> a(latm_lock(), general_lock(), 0);
+
+   LatmSharedLocks::iterator i = latmSharedLocks_.find(mutex);
+   if (latmSharedLocks_.end() == i) return false;
+
+   std::vector<size_t> &holders = i->second.holders;
+   std::vector<size_t>::iterator j = std::find(holders.begin(), holders.end(), THREAD_ID);
+   if (holders.end() == j) return false;
+
+   holders.erase(j);
+   if (!holders.empty()) return true;
+
+   latmSharedLocks_.erase(i);
+
+   //-------------------------------------------------------------------------
+   // wake the writers waiting on shared holds, they count themselves under
+   // latmGateMutex_ before releasing general_lock()
+   //-------------------------------------------------------------------------
+   if (0 != latmGateWaiters_)
+   {
+      var_auto_lock<PLOCK> g(&latmGateMutex_, 0);
+      pthread_cond_broadcast(&latmGateCond_);
+   }
+
+   return true;
+}
+
+//----------------------------------------------------------------------------
+// true if no in-flight tx of another thread conflicting with a shared hold
+// of the mutex has written in place. otherwise, if blocking, the writers are forced to abort
+// when the contention manager allows all of them, and false is returned so
+// the caller waits for their aborts to restore the memory.
+//
+// ASSUMPTION: latmMutex_ MUST BE OBTAINED BEFORE CALLING THIS METHOD
+// PRE-CONDITION: general_lock() and inflight_lock() are obtained prior to
+//                calling this method.
+//
+//----------------------------------------------------------------------------
+inline bool boost::stm::transaction::abort_txs_writing_under_shared_latm_lock
+(Mutex *mutex, bool allTxs, int lockWaitTime, int lockAborted, bool blocking)
+{
+   std::list<transaction*> writers;
+
+   if (allTxs)
+   {
+      for (InflightTxes::iterator i = transactionsInFlight_.begin();
+         i != transactionsInFlight_.end(); ++i)
+      {
+         transaction *t = (transaction*)*i;
+         if (THREAD_ID != t->threadId_ && t->isWriting()) writers.push_back(t);
+      }
+   }
+   else
+   {
+      var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+      MutexThreadSetMap::iterator conflicting = latmConflictingThreads_.find(mutex);
+
+      if (latmConflictingThreads_.end() != conflicting)
+      {
+         for (ThreadIdSet::iterator i = conflicting->second.begin();
+            conflicting->second.end() != i; ++i)
+         {
+            if (THREAD_ID == *i) continue;
+
+            InflightOfThread &txs = inflight_of_thread(*i);
+
+            for (InflightOfThread::iterator j = txs.begin(); txs.end() != j; ++j)
+            {
+               if ((*j)->isWriting()) writers.push_back(*j);
+            }
+         }
+      }
+   }
+
+   if (writers.empty()) return true;
+   if (!blocking) return false;
+
+   for (std::list<transaction*>::iterator i = writers.begin(); writers.end() != i; ++i)
+   {
+      if ((*i)->irrevocable() ||
+         !cm_->allow_lock_to_abort_tx(lockWaitTime, lockAborted, false, **i))
+      {
+         return false;
+      }
+   }
+
+   for (std::list<transaction*>::iterator i = writers.begin(); writers.end() != i; ++i)
+   {
+      (*i)->force_to_abort();
+   }
+
+   return false;
+}
+
+//----------------------------------------------------------------------------
+// true if another thread has a shared hold this tx conflicts with
+//
+// PRE-CONDITION: general_lock() is obtained prior to calling this method.
+//
+//----------------------------------------------------------------------------
+inline bool boost::stm::transaction::shared_latm_lock_stops_writes()
+{
+   for (LatmSharedLocks::iterator i = latmSharedLocks_.begin();
+      latmSharedLocks_.end() != i; ++i)
+   {
+      std::vector<size_t> const &holders = i->second.holders;
+
+      // this thread's own shared holds never stop it
+      bool otherHolder = false;
+      for (size_t j = 0; j < holders.size() && !otherHolder; ++j)
+      {
+         otherHolder = threadId_ != holders[j];
+      }
+      if (!otherHolder) continue;
+
+      if (i->second.stopsAllWriters) return true;
+#if USING_TRANSACTION_SPECIFIC_LATM
+      if (get_tx_conflicting_locks().end() != get_tx_conflicting_locks().find(i->first))
+      {
+         return true;
+      }
+#endif
+   }
+
+   return false;
+}
+
+//----------------------------------------------------------------------------
+// waits until no shared hold of another thread conflicts with this tx, or
+// until this tx is forced to abort
+//
+// PRE-CONDITION: general_lock() is obtained prior to calling this method.
+//                it is held again when the method returns
+//
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::wait_for_shared_latm_locks()
+{
+   uint64 start = 0;
+
+   while (!forced_to_abort() && shared_latm_lock_stops_writes())
+   {
+      if (0 == start) start = trace_now();
+
+      lock(&latmGateMutex_);
+      ++latmGateWaiters_;
+      unlock_general_access();
+
+      timed_wait_at_latm_gate();
+
+      --latmGateWaiters_;
+      unlock(&latmGateMutex_);
+      lock_general_access();
+   }
+
+   if (0 != start) bookkeeping_.record_latm_wait(trace_now() - start);
+}
+
+#endif
+
+#endif // BOOST_STM_TRANSACTION_LOCK_AWARE_RW_IMPL_H
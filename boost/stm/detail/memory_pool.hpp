@@ -38,6 +38,7 @@
 #include <memory.h>
 #include <map>
 #include <vector>
+#include <pthread.h>
 
 #include <boost/stm/detail/vector_map.hpp>
 
@@ -48,6 +49,15 @@
 namespace boost { namespace stm {
    int const kDefaultAllocSize = 512;
 
+   //--------------------------------------------------------------------------
+   // size classes of the CachingMemoryPool are kSizeClassGranularity bytes
+   // apart. requests larger than kMaxCachedChunkSize go straight to malloc
+   //--------------------------------------------------------------------------
+   size_t const kSizeClassGranularity = 16;
+   size_t const kMaxCachedChunkSize = 1024;
+   size_t const kSizeClasses = kMaxCachedChunkSize / kSizeClassGranularity;
+   size_t const kDefaultMagazineSize = 64;
+
 /////////////////////////////////////////////////////////////////////////////
 template <typename T>
 class FixedReserve
@@ -176,6 +186,214 @@ private:
    size_t allocSize_;
 };
 
+//-----------------------------------------------------------------------------
+// CachingMemoryPool hands out chunks from per-thread magazines, one for each
+// size class, so the common allocate / free path takes no locks at all.
+//
+// an empty magazine is refilled with a whole batch from the central list of
+// its size class and a magazine which has grown to two batches hands one of
+// them back, so the central mutexes are taken once per batch, not once per
+// chunk. free chunks are linked through their own first word.
+//
+// a thread's magazines are given back to the central lists when it exits.
+//-----------------------------------------------------------------------------
+template <typename T>
+class CachingMemoryPool
+{
+public:
+
+   explicit CachingMemoryPool(size_t const &amount = kDefaultMagazineSize) :
+      batchSize_(amount)
+   {
+      if (batchSize_ < 1) throw "invalid allocation size";
+
+      pthread_key_create(&cacheKey_, &CachingMemoryPool::release_thread_cache);
+
+      for (size_t i = 0; i < kSizeClasses; ++i)
+      {
+         pthread_mutex_init(&central_[i].mutex_, 0);
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   ~CachingMemoryPool()
+   {
+      pthread_key_delete(cacheKey_);
+
+      for (size_t i = 0; i < kSizeClasses; ++i)
+      {
+         for (size_t j = 0; j < central_[i].slabs_.size(); ++j)
+         {
+            free(central_[i].slabs_[j]);
+         }
+         pthread_mutex_destroy(&central_[i].mutex_);
+      }
+   }
+
+   void alloc_size(size_t const &amount) { if (amount > 0) batchSize_ = amount; }
+
+   //////////////////////////////////////////////////////////////////////////
+   void* retrieveChunk(size_t const &size)
+   {
+      if (size > kMaxCachedChunkSize) return malloc(size);
+
+      size_t const sizeClass = size_class(size);
+      magazine &mag = local_cache().magazines_[sizeClass];
+
+      if (0 == mag.head_) refill(sizeClass, mag);
+
+      free_chunk *chunk = mag.head_;
+      mag.head_ = chunk->next_;
+      --mag.count_;
+
+      return chunk;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   void returnChunk(void *m, size_t const &size)
+   {
+      if (size > kMaxCachedChunkSize) { free(m); return; }
+
+      size_t const sizeClass = size_class(size);
+      magazine &mag = local_cache().magazines_[sizeClass];
+
+      free_chunk *chunk = static_cast<free_chunk*>(m);
+      chunk->next_ = mag.head_;
+      mag.head_ = chunk;
+
+      if (++mag.count_ >= 2 * batchSize_) flush(sizeClass, mag, batchSize_);
+   }
+
+private:
+
+   // undefined intentionally
+   CachingMemoryPool(const CachingMemoryPool&);
+   CachingMemoryPool& operator=(const CachingMemoryPool&);
+
+   struct free_chunk
+   {
+      free_chunk *next_;
+   };
+
+   struct magazine
+   {
+      magazine() : head_(0), count_(0) {}
+
+      free_chunk *head_;
+      size_t count_;
+   };
+
+   struct thread_cache
+   {
+      explicit thread_cache(CachingMemoryPool *pool) : pool_(pool) {}
+
+      CachingMemoryPool *pool_;
+      magazine magazines_[kSizeClasses];
+   };
+
+   struct central_list
+   {
+      pthread_mutex_t mutex_;
+      std::vector<magazine> batches_;
+      std::vector<void*> slabs_;
+   };
+
+   //////////////////////////////////////////////////////////////////////////
+   static size_t size_class(size_t const &size)
+   {
+      return 0 == size ? 0 : (size - 1) / kSizeClassGranularity;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   thread_cache& local_cache()
+   {
+      thread_cache *cache = static_cast<thread_cache*>(pthread_getspecific(cacheKey_));
+
+      if (0 == cache)
+      {
+         cache = new thread_cache(this);
+         pthread_setspecific(cacheKey_, cache);
+      }
+
+      return *cache;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   static void release_thread_cache(void *rhs)
+   {
+      thread_cache *cache = static_cast<thread_cache*>(rhs);
+
+      for (size_t i = 0; i < kSizeClasses; ++i)
+      {
+         magazine &mag = cache->magazines_[i];
+         if (0 != mag.head_) cache->pool_->flush(i, mag, mag.count_);
+      }
+
+      delete cache;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // take a batch from the central list, carving a new slab out of malloc'd
+   // memory if the central list has run dry
+   //////////////////////////////////////////////////////////////////////////
+   void refill(size_t const sizeClass, magazine &mag)
+   {
+      central_list &central = central_[sizeClass];
+
+      pthread_mutex_lock(&central.mutex_);
+
+      if (central.batches_.empty())
+      {
+         size_t const chunkSize = (sizeClass + 1) * kSizeClassGranularity;
+         size_t const chunks = batchSize_;
+         char *slab = static_cast<char*>(malloc(chunkSize * chunks));
+         central.slabs_.push_back(slab);
+
+         for (size_t i = 0; i < chunks; ++i)
+         {
+            free_chunk *chunk = reinterpret_cast<free_chunk*>(slab + i * chunkSize);
+            chunk->next_ = mag.head_;
+            mag.head_ = chunk;
+         }
+         mag.count_ += chunks;
+      }
+      else
+      {
+         mag = central.batches_.back();
+         central.batches_.pop_back();
+      }
+
+      pthread_mutex_unlock(&central.mutex_);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // hand the first amount chunks of the magazine back to the central list
+   //////////////////////////////////////////////////////////////////////////
+   void flush(size_t const sizeClass, magazine &mag, size_t const amount)
+   {
+      magazine batch;
+      batch.head_ = mag.head_;
+      batch.count_ = amount;
+
+      free_chunk *last = mag.head_;
+      for (size_t i = 1; i < amount; ++i) last = last->next_;
+
+      mag.head_ = last->next_;
+      mag.count_ -= amount;
+      last->next_ = 0;
+
+      central_list &central = central_[sizeClass];
+
+      pthread_mutex_lock(&central.mutex_);
+      central.batches_.push_back(batch);
+      pthread_mutex_unlock(&central.mutex_);
+   }
+
+   size_t batchSize_;
+   pthread_key_t cacheKey_;
+   central_list central_[kSizeClasses];
+};
+
 } // namespace core
 }
 #endif // MEMORY_RESERVE_H
@@ -0,0 +1,114 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef BOOST_STM_TOP_COUNTER__HPP
+#define BOOST_STM_TOP_COUNTER__HPP
+
+//-----------------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <boost/stm/detail/datatypes.hpp>
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+namespace boost { namespace stm {
+
+//-----------------------------------------------------------------------------
+// top_counter counts the most frequent keys of an unbounded stream in a fixed
+// number of entries (the space-saving algorithm). once full, a new key takes
+// over the entry with the smallest count and inherits that count as its
+// error, so:
+//
+//    count_ - error_ <= real count <= count_
+//
+// and every key seen more than total() / capacity times is always kept.
+//
+// top_counter is not thread safe, the owner serializes add() and top().
+//-----------------------------------------------------------------------------
+template <typename Key>
+class top_counter
+{
+public:
+
+   struct entry
+   {
+      entry(Key const &key, uint64 count, uint64 error) :
+         key_(key), count_(count), error_(error) {}
+
+      Key key_;
+      uint64 count_;
+      uint64 error_;
+   };
+
+   explicit top_counter(size_t capacity) : capacity_(capacity), total_(0)
+   {
+      entries_.reserve(capacity_);
+   }
+
+   //--------------------------------------------------------------------------
+   void add(Key const &key)
+   {
+      ++total_;
+
+      size_t smallest = 0;
+      for (size_t i = 0; i < entries_.size(); ++i)
+      {
+         if (entries_[i].key_ == key)
+         {
+            ++entries_[i].count_;
+            return;
+         }
+         if (entries_[i].count_ < entries_[smallest].count_) smallest = i;
+      }
+
+      if (entries_.size() < capacity_)
+      {
+         entries_.push_back(entry(key, 1, 0));
+         return;
+      }
+
+      uint64 const floor = entries_[smallest].count_;
+      entries_[smallest] = entry(key, floor + 1, floor);
+   }
+
+   //--------------------------------------------------------------------------
+   // the n most counted keys, most counted first; all of them if n is 0
+   //--------------------------------------------------------------------------
+   std::vector<entry> top(size_t n = 0) const
+   {
+      std::vector<entry> sorted(entries_);
+      std::stable_sort(sorted.begin(), sorted.end(), counted_more);
+      if (0 != n && sorted.size() > n) sorted.erase(sorted.begin() + n, sorted.end());
+      return sorted;
+   }
+
+   uint64 total() const { return total_; }
+   size_t capacity() const { return capacity_; }
+
+   void clear() { entries_.clear(); total_ = 0; }
+
+private:
+
+   static bool counted_more(entry const &lhs, entry const &rhs)
+   {
+      return lhs.count_ > rhs.count_;
+   }
+
+   size_t capacity_;
+   uint64 total_;
+   std::vector<entry> entries_;
+};
+
+}}
+#endif // BOOST_STM_TOP_COUNTER__HPP
+
@@ -36,8 +36,13 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
 #include <pthread.h>
+#include <boost/stm/detail/config.hpp>
 #include <boost/stm/detail/datatypes.hpp>
+#include <boost/stm/detail/tx_trace.hpp>
 
 #if 0 //TBR
 #ifdef WINOS
@@ -76,81 +81,381 @@ public:
    }
 };
 
+//-----------------------------------------------------------------------------
+// the counters kept by transaction_bookkeeping
+//-----------------------------------------------------------------------------
+enum bookkeeping_counter
+{
+   kAbortsCounter,
+   kReadAbortsCounter,
+   kWriteAbortsCounter,
+   kAbortPermDeniedCounter,
+   kCommitsCounter,
+   kHandOffsCounter,
+   kNewMemoryCommitsCounter,
+   kNewMemoryAbortsCounter,
+   kDeletedMemoryCommitsCounter,
+   kDeletedMemoryAbortsCounter,
+   kReadStayedAsReadCounter,
+   kReadChangedToWriteCounter,
+   kCommitTimeMsCounter,
+   kLockConvoyMsCounter,
+   kCommittedWorkCounter,     // objects opened by attempts which committed
+   kAbortedWorkCounter,       // objects opened by attempts which aborted
+   kScheduledCounter,         // attempts started holding the scheduler token
+   kIrrevocablePromotionsCounter, // transactions out of retries made irrevocable
+   kSerialFallbacksCounter,   // times the serial fallback tripped
+   kSerializedCounter,        // attempts started holding the serial lock
+   kAllCommitsCounter,        // every commit, read only ones too
+   kLatmWaitsCounter,         // waits for LATM locks to be released
+   kLatmWaitNsCounter,        // nanoseconds spent in those waits
+   kBookkeepingCounters
+};
+
+size_t const kBookkeepingCacheLine = 64;
+
+//-----------------------------------------------------------------------------
+// the latencies kept by transaction_bookkeeping, all in nanoseconds
+//-----------------------------------------------------------------------------
+enum bookkeeping_latency
+{
+   kBeginToCommitLatency,     // last begin of a transaction to its commit
+   kCommitLockHoldLatency,    // transactionMutex_ held by a committing tx
+   kLatmWaitLatency,          // blocked by LATM before going in flight
+   kLockTxSpinLatency,        // spinning in lock_tx() for a tx's own mutex
+   kRetryLatency,             // first begin to commit, over all the retries
+   kBookkeepingLatencies
+};
+
+//-----------------------------------------------------------------------------
+// latencies are counted in log buckets: values below 2^kLatencySubBucketBits
+// have a bucket each, above that every power of two is split into
+// 2^kLatencySubBucketBits linear buckets. a percentile is therefore never
+// more than 1/2^kLatencySubBucketBits above the real value, whatever the
+// magnitude, and the whole 64 bit range fits in a few hundred buckets.
+//-----------------------------------------------------------------------------
+size_t const kLatencySubBucketBits = 3;
+size_t const kLatencySubBuckets = size_t(1) << kLatencySubBucketBits;
+size_t const kLatencyBuckets = (64 - kLatencySubBucketBits + 1) << kLatencySubBucketBits;
+
+//-----------------------------------------------------------------------------
+// a point in time copy of one latency histogram, either of one thread or
+// merged over all of them
+//-----------------------------------------------------------------------------
+class latency_histogram
+{
+public:
+
+   latency_histogram() : count_(0), sum_(0), max_(0)
+   {
+      for (size_t i = 0; i < kLatencyBuckets; ++i) counts_[i] = 0;
+   }
+
+   uint64 count() const { return count_; }
+   uint64 total() const { return sum_; }
+   uint64 max() const { return max_; }
+   uint64 mean() const { return 0 == count_ ? 0 : sum_ / count_; }
+
+   uint64 p50() const { return percentile(0.5); }
+   uint64 p99() const { return percentile(0.99); }
+   uint64 p999() const { return percentile(0.999); }
+
+   //--------------------------------------------------------------------------
+   // the smallest latency at least the fraction p of the samples are not
+   // above, rounded up to the top of its bucket
+   //--------------------------------------------------------------------------
+   uint64 percentile(double p) const
+   {
+      if (0 == count_) return 0;
+
+      uint64 rank = (uint64)(p * count_ + 0.5);
+      if (rank < 1) rank = 1;
+      if (rank > count_) rank = count_;
+
+      uint64 seen = 0;
+      for (size_t i = 0; i < kLatencyBuckets; ++i)
+      {
+         seen += counts_[i];
+         if (seen >= rank) return bucket_top(i) < max_ ? bucket_top(i) : max_;
+      }
+
+      return max_;
+   }
+
+   latency_histogram& operator+=(latency_histogram const &rhs)
+   {
+      for (size_t i = 0; i < kLatencyBuckets; ++i) counts_[i] += rhs.counts_[i];
+      count_ += rhs.count_;
+      sum_ += rhs.sum_;
+      if (rhs.max_ > max_) max_ = rhs.max_;
+      return *this;
+   }
+
+   //--------------------------------------------------------------------------
+   static size_t bucket_of(uint64 ns)
+   {
+      if (ns < kLatencySubBuckets) return (size_t)ns;
+
+      size_t const shift = 63 - __builtin_clzll(ns) - kLatencySubBucketBits;
+      return ((shift + 1) << kLatencySubBucketBits) +
+         (size_t)((ns >> shift) & (kLatencySubBuckets - 1));
+   }
+
+   static uint64 bucket_top(size_t bucket)
+   {
+      if (bucket < kLatencySubBuckets) return bucket;
+
+      size_t const shift = (bucket >> kLatencySubBucketBits) - 1;
+      uint64 const low = (uint64)((bucket & (kLatencySubBuckets - 1)) | kLatencySubBuckets) << shift;
+      return low + ((uint64(1) << shift) - 1);
+   }
+
+private:
+
+   friend class transaction_bookkeeping;
+
+   uint64 counts_[kLatencyBuckets];
+   uint64 count_;
+   uint64 sum_;
+   uint64 max_;
+};
+
+//-----------------------------------------------------------------------------
+// a point in time copy of the bookkeeping counters, either of one thread or
+// summed over all of them
+//-----------------------------------------------------------------------------
+class bookkeeping_snapshot
+{
+public:
+
+   bookkeeping_snapshot()
+   {
+      for (size_t i = 0; i < kBookkeepingCounters; ++i) counts_[i] = 0;
+   }
+
+   uint64 lockConvoyMs() const { return counts_[kLockConvoyMsCounter]; }
+   uint64 commitTimeMs() const { return counts_[kCommitTimeMsCounter]; }
+   uint64 readAborts() const { return counts_[kReadAbortsCounter]; }
+   uint64 writeAborts() const { return counts_[kWriteAbortsCounter]; }
+   uint64 abortPermDenied() const { return counts_[kAbortPermDeniedCounter]; }
+   uint64 totalAborts() const { return counts_[kAbortsCounter]; }
+   uint64 commits() const { return counts_[kCommitsCounter]; }
+   uint64 handOffs() const { return counts_[kHandOffsCounter]; }
+   uint64 newMemoryAborts() const { return counts_[kNewMemoryAbortsCounter]; }
+   uint64 newMemoryCommits() const { return counts_[kNewMemoryCommitsCounter]; }
+   uint64 deletedMemoryAborts() const { return counts_[kDeletedMemoryAbortsCounter]; }
+   uint64 deletedMemoryCommits() const { return counts_[kDeletedMemoryCommitsCounter]; }
+   uint64 readChangedToWrite() const { return counts_[kReadChangedToWriteCounter]; }
+   uint64 readStayedAsRead() const { return counts_[kReadStayedAsReadCounter]; }
+   uint64 committedWork() const { return counts_[kCommittedWorkCounter]; }
+   uint64 abortedWork() const { return counts_[kAbortedWorkCounter]; }
+   uint64 scheduled() const { return counts_[kScheduledCounter]; }
+   uint64 irrevocablePromotions() const { return counts_[kIrrevocablePromotionsCounter]; }
+   uint64 serialFallbacks() const { return counts_[kSerialFallbacksCounter]; }
+   uint64 allCommits() const { return counts_[kAllCommitsCounter]; }
+   uint64 serialized() const { return counts_[kSerializedCounter]; }
+   uint64 latmWaits() const { return counts_[kLatmWaitsCounter]; }
+   uint64 latmWaitNs() const { return counts_[kLatmWaitNsCounter]; }
+
+   uint64 operator[](bookkeeping_counter const &c) const { return counts_[c]; }
+
+   bookkeeping_snapshot& operator+=(bookkeeping_snapshot const &rhs)
+   {
+      for (size_t i = 0; i < kBookkeepingCounters; ++i) counts_[i] += rhs.counts_[i];
+      return *this;
+   }
+
+private:
+
+   friend class transaction_bookkeeping;
+
+   uint64 counts_[kBookkeepingCounters];
+};
+
+//-----------------------------------------------------------------------------
+// transaction_bookkeeping keeps one cache line aligned block of counters per
+// thread. a block is only ever written by its own thread, so incrementing is
+// a relaxed load and store with no locked instruction and no line shared with
+// another thread. readers sum the blocks with relaxed loads; a snapshot taken
+// while threads are running is not atomic across counters, but every counter
+// in it is a value its thread really had.
+//
+// blocks outlive their threads so the totals still include threads which
+// have exited. they are never freed: the bookkeeping is a static of the
+// transaction and threads may still be counting while statics are destroyed
+// at exit. the registry mutex is only taken the first time a thread
+// counts something and when a snapshot is taken.
 //-----------------------------------------------------------------------------
 class transaction_bookkeeping
 {
 public:
 
-   typedef std::map<uint32, uint32> thread_commit_map;
+   typedef std::map<size_t, bookkeeping_snapshot> thread_snapshot_map;
    typedef std::map<ThreadIdAndCommitId, uint32> CommitHistory;
    typedef std::map<ThreadIdAndCommitId, uint32> AbortHistory;
 
-   transaction_bookkeeping() : aborts_(0), writeAborts_(0), readAborts_(0), 
-      abortPermDenied_(0), commits_(0), handOffs_(0), newMemoryCommits_(0), 
-      newMemoryAborts_(0), deletedMemoryCommits_(0), deletedMemoryAborts_(0),
-      readStayedAsRead_(0), readChangedToWrite_(0), commitTimeMs_(0), lockConvoyMs_(0)
+   transaction_bookkeeping() : isLoggingAbortAndCommitSize_(false), aborts_(0)
    {
-      //abortTrackingMutex_ = PTHREAD_MUTEX_INITIALIZER;
+      pthread_key_create(&countersKey_, 0);
+      pthread_mutex_init(&registryMutex_, 0);
    }
 
-   uint32 const & lockConvoyMs() const { return lockConvoyMs_; }
-   uint32 const & commitTimeMs() const { return commitTimeMs_; }
-   uint32 const & readAborts() const { return readAborts_; }
-   uint32 const & writeAborts() const { return writeAborts_; }
-   uint32 const & abortPermDenied() const { return abortPermDenied_; }
-   uint32 const totalAborts() const { return readAborts_ + writeAborts_ + abortPermDenied_; }
-   uint32 const & commits() const { return commits_; }
-   uint32 const & handOffs() const { return handOffs_; }
-   uint32 const & newMemoryAborts() const { return newMemoryAborts_; }
-   uint32 const & newMemoryCommits() const { return newMemoryCommits_; }
-   uint32 const & deletedMemoryAborts() const { return deletedMemoryAborts_; }
-   uint32 const & deletedMemoryCommits() const { return deletedMemoryCommits_; }
-   uint32 const & readChangedToWrite() const { return readChangedToWrite_; }
-   uint32 const & readStayedAsRead() const { return readStayedAsRead_; }
-
-   void inc_read_aborts() { ++readAborts_; }
-   void inc_write_aborts() { ++writeAborts_; }
-
-   void inc_thread_commits(uint32 threadId) 
+   //--------------------------------------------------------------------------
+   // totals over all threads
+   //--------------------------------------------------------------------------
+   bookkeeping_snapshot aggregate() const
    {
-#if 0
-      std::map<uint32, uint32>::iterator i = threadedCommits_.find(threadId);
+      bookkeeping_snapshot total;
 
-      if (threadedCommits_.end() == i) threadedCommits_[threadId] = 1;
-      else i->second = i->second + 1;
-#endif
+      pthread_mutex_lock(&registryMutex_);
+      for (size_t i = 0; i < registry_.size(); ++i)
+      {
+         total += registry_[i]->snapshot();
+      }
+      pthread_mutex_unlock(&registryMutex_);
+
+      return total;
    }
 
-   void inc_thread_aborts(uint32 threadId) 
+   //--------------------------------------------------------------------------
+   // the same counters broken down by thread id
+   //--------------------------------------------------------------------------
+   thread_snapshot_map per_thread() const
    {
-#if 0
-      std::map<uint32, uint32>::iterator i = threadedAborts_.find(threadId);
+      thread_snapshot_map threads;
 
-      if (threadedAborts_.end() == i)
+      pthread_mutex_lock(&registryMutex_);
+      for (size_t i = 0; i < registry_.size(); ++i)
       {
-         threadedAborts_.insert(std::make_pair(threadId, 1));
+         threads[registry_[i]->threadId_] += registry_[i]->snapshot();
       }
-      else
+      pthread_mutex_unlock(&registryMutex_);
+
+      return threads;
+   }
+
+   uint64 lockConvoyMs() const { return aggregate().lockConvoyMs(); }
+   uint64 commitTimeMs() const { return aggregate().commitTimeMs(); }
+   uint64 readAborts() const { return aggregate().readAborts(); }
+   uint64 writeAborts() const { return aggregate().writeAborts(); }
+   uint64 abortPermDenied() const { return aggregate().abortPermDenied(); }
+   uint64 totalAborts() const { return aggregate().totalAborts(); }
+   uint64 commits() const { return aggregate().commits(); }
+   uint64 handOffs() const { return aggregate().handOffs(); }
+   uint64 newMemoryAborts() const { return aggregate().newMemoryAborts(); }
+   uint64 newMemoryCommits() const { return aggregate().newMemoryCommits(); }
+   uint64 deletedMemoryAborts() const { return aggregate().deletedMemoryAborts(); }
+   uint64 deletedMemoryCommits() const { return aggregate().deletedMemoryCommits(); }
+   uint64 readChangedToWrite() const { return aggregate().readChangedToWrite(); }
+   uint64 readStayedAsRead() const { return aggregate().readStayedAsRead(); }
+   uint64 committedWork() const { return aggregate().committedWork(); }
+   uint64 abortedWork() const { return aggregate().abortedWork(); }
+   uint64 scheduled() const { return aggregate().scheduled(); }
+   uint64 irrevocablePromotions() const { return aggregate().irrevocablePromotions(); }
+   uint64 serialFallbacks() const { return aggregate().serialFallbacks(); }
+   uint64 allCommits() const { return aggregate().allCommits(); }
+   uint64 serialized() const { return aggregate().serialized(); }
+   uint64 latmWaits() const { return aggregate().latmWaits(); }
+   uint64 latmWaitNs() const { return aggregate().latmWaitNs(); }
+
+   //--------------------------------------------------------------------------
+   // one latency merged over all threads, e.g. latency(kRetryLatency).p999()
+   //--------------------------------------------------------------------------
+   latency_histogram latency(bookkeeping_latency const l) const
+   {
+      latency_histogram merged;
+
+      pthread_mutex_lock(&registryMutex_);
+      for (size_t i = 0; i < registry_.size(); ++i)
       {
-         i->second += 1;
+         registry_[i]->add_latency_to(l, merged);
       }
-#endif
+      pthread_mutex_unlock(&registryMutex_);
+
+      return merged;
    }
 
-   thread_commit_map const & threadedCommits() const { return threadedCommits_; }
-   thread_commit_map const & threadedAborts() const { return threadedAborts_; }
-
-   void inc_lock_convoy_ms(uint32 const &rhs) { lockConvoyMs_ += rhs; }
-   void inc_commit_time_ms(uint32 const &rhs) { commitTimeMs_ += rhs; }
-   void inc_commits() { ++commits_; inc_thread_commits(THREAD_ID); }
-   void inc_abort_perm_denied(uint32 const &threadId) { ++abortPermDenied_; inc_thread_aborts(threadId); }
-   void inc_handoffs() { ++handOffs_; }
-   void inc_new_mem_aborts_by(uint32 const &rhs) { newMemoryAborts_ += rhs; }
-   void inc_new_mem_commits_by(uint32 const &rhs) { newMemoryCommits_ += rhs; }
-   void inc_del_mem_aborts_by(uint32 const &rhs) { deletedMemoryAborts_ += rhs; }
-   void inc_del_mem_commits_by(uint32 const &rhs) { deletedMemoryCommits_ += rhs; }
-   void incrementReadChangedToWrite() { ++readChangedToWrite_; }
-   void incrementReadStayedAsRead() { ++readStayedAsRead_; }
+   static char const * latency_name(bookkeeping_latency const l)
+   {
+      switch (l)
+      {
+      case kBeginToCommitLatency: return "begin to commit";
+      case kCommitLockHoldLatency: return "commit lock hold";
+      case kLatmWaitLatency: return "latm wait";
+      case kLockTxSpinLatency: return "lock_tx spin";
+      case kRetryLatency: return "retries to commit";
+      default: return "unknown";
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   // record_latency() adds one sample, start_latency() / stop_latency() time
+   // an interval of the calling thread which begins and ends in different
+   // functions. stopping an interval which was not started does nothing.
+   //
+   // latencies cost clock reads on the transactional path, so they are only
+   // measured when MEASURING_LATENCIES is defined; otherwise these do nothing
+   // and the histograms stay empty
+   //--------------------------------------------------------------------------
+#if MEASURING_LATENCIES
+   void record_latency(bookkeeping_latency const l, uint64 const ns)
+   {
+      local_counters().record(l, ns);
+   }
+
+   void start_latency(bookkeeping_latency const l)
+   {
+      local_counters().latencyStart_[l] = boost::stm::trace_now();
+   }
+
+   void stop_latency(bookkeeping_latency const l)
+   {
+      thread_counters &c = local_counters();
+
+      if (0 != c.latencyStart_[l])
+      {
+         c.record(l, boost::stm::trace_now() - c.latencyStart_[l]);
+         c.latencyStart_[l] = 0;
+      }
+   }
+#else
+   void record_latency(bookkeeping_latency const, uint64 const) {}
+   void start_latency(bookkeeping_latency const) {}
+   void stop_latency(bookkeeping_latency const) {}
+#endif
+
+   void inc_aborts() { bump(kAbortsCounter); }
+   void inc_read_aborts() { bump(kReadAbortsCounter); }
+   void inc_write_aborts() { bump(kWriteAbortsCounter); }
+   void inc_lock_convoy_ms(uint32 const &rhs) { bump(kLockConvoyMsCounter, rhs); }
+   void inc_commit_time_ms(uint32 const &rhs) { bump(kCommitTimeMsCounter, rhs); }
+   void inc_commits() { bump(kCommitsCounter); }
+   void inc_abort_perm_denied() { bump(kAbortPermDeniedCounter); }
+   void inc_handoffs() { bump(kHandOffsCounter); }
+   void inc_new_mem_aborts_by(uint32 const &rhs) { bump(kNewMemoryAbortsCounter, rhs); }
+   void inc_new_mem_commits_by(uint32 const &rhs) { bump(kNewMemoryCommitsCounter, rhs); }
+   void inc_del_mem_aborts_by(uint32 const &rhs) { bump(kDeletedMemoryAbortsCounter, rhs); }
+   void inc_del_mem_commits_by(uint32 const &rhs) { bump(kDeletedMemoryCommitsCounter, rhs); }
+   void incrementReadChangedToWrite() { bump(kReadChangedToWriteCounter); }
+   void incrementReadStayedAsRead() { bump(kReadStayedAsReadCounter); }
+   void inc_committed_work_by(uint64 const &rhs) { bump(kCommittedWorkCounter, rhs); }
+   void inc_aborted_work_by(uint64 const &rhs) { bump(kAbortedWorkCounter, rhs); }
+   void inc_scheduled() { bump(kScheduledCounter); }
+   void inc_irrevocable_promotions() { bump(kIrrevocablePromotionsCounter); }
+   void inc_serial_fallbacks() { bump(kSerialFallbacksCounter); }
+   void inc_all_commits() { bump(kAllCommitsCounter); }
+   void inc_serialized() { bump(kSerializedCounter); }
+
+   //--------------------------------------------------------------------------
+   // a LATM wait is counted whether latencies are measured or not, its
+   // latency only when they are
+   //--------------------------------------------------------------------------
+   void record_latm_wait(uint64 const &ns)
+   {
+      bump(kLatmWaitsCounter);
+      bump(kLatmWaitNsCounter, ns);
+      record_latency(kLatmWaitLatency, ns);
+   }
 
    CommitHistory const& getCommitReadSetList() const { return committedReadSetSize_; }
    CommitHistory const& getCommitWriteSetList() const { return committedWriteSetSize_; }
@@ -222,29 +527,51 @@ public:
    {
       using namespace std;
 
+      bookkeeping_snapshot const total = that.aggregate();
+      thread_snapshot_map const threads = that.per_thread();
+
       out << "########################################" << endl;
+      out << " commits: " << total.commits() << "  aborts: " << total.totalAborts()
+          << "  (read: " << total.readAborts() << "  write: " << total.writeAborts()
+          << "  perm denied: " << total.abortPermDenied() << ")"
+          << "  handoffs: " << total.handOffs() << endl;
 
-      for (thread_commit_map::const_iterator i = that.threadedCommits().begin(); 
-         i != that.threadedCommits().end(); ++i)
+      if (0 != total.scheduled())
       {
-         out << " thread [" << i->first << "]:  commits: " << i->second << "  aborts: ";
+         out << " scheduled: " << total.scheduled() << endl;
+      }
 
-         bool found = false;
+      if (0 != total.irrevocablePromotions())
+      {
+         out << " promoted to irrevocable: " << total.irrevocablePromotions() << endl;
+      }
 
-         for (thread_commit_map::const_iterator j = that.threadedAborts().begin(); 
-            j != that.threadedAborts().end(); ++j)
-         {
-            if (j->first == i->first)
-            {
-               out << j->second;
-               found = true;
-               break;
-            }
-         }
+      if (0 != total.serialFallbacks())
+      {
+         out << " serial fallbacks: " << total.serialFallbacks()
+             << "  serialized: " << total.serialized() << endl;
+      }
 
-         if (!found) out << 0;
+      if (0 != total.latmWaits())
+      {
+         out << " latm waits: " << total.latmWaits()
+             << "  waited ns: " << total.latmWaitNs() << endl;
+      }
 
-         out << endl;
+      for (thread_snapshot_map::const_iterator i = threads.begin(); i != threads.end(); ++i)
+      {
+         out << " thread [" << i->first << "]:  commits: " << i->second.commits()
+             << "  aborts: " << i->second.totalAborts() << endl;
+      }
+
+      for (size_t l = 0; l < kBookkeepingLatencies; ++l)
+      {
+         latency_histogram const h = that.latency(bookkeeping_latency(l));
+         if (0 == h.count()) continue;
+
+         out << " " << latency_name(bookkeeping_latency(l)) << " (ns):  count: " << h.count()
+             << "  p50: " << h.p50() << "  p99: " << h.p99() << "  p999: " << h.p999()
+             << "  max: " << h.max() << endl;
       }
 
       return out;
@@ -252,6 +579,108 @@ public:
 
 private:
 
+   // undefined intentionally
+   transaction_bookkeeping(transaction_bookkeeping const &);
+   transaction_bookkeeping& operator=(transaction_bookkeeping const &);
+
+   //--------------------------------------------------------------------------
+   struct thread_counters
+   {
+      explicit thread_counters(size_t threadId) : threadId_(threadId)
+      {
+         for (size_t i = 0; i < kBookkeepingCounters; ++i) counts_[i].store(0);
+
+         for (size_t l = 0; l < kBookkeepingLatencies; ++l)
+         {
+            for (size_t i = 0; i < kLatencyBuckets; ++i) latency_[l][i].store(0);
+            latencySum_[l].store(0);
+            latencyMax_[l].store(0);
+            latencyStart_[l] = 0;
+         }
+      }
+
+      //-----------------------------------------------------------------------
+      // owner only, like bump()
+      //-----------------------------------------------------------------------
+      void record(bookkeeping_latency const l, uint64 const ns)
+      {
+         std::atomic<uint64> &bucket = latency_[l][latency_histogram::bucket_of(ns)];
+         bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+         latencySum_[l].store(latencySum_[l].load(std::memory_order_relaxed) + ns,
+            std::memory_order_relaxed);
+         if (ns > latencyMax_[l].load(std::memory_order_relaxed))
+         {
+            latencyMax_[l].store(ns, std::memory_order_relaxed);
+         }
+      }
+
+      void add_latency_to(bookkeeping_latency const l, latency_histogram &h) const
+      {
+         for (size_t i = 0; i < kLatencyBuckets; ++i)
+         {
+            uint64 const n = latency_[l][i].load(std::memory_order_relaxed);
+            h.counts_[i] += n;
+            h.count_ += n;
+         }
+
+         h.sum_ += latencySum_[l].load(std::memory_order_relaxed);
+         uint64 const max = latencyMax_[l].load(std::memory_order_relaxed);
+         if (max > h.max_) h.max_ = max;
+      }
+
+      bookkeeping_snapshot snapshot() const
+      {
+         bookkeeping_snapshot s;
+         for (size_t i = 0; i < kBookkeepingCounters; ++i)
+         {
+            s.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+         }
+         return s;
+      }
+
+      std::atomic<uint64> counts_[kBookkeepingCounters];
+      size_t threadId_;
+
+      std::atomic<uint64> latency_[kBookkeepingLatencies][kLatencyBuckets];
+      std::atomic<uint64> latencySum_[kBookkeepingLatencies];
+      std::atomic<uint64> latencyMax_[kBookkeepingLatencies];
+      uint64 latencyStart_[kBookkeepingLatencies];
+   };
+
+   //--------------------------------------------------------------------------
+   thread_counters& local_counters()
+   {
+      thread_counters *c = static_cast<thread_counters*>(pthread_getspecific(countersKey_));
+
+      if (0 == c)
+      {
+         void *m = 0;
+         size_t const size = (sizeof(thread_counters) + kBookkeepingCacheLine - 1)
+            / kBookkeepingCacheLine * kBookkeepingCacheLine;
+
+         if (0 != posix_memalign(&m, kBookkeepingCacheLine, size)) throw "out of memory";
+         c = new (m) thread_counters(THREAD_ID);
+
+         pthread_mutex_lock(&registryMutex_);
+         registry_.push_back(c);
+         pthread_mutex_unlock(&registryMutex_);
+
+         pthread_setspecific(countersKey_, c);
+      }
+
+      return *c;
+   }
+
+   //--------------------------------------------------------------------------
+   // only the owning thread writes its counters, a plain read-modify-write of
+   // the relaxed value is enough
+   //--------------------------------------------------------------------------
+   void bump(bookkeeping_counter const c, uint64 const rhs = 1)
+   {
+      std::atomic<uint64> &count = local_counters().counts_[c];
+      count.store(count.load(std::memory_order_relaxed) + rhs, std::memory_order_relaxed);
+   }
+
    bool isLoggingAbortAndCommitSize_;
 
    AbortHistory abortedReadSetSize_;
@@ -262,25 +691,12 @@ private:
    std::map<uint32, bool> waitingForCommitReadFromThread;
    std::map<uint32, bool> waitingForCommitWriteFromThread;
 
-   thread_commit_map threadedCommits_;
-   thread_commit_map threadedAborts_;
-
+   // commit id sequence of the abort / commit set size history
    uint32 aborts_;
-   uint32 writeAborts_;
-   uint32 readAborts_;
-   uint32 abortPermDenied_;
-   uint32 commits_;
-   uint32 handOffs_;
-   uint32 newMemoryCommits_;
-   uint32 newMemoryAborts_;
-   uint32 deletedMemoryCommits_;
-   uint32 deletedMemoryAborts_;
-   uint32 readStayedAsRead_;
-   uint32 readChangedToWrite_;
-   uint32 commitTimeMs_;
-   uint32 lockConvoyMs_;
-
-   //Mutex abortTrackingMutex_;
+
+   pthread_key_t countersKey_;
+   mutable pthread_mutex_t registryMutex_;
+   std::vector<thread_counters*> registry_;
 };
 
 
@@ -54,15 +54,6 @@
 
 using namespace std;
 
-#if CAPTURING_PROFILE_DATA
-inline unsigned int boost::stm::transaction::txTime()
-{
-   clock_t clk = clock();
-
-   return (unsigned int)clk;
-}
-#endif
-
 //--------------------------------------------------------------------------
 //
 // PRE-CONDITION: transactionsInFlightMutex is obtained prior to call
@@ -82,6 +73,33 @@ inline bool boost::stm::transaction::isolatedTxInFlight()
    return false;
 }
 
+//--------------------------------------------------------------------------
+//
+// PRE-CONDITION: transactionsInFlightMutex is obtained prior to call
+//
+//--------------------------------------------------------------------------
+inline bool boost::stm::transaction::otherThreadTxInFlight()
+{
+   for (InflightTxes::iterator i = transactionsInFlight_.begin();
+      i != transactionsInFlight_.end(); ++i)
+   {
+      if (((transaction*)*i)->threadId_ != this->threadId_) return true;
+   }
+
+   return false;
+}
+
+//--------------------------------------------------------------------------
+//
+// PRE-CONDITION: transactionsInFlightMutex is obtained prior to call
+//
+//--------------------------------------------------------------------------
+inline bool boost::stm::transaction::otherThreadSerialTxInFlight() const
+{
+   size_t const serialThread = serialThread_.load();
+   return kInvalidThread != serialThread && threadId_ != serialThread;
+}
+
 //--------------------------------------------------------------------------
 //
 // PRE-CONDITION: transactionsInFlightMutex is obtained prior to call
@@ -145,19 +163,34 @@ inline bool boost::stm::transaction::canAbortAllInFlightTxs()
 inline void boost::stm::transaction::make_irrevocable()
 {
    if (irrevocable()) return;
-   //-----------------------------------------------------------------------
-   // in order to make a tx irrevocable, no other irrevocable txs can be
-   // running. if there are, we must stall until they commit.
-   //-----------------------------------------------------------------------
+
+   if (!wait_to_become_irrevocable())
+   {
+      lock_and_abort();
+      throw aborted_transaction_exception
+      ("aborting tx in make_irrevocable");
+   }
+}
+
+//--------------------------------------------------------------------------
+// in order to make a tx irrevocable, no other irrevocable txs can be
+// running. if there are, we must stall until they commit. a committer may
+// force this tx to abort while it stalls; it then gives up, false, since
+// it could never commit as irrevocable
+//--------------------------------------------------------------------------
+inline bool boost::stm::transaction::wait_to_become_irrevocable()
+{
    while (true)
    {
+      if (forced_to_abort()) return false;
+
       lock_inflight_access();
 
-      if (!irrevocableTxInFlight())
+      if (!forced_to_abort() && !irrevocableTxInFlight())
       {
          tx_type(eIrrevocableTx);
          unlock_inflight_access();
-         return;
+         return true;
       }
 
       unlock_inflight_access();
@@ -166,6 +199,22 @@ inline void boost::stm::transaction::make_irrevocable()
    }
 }
 
+//--------------------------------------------------------------------------
+// make_irrevocable() without the stall, false if another irrevocable tx is
+// in-flight
+//--------------------------------------------------------------------------
+inline bool boost::stm::transaction::try_make_irrevocable()
+{
+   if (irrevocable()) return true;
+
+   var_auto_lock<PLOCK> a(inflight_lock(), 0);
+
+   if (irrevocableTxInFlight()) return false;
+
+   tx_type(eIrrevocableTx);
+   return true;
+}
+
 //--------------------------------------------------------------------------
 //--------------------------------------------------------------------------
 inline void boost::stm::transaction::make_isolated()
@@ -189,7 +238,11 @@ inline void boost::stm::transaction::make_isolated()
       lock_general_access();
       lock_inflight_access();
 
-      if (!irrevocableTxInFlight() && canAbortAllInFlightTxs())
+      //--------------------------------------------------------------------
+      // a locker may have forced this tx to abort since the check above; it
+      // waits for the tx to leave, so the tx must not become isolated
+      //--------------------------------------------------------------------
+      if (!forced_to_abort() && !irrevocableTxInFlight() && canAbortAllInFlightTxs())
       {
          tx_type(eIrrevocableAndIsolatedTx);
          abortAllInFlightTxs();
@@ -205,6 +258,32 @@ inline void boost::stm::transaction::make_isolated()
    }
 }
 
+//--------------------------------------------------------------------------
+// make_isolated() without the stall, false if another irrevocable tx is
+// in-flight or one of the in-flight txs may not be aborted
+//--------------------------------------------------------------------------
+inline bool boost::stm::transaction::try_make_isolated()
+{
+   if (isolated()) return true;
+
+   {
+      var_auto_lock<PLOCK> a(general_lock(), inflight_lock(), 0);
+
+      if (!forced_to_abort())
+      {
+         if (irrevocableTxInFlight() || !canAbortAllInFlightTxs()) return false;
+
+         tx_type(eIrrevocableAndIsolatedTx);
+         abortAllInFlightTxs();
+         return true;
+      }
+   }
+
+   lock_and_abort();
+   throw aborted_transaction_exception
+   ("aborting tx in try_make_isolated");
+}
+
 //--------------------------------------------------------------------------
 //--------------------------------------------------------------------------
 inline bool boost::stm::transaction::irrevocable() const
@@ -254,6 +333,7 @@ inline void boost::stm::transaction::commit_deferred_update_tx()
       SLEEP(1);
    }
 
+   bookkeeping_.start_latency(kCommitLockHoldLatency);
    lock_tx();
 
    //--------------------------------------------------------------------------
@@ -295,9 +375,18 @@ inline void boost::stm::transaction::commit_deferred_update_tx()
 //-----------------------------------------------------------------------------
 inline void boost::stm::transaction::lock_tx()
 {
-   while (0 != trylock(mutex()))
+   if (0 != trylock(mutex()))
    {
-      SLEEP(1);
+#if MEASURING_LATENCIES
+      uint64 const start = trace_now();
+#endif
+      while (0 != trylock(mutex()))
+      {
+         SLEEP(1);
+      }
+#if MEASURING_LATENCIES
+      bookkeeping_.record_latency(kLockTxSpinLatency, trace_now() - start);
+#endif
    }
 
    hasMutex_ = 1;
@@ -351,6 +440,8 @@ inline void boost::stm::transaction::lock_general_access()
 inline void boost::stm::transaction::unlock_general_access()
 {
    unlock(&transactionMutex_);
+   // ends the hold time if a commit took the lock
+   bookkeeping_.stop_latency(kCommitLockHoldLatency);
 }
 
 //--------------------------------------------------------------------------
@@ -519,26 +610,57 @@ inline boost::stm::transaction::transaction() :
    hasMutex_(0), priority_(0),
    state_(e_no_state),
    reads_(0),
-#if CAPTURING_PROFILE_DATA
-   ostrRef_(*threadOstringStream_.find(threadId_)->second),
-   txFileAndNumberMap_(*threadFileAndNumberMap_.find(threadId_)->second),
+   epochRef_(*threadEpochRecords_.find(threadId_)->second),
+   traceRef_(*threadTraceRings_.find(threadId_)->second),
+   abortReason_(eTraceAbortSelf),
+   site_(0), siteStart_(0), siteAborts_(0), siteRetries_(0), siteWrites_(0),
+   beginTime_(0), firstBeginTime_(0), beginStamp_(0), consecutiveAborts_(0), readsAtBegin_(0),
+   retryBudget_(defaultRetryBudget_),
+   origin_(0),
+   scheduleRef_(*threadScheduleRecords_.find(threadId_)->second),
+   scheduled_(false),
+   serialized_(false),
+#if PERFORMING_LATM
+   latmHeldRef_(*threadLatmHeld_.find(threadId_)->second),
+   latmWaitRef_(*threadLatmWaits_.find(threadId_)->second),
 #endif
-   startTime_((size_t)time(0))
+   inflightOfThreadRef_(*threadInflightTxes_.find(threadId_)->second)
 {
    // Unlock now so that other transactions can be constructed
    // Keep in mind that the following operations are no longer protected
    unlock(general_lock());
 
-   doIntervalDeletions();
+   ++epochRef_.depth;
 #if PERFORMING_LATM
-   while (blocked()) { SLEEP(10) ; }
+   wait_while_blocked();
 #endif
 
    put_tx_inflight();
 
-#if CAPTURING_PROFILE_DATA
-   ostrRef_ << "TxBegin:            " << txTime() << endl;
-#endif
+   if (tracing_) traceRef_.push(eTraceBegin, eTraceNoReason, 0, 0);
+}
+
+//--------------------------------------------------------------------------
+// the constructor used by the atomic macros, see BOOST_STM_TX_SITE
+//--------------------------------------------------------------------------
+inline boost::stm::transaction::transaction(tx_site &site) : transaction()
+{
+   origin_ = &site;
+
+   if (siteProfiling_)
+   {
+      site_ = &site;
+      siteStart_ = trace_now();
+   }
+}
+
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+inline boost::stm::tx_site::tx_site(char const *file, size_t line) :
+   location_(file, line), commits_(0), aborts_(0), retries_(0), reads_(0),
+   writes_(0), timeNs_(0)
+{
+   transaction::register_site(this);
 }
 
 //--------------------------------------------------------------------------
@@ -548,9 +670,11 @@ inline void boost::stm::transaction::begin()
    if (e_in_flight == state_) return;
 
 #if PERFORMING_LATM
-   while (blocked()) { SLEEP(10) ; }
+   wait_while_blocked();
 #endif
    put_tx_inflight();
+
+   if (tracing_) traceRef_.push(eTraceBegin, eTraceNoReason, 0, 0);
 }
 
 #ifdef LOGGING_BLOCKS
@@ -604,25 +728,16 @@ inline std::string boost::stm::transaction::outputBlockedThreadsAndLockedLocks()
 inline bool boost::stm::transaction::restart()
 {
    if (e_in_flight == state_) lock_and_abort();
-
 #if PERFORMING_LATM
-#ifdef LOGGING_BLOCKS
-   int iterations = 0;
-#endif
-   while (blocked())
-   {
-#ifdef LOGGING_BLOCKS
-      if (++iterations > 100)
-      {
-         var_auto_lock<PLOCK> autolock(latm_lock(), general_lock(), 0);
-         //unblock_threads_if_locks_are_empty();
-         logFile_ << outputBlockedThreadsAndLockedLocks().c_str();
-         SLEEP(10000);
-      }
+   release_latm_rw_holds();
 #endif
+   if (0 != site_) ++siteRetries_;
+   if (serialFallback_) sample_serial_fallback();
 
-      SLEEP(10);
-   }
+   cm_->on_restart(*this);
+
+#if PERFORMING_LATM
+   wait_while_blocked();
 #endif
    //-----------------------------------------------------------------------
    // this is a vital check for composed transactions that abort, but the
@@ -644,9 +759,18 @@ inline bool boost::stm::transaction::restart()
 
    put_tx_inflight();
 
-#if CAPTURING_PROFILE_DATA
-   ostrRef_ << "TxBegin:            " << txTime() << endl;
-#endif
+   //-----------------------------------------------------------------------
+   // irrevocability is only granted to transactions in flight, so two
+   // promoted transactions can never both hold it. every abort makes the
+   // tx revocable again. one forced to abort while waiting stays revocable,
+   // aborts as usual and tries again on its next restart
+   //-----------------------------------------------------------------------
+   if (0 != retryBudget_ && consecutiveAborts_ >= retryBudget_ && !irrevocable())
+   {
+      if (wait_to_become_irrevocable()) bookkeeping_.inc_irrevocable_promotions();
+   }
+
+   if (tracing_) traceRef_.push(eTraceBegin, eTraceNoReason, 0, 0);
 
 #if 0
    if (doing_dynamic_priority_assignment())
@@ -665,70 +789,243 @@ inline bool boost::stm::transaction::restart()
 inline bool boost::stm::transaction::can_go_inflight()
 {
    // if we're doing full lock protection, allow transactions
-   // to start only if no locks are obtained or the only lock that
-   // is obtained is on THREAD_ID
+   // to start only if no locks are obtained or the only locks that
+   // are obtained are on THREAD_ID
    if (transaction::doing_full_lock_protection())
    {
-      for (MutexThreadMap::iterator j = latmLockedLocksOfThreadMap_.begin();
-      j != latmLockedLocksOfThreadMap_.end(); ++j)
-      {
-         if (THREAD_ID != j->second)
-         {
-            return false;
-         }
-      }
+      size_t const held = latmHeldLocks_;
+      return 0 == held || held == latmHeldRef_.locks;
    }
 
    // if we're doing tm lock protection, allow transactions
-   // to start only if
+   // to start only if none of the tm conflicting locks is locked
+   // by another thread
    else if (transaction::doing_tm_lock_protection())
    {
-      for (MutexSet::iterator i = tmConflictingLocks_.begin(); i != tmConflictingLocks_.end(); ++i)
+      size_t const held = latmHeldTmConflictingLocks_;
+      return 0 == held || held == latmHeldRef_.tmConflictingLocks;
+   }
+
+   return true;
+}
+
+//--------------------------------------------------------------------------
+// waits for the begin gate to open, a lock owner clearing its ownership
+// wakes the parked transactions. the park is bounded so a gate opened by
+// other means is still seen
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::park_at_latm_gate()
+{
+   var_auto_lock<PLOCK> a(&latmGateMutex_, 0);
+
+   ++latmGateWaiters_;
+   if (!can_go_inflight()) timed_wait_at_latm_gate();
+   --latmGateWaiters_;
+}
+
+//--------------------------------------------------------------------------
+//
+// PRE-CONDITION: latmGateMutex_ is obtained and the waiter is counted in
+//                latmGateWaiters_ prior to calling this method.
+//
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::timed_wait_at_latm_gate()
+{
+   timespec const ts = deadline_after(std::chrono::nanoseconds(kLatmGateParkNs));
+   pthread_cond_timedwait(&latmGateCond_, &latmGateMutex_, &ts);
+}
+
+//--------------------------------------------------------------------------
+// waits on the thread's wait record until the thread is unblocked. the
+// unblocking thread clears the flag before it signals under the record's
+// mutex, so the flag is either seen clear here or the wait is woken. the
+// wait is bounded so a flag cleared by other means is still seen
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::wait_while_blocked()
+{
+   if (!blocked()) return;
+
+#ifdef LOGGING_BLOCKS
+   int iterations = 0;
+#endif
+   uint64 const start = trace_now();
+
+   lock(&latmWaitRef_.mutex);
+   while (blocked())
+   {
+#ifdef LOGGING_BLOCKS
+      if (++iterations > 100)
       {
-         // if one of your conflicting locks is currently locked ...
-         if (latmLockedLocks_.end() != latmLockedLocks_.find(*i))
+         unlock(&latmWaitRef_.mutex);
          {
-            // if it is locked by our thread, it is ok ... otherwise it is not
-            MutexThreadMap::iterator j = latmLockedLocksOfThreadMap_.find(*i);
-
-            if (j != latmLockedLocksOfThreadMap_.end() &&
-               THREAD_ID != j->second)
-            {
-               return false;
-            }
+            var_auto_lock<PLOCK> autolock(latm_lock(), general_lock(), 0);
+            logFile_ << outputBlockedThreadsAndLockedLocks().c_str();
          }
+         SLEEP(10000);
+         lock(&latmWaitRef_.mutex);
       }
+#endif
+
+      timespec const ts = deadline_after(std::chrono::nanoseconds(kLatmBlockParkNs));
+      pthread_cond_timedwait(&latmWaitRef_.cond, &latmWaitRef_.mutex, &ts);
    }
+   unlock(&latmWaitRef_.mutex);
 
-   return true;
+   bookkeeping_.record_latm_wait(trace_now() - start);
 }
 
 //--------------------------------------------------------------------------
 //--------------------------------------------------------------------------
 inline void boost::stm::transaction::put_tx_inflight()
 {
+   //--------------------------------------------------------------------------
+   // only the outermost transaction of a thread announces its epoch; nested
+   // transactions are covered by the announcement of their parent
+   //--------------------------------------------------------------------------
+   if (1 == epochRef_.depth) announce_epoch();
+
+   // a new attempt, committers may blame it as soon as it is in flight
+   conflict_.reset();
+
 #if PERFORMING_LATM
+   uint64 waitStart = 0;
    while (true)
    {
+      enter_serial();
+      enter_schedule();
       lock_inflight_access();
 
-      if (can_go_inflight() && !isolatedTxInFlight())
+      bool const gateOpen = can_go_inflight();
+
+      //--------------------------------------------------------------------
+      // a serialized transaction waits for the others to drain, the others
+      // wait while it is in flight
+      //--------------------------------------------------------------------
+      if (gateOpen && !isolatedTxInFlight() &&
+         (serialized_ ? !otherThreadTxInFlight() : !otherThreadSerialTxInFlight()))
       {
-         transactionsInFlight_.insert(this);
+         add_to_inflight(this);
+         if (serialized_) serialThread_.store(threadId_);
          state_ = e_in_flight;
          unlock_inflight_access();
          break;
       }
 
       unlock_inflight_access();
-      SLEEP(10);
+
+      // the owner of the lock we wait for may itself be queued for a token
+      release_schedule();
+      release_serial();
+      if (0 == waitStart) waitStart = trace_now();
+
+      if (gateOpen) SLEEP(10);
+      else park_at_latm_gate();
    }
+
+   if (0 != waitStart) bookkeeping_.record_latm_wait(trace_now() - waitStart);
 #else
-   lock_inflight_access();
-   transactionsInFlight_.insert(this);
-   unlock_inflight_access();
+   while (true)
+   {
+      enter_serial();
+      enter_schedule();
+      lock_inflight_access();
+
+      //--------------------------------------------------------------------
+      // a serialized transaction waits for the others to drain, the others
+      // wait while it is in flight
+      //--------------------------------------------------------------------
+      if (serialized_ ? !otherThreadTxInFlight() : !otherThreadSerialTxInFlight())
+      {
+         add_to_inflight(this);
+         if (serialized_) serialThread_.store(threadId_);
+         unlock_inflight_access();
+         break;
+      }
+
+      unlock_inflight_access();
+
+      // neither token is held while waiting
+      release_schedule();
+      release_serial();
+      SLEEP(1);
+   }
    state_ = e_in_flight;
 #endif
+
+   if (scheduled_) bookkeeping_.inc_scheduled();
+   if (serialized_) bookkeeping_.inc_serialized();
+
+   //--------------------------------------------------------------------------
+   // the age of the transaction is the number of commits seen when it first
+   // began, kept across its retries
+   //--------------------------------------------------------------------------
+   if (0 == consecutiveAborts_) beginStamp_ = global_clock();
+   readsAtBegin_ = reads_;
+
+#if MEASURING_LATENCIES
+   beginTime_ = trace_now();
+   if (0 == firstBeginTime_) firstBeginTime_ = beginTime_;
+#endif
+}
+
+//--------------------------------------------------------------------------
+// only outermost transactions are scheduled, a nested one runs inside the
+// attempt of its parent
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::enter_schedule()
+{
+   if (!scheduling_ || scheduled_ || serialized_ || 1 != epochRef_.depth) return;
+   if (scheduleRef_.intensity <= scheduleThreshold_) return;
+
+   lock(&scheduleMutex_);
+   scheduled_ = true;
+}
+
+inline void boost::stm::transaction::release_schedule()
+{
+   if (!scheduled_) return;
+
+   scheduled_ = false;
+   unlock(&scheduleMutex_);
+}
+
+//--------------------------------------------------------------------------
+// a thread queued for the serial lock when the STM recovers just passes on
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::enter_serial()
+{
+   if (!serialMode_.load(std::memory_order_relaxed)) return;
+   if (serialized_ || 1 != epochRef_.depth) return;
+
+   lock(&serialMutex_);
+
+   if (serialMode_.load(std::memory_order_relaxed)) serialized_ = true;
+   else unlock(&serialMutex_);
+}
+
+inline void boost::stm::transaction::release_serial()
+{
+   if (!serialized_) return;
+
+   serialized_ = false;
+   serialThread_.store(kInvalidThread);
+   unlock(&serialMutex_);
+}
+
+//--------------------------------------------------------------------------
+// called by the thread itself at the end of every attempt, the intensity
+// is never touched by other threads
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::leave_schedule(bool const aborted)
+{
+   if (1 == epochRef_.depth)
+   {
+      scheduleRef_.intensity *= kScheduleIntensityDecay;
+      if (aborted) scheduleRef_.intensity += 1 - kScheduleIntensityDecay;
+   }
+
+   release_schedule();
+   release_serial();
 }
 
 //--------------------------------------------------------------------------
@@ -739,12 +1036,26 @@ inline boost::stm::transaction::~transaction()
    if (state_ != e_in_flight)
    {
       if (hasLock()) unlock_tx();
-      return;
+   }
+   else
+   {
+      if (!hasLock()) lock_tx();
+      abort();
+      unlock_tx();
    }
 
-   if (!hasLock()) lock_tx();
-   abort();
-   unlock_tx();
+#if PERFORMING_LATM
+   try { release_latm_rw_holds(); }
+   catch (...) {}
+#endif
+
+   if (0 != site_)
+   {
+      site_->record(committed(), siteAborts_, siteRetries_, reads_, siteWrites_,
+         trace_now() - siteStart_);
+   }
+
+   if (0 == --epochRef_.depth) epochRef_.announced.store(kQuiescentEpoch);
 }
 
 //--------------------------------------------------------------------------
@@ -762,6 +1073,56 @@ inline void boost::stm::transaction::end()
    // in case this is called multiple times
    if (!in_flight()) return;
 
+   size_t const work = attempt_reads() + writeList().size();
+
+#if PERFORMING_LATM
+   try
+   {
+      if (tracing_ || 0 != site_) profiled_end_transaction();
+      else end_transaction();
+   }
+   catch (aborted_transaction_exception&)
+   {
+      release_latm_rw_holds();
+      throw;
+   }
+#else
+   if (tracing_ || 0 != site_) profiled_end_transaction();
+   else end_transaction();
+#endif
+
+   if (e_committed == state_)
+   {
+#if MEASURING_LATENCIES
+      uint64 const now = trace_now();
+      bookkeeping_.record_latency(kBeginToCommitLatency, now - beginTime_);
+      bookkeeping_.record_latency(kRetryLatency, now - firstBeginTime_);
+      firstBeginTime_ = 0;
+#endif
+      consecutiveAborts_ = 0;
+      bookkeeping_.inc_all_commits();
+      bookkeeping_.inc_committed_work_by(work);
+      cm_->on_commit(*this);
+      leave_schedule(false);
+      if (serialFallback_) sample_serial_fallback();
+   }
+
+   //--------------------------------------------------------------------------
+   // a committed outermost transaction no longer references shared memory,
+   // so the thread is quiescent until it begins again. this is also the
+   // point where the thread frees its limbo list once enough has built up
+   //--------------------------------------------------------------------------
+   if (e_committed == state_ && 1 == epochRef_.depth)
+   {
+      epochRef_.announced.store(kQuiescentEpoch);
+      if (epochRef_.limbo.size() >= kEpochReclaimBatch) reclaim_epoch_limbo();
+   }
+}
+
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::end_transaction()
+{
    if (direct_updating())
    {
 #if PERFORMING_VALIDATION
@@ -780,6 +1141,30 @@ inline void boost::stm::transaction::end()
    }
 }
 
+//--------------------------------------------------------------------------
+// the write list is consumed by the commit, so its size is taken first
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::profiled_end_transaction()
+{
+   size_t const writes = writeList().size();
+
+   end_transaction();
+
+   if (e_committed == state_)
+   {
+      siteWrites_ += writes;
+      if (tracing_) traceRef_.push(eTraceCommit, eTraceNoReason, reads_, writes);
+   }
+}
+
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::trace_abort()
+{
+   trace_abort_reason reason = forced_to_abort() ? eTraceAbortForced : abortReason_;
+   traceRef_.push(eTraceAbort, reason, reads_, writeList().size());
+}
+
 //-----------------------------------------------------------------------------
 // lock_and_abort()
 //
@@ -825,6 +1210,7 @@ inline void boost::stm::transaction::invalidating_direct_end_transaction()
    }
 
    lock_general_access();
+   bookkeeping_.start_latency(kCommitLockHoldLatency);
    lock_tx();
 
    //--------------------------------------------------------------------------
@@ -855,7 +1241,7 @@ inline void boost::stm::transaction::invalidating_direct_end_transaction()
    lock_all_mutexes_but_this(threadId_);
 
    lock_inflight_access();
-   transactionsInFlight_.erase(this);
+   remove_from_inflight(this);
 
    if (other_in_flight_same_thread_transactions())
    {
@@ -905,7 +1291,7 @@ inline void boost::stm::transaction::invalidating_deferred_end_transaction()
    if (is_only_reading())
    {
       lock_inflight_access();
-      transactionsInFlight_.erase(this);
+      remove_from_inflight(this);
 
 #if PERFORMING_COMPOSITION
       if (other_in_flight_same_thread_transactions())
@@ -920,7 +1306,7 @@ inline void boost::stm::transaction::invalidating_deferred_end_transaction()
          unlock_inflight_access();
          tx_type(eNormalTx);
 #if PERFORMING_LATM
-         get_tx_conflicting_locks().clear();
+         forget_tx_conflicting_locks();
          clear_latm_obtained_locks();
 #endif
          state_ = e_committed;
@@ -928,16 +1314,16 @@ inline void boost::stm::transaction::invalidating_deferred_end_transaction()
 
       ++(*commits_ref_);
 
-#if CAPTURING_PROFILE_DATA
-      ostrRef_ << "TxCommit:           " << txTime() << " R" << endl;
-#endif
-
       ++global_clock();
 
       return;
    }
 
    while (0 != trylock(&transactionMutex_)) { }
+#if PERFORMING_LATM
+   if (!latmSharedLocks_.empty()) wait_for_shared_latm_locks();
+#endif
+   bookkeeping_.start_latency(kCommitLockHoldLatency);
 
    //--------------------------------------------------------------------------
    // as much as I'd like to transactionsInFlight_.erase() here, we have
@@ -974,7 +1360,7 @@ inline void boost::stm::transaction::invalidating_deferred_end_transaction()
 #if PERFORMING_COMPOSITION
       if (other_in_flight_same_thread_transactions())
       {
-         transactionsInFlight_.erase(this);
+         remove_from_inflight(this);
          state_ = e_hand_off;
          unlock_all_mutexes();
          unlock_general_access();
@@ -999,6 +1385,7 @@ inline void boost::stm::transaction::invalidating_deferred_end_transaction()
 inline void boost::stm::transaction::validating_direct_end_transaction()
 {
    lock_general_access();
+   bookkeeping_.start_latency(kCommitLockHoldLatency);
    lock_tx();
 
    //--------------------------------------------------------------------------
@@ -1006,8 +1393,9 @@ inline void boost::stm::transaction::validating_direct_end_transaction()
    //--------------------------------------------------------------------------
    if (cm_->abort_before_commit(*this))
    {
+      abortReason_ = eTraceAbortCmDenied;
       abort();
-      //bookkeeping_.inc_abort_perm_denied(threadId_);
+      //bookkeeping_.inc_abort_perm_denied();
       unlock_tx();
       unlock_general_access();
       throw aborted_transaction_exception
@@ -1042,7 +1430,7 @@ inline void boost::stm::transaction::validating_direct_end_transaction()
    lock_all_mutexes_but_this(threadId_);
 
    lock_inflight_access();
-   transactionsInFlight_.erase(this);
+   remove_from_inflight(this);
 
    if (other_in_flight_same_thread_transactions())
    {
@@ -1072,6 +1460,10 @@ inline void boost::stm::transaction::validating_direct_end_transaction()
 inline void boost::stm::transaction::validating_deferred_end_transaction()
 {
    lock_general_access();
+#if PERFORMING_LATM
+   if (!latmSharedLocks_.empty()) wait_for_shared_latm_locks();
+#endif
+   bookkeeping_.start_latency(kCommitLockHoldLatency);
    lock_inflight_access();
    lock_tx();
 
@@ -1080,7 +1472,8 @@ inline void boost::stm::transaction::validating_deferred_end_transaction()
    //--------------------------------------------------------------------------
    if (cm_->abort_before_commit(*this))
    {
-      //bookkeeping_.inc_abort_perm_denied(threadId_);
+      abortReason_ = eTraceAbortCmDenied;
+      //bookkeeping_.inc_abort_perm_denied();
       unlock_inflight_access();
       unlock_general_access();
       deferred_abort();
@@ -1120,7 +1513,7 @@ inline void boost::stm::transaction::validating_deferred_end_transaction()
       if (is_only_reading())
       {
          lock_inflight_access();
-         transactionsInFlight_.erase(this);
+         remove_from_inflight(this);
 
          if (other_in_flight_same_thread_transactions())
          {
@@ -1131,7 +1524,7 @@ inline void boost::stm::transaction::validating_deferred_end_transaction()
          {
             tx_type(eNormalTx);
 #if PERFORMING_LATM
-            get_tx_conflicting_locks().clear();
+            forget_tx_conflicting_locks();
             clear_latm_obtained_locks();
 #endif
             state_ = e_committed;
@@ -1139,10 +1532,6 @@ inline void boost::stm::transaction::validating_deferred_end_transaction()
 
          ++(*commits_ref_);
 
-#if CAPTURING_PROFILE_DATA
-      ostrRef_ << "TxCommit:           " << txTime() << " R" << endl;
-#endif
-
          unlock_general_access();
          unlock_inflight_access();
 
@@ -1170,7 +1559,7 @@ inline void boost::stm::transaction::validating_deferred_end_transaction()
       lock_all_mutexes_but_this(threadId_);
 
       lock_inflight_access();
-      transactionsInFlight_.erase(this);
+      remove_from_inflight(this);
 
       if (other_in_flight_same_thread_transactions())
       {
@@ -1237,26 +1626,29 @@ inline void boost::stm::transaction::forceOtherInFlightTransactionsWritingThisWr
 #endif
          {
 #if ALWAYS_ALLOW_ABORT
+            t->conflicted_with(*this, i->first);
             t->force_to_abort();
 
             next = j;
             ++next;
-            transactionsInFlight_.erase(j);
+            remove_from_inflight(t);
             j = next;
 
 #else
             if (this->irrevocable())
             {
+               t->conflicted_with(*this, i->first);
                aborted.push_front(t);
             }
             else if (!t->irrevocable() && cm_->permission_to_abort(*this, *t))
             {
+               t->conflicted_with(*this, i->first);
                aborted.push_front(t);
             }
             else
             {
                force_to_abort();
-               //bookkeeping_.inc_abort_perm_denied(threadId_);
+               //bookkeeping_.inc_abort_perm_denied();
                throw aborted_transaction_exception
                ("aborting committing transaction due to contention manager priority inversion");
             }
@@ -1272,7 +1664,7 @@ inline void boost::stm::transaction::forceOtherInFlightTransactionsWritingThisWr
    for (std::list<transaction*>::iterator k = aborted.begin(); k != aborted.end();)
    {
       (*k)->force_to_abort();
-      transactionsInFlight_.erase(*k);
+      remove_from_inflight(*k);
    }
 #endif
 }
@@ -1296,6 +1688,21 @@ inline void boost::stm::transaction::direct_abort
    bookkeeping_.pushBackSizeOfWriteSetWhenAborting(writeList().size());
 #endif
 
+   bookkeeping_.inc_aborts();
+   if (tracing_) trace_abort();
+   abortReason_ = eTraceAbortSelf;
+   if (conflictProfiling_ && conflict_.forced() && forced_to_abort()) record_conflict();
+   bookkeeping_.inc_aborted_work_by(attempt_reads() + writeList().size());
+   ++consecutiveAborts_;
+   cm_->on_abort(*this);
+   leave_schedule(true);
+
+   if (0 != site_)
+   {
+      ++siteAborts_;
+      siteWrites_ += writeList().size();
+   }
+
    try
    {
       state_ = e_aborted;
@@ -1315,16 +1722,18 @@ inline void boost::stm::transaction::direct_abort
       {
          lock_inflight_access();
          // if I'm the last transaction of this thread, reset abort to false
-         transactionsInFlight_.erase(this);
+         remove_from_inflight(this);
       }
 
 #ifdef USING_SHARED_FORCED_TO_ABORT
       if (!other_in_flight_same_thread_transactions())
       {
          unforce_to_abort();
+         tx_type(eNormalTx);
       }
 #else
       unforce_to_abort();
+      tx_type(eNormalTx);
 #endif
       if (!alreadyRemovedFromInFlight)
       {
@@ -1348,19 +1757,22 @@ inline void boost::stm::transaction::deferred_abort
    bookkeeping_.pushBackSizeOfWriteSetWhenAborting(writeList().size());
 #endif
 
-   state_ = e_aborted;
+   bookkeeping_.inc_aborts();
+   if (tracing_) trace_abort();
+   abortReason_ = eTraceAbortSelf;
+   if (conflictProfiling_ && conflict_.forced() && forced_to_abort()) record_conflict();
+   bookkeeping_.inc_aborted_work_by(attempt_reads() + writeList().size());
+   ++consecutiveAborts_;
+   cm_->on_abort(*this);
+   leave_schedule(true);
 
-#if CAPTURING_PROFILE_DATA
-   ostrRef_ << "TxAbort:            " << txTime()  << " ";
-   if (this->is_only_reading()) ostrRef_ << "R";
-   else if (this->is_only_writing()) ostrRef_ << "W";
-   else if (this->is_reading_and_writing()) ostrRef_ << "RW";
-   else
+   if (0 != site_)
    {
-      ostrRef_ << "U";
+      ++siteAborts_;
+      siteWrites_ += writeList().size();
    }
-   ostrRef_ << " " << endl;
-#endif
+
+   state_ = e_aborted;
 
    deferredAbortWriteList();
 #ifndef DISABLE_READ_SETS
@@ -1379,15 +1791,17 @@ inline void boost::stm::transaction::deferred_abort
    {
       lock_inflight_access();
       // if I'm the last transaction of this thread, reset abort to false
-      transactionsInFlight_.erase(this);
+      remove_from_inflight(this);
 
 #ifdef USING_SHARED_FORCED_TO_ABORT
       if (!other_in_flight_same_thread_transactions())
       {
          unforce_to_abort();
+         tx_type(eNormalTx);
       }
 #else
       unforce_to_abort();
+      tx_type(eNormalTx);
 #endif
 
       unlock_inflight_access();
@@ -1428,7 +1842,7 @@ inline void boost::stm::transaction::invalidating_direct_commit()
 
       tx_type(eNormalTx);
 #if PERFORMING_LATM
-      get_tx_conflicting_locks().clear();
+      forget_tx_conflicting_locks();
       clear_latm_obtained_locks();
 #endif
       state_ = e_committed;
@@ -1569,25 +1983,17 @@ inline void boost::stm::transaction::invalidating_deferred_commit()
 #endif
       }
 
-      transactionsInFlight_.erase(this);
+      remove_from_inflight(this);
 
       ++(*commits_ref_);
 
       unlock_inflight_access();
-      unlock_general_access();
-
-#if CAPTURING_PROFILE_DATA
-      ostrRef_ << "TxCommit:           " << txTime() << " ";
-      if (this->is_only_reading()) ostrRef_ << "R";
-      else if (this->is_only_writing()) ostrRef_ << "W";
-      else if (this->is_reading_and_writing()) ostrRef_ << "RW";
-      else
-      {
-         ostrRef_ << "U";
-      }
-      ostrRef_ << " " << endl;
-#endif
 
+      //-----------------------------------------------------------------------
+      // the write back is done under the general lock: this tx has left the
+      // in-flight set, so a LATM locker taking the general lock next would
+      // otherwise find nothing to abort and race the write back
+      //-----------------------------------------------------------------------
       deferredCommitWriteState();
 
       if (!newMemoryList().empty())
@@ -1596,6 +2002,8 @@ inline void boost::stm::transaction::invalidating_deferred_commit()
          deferredCommitTransactionNewMemory();
       }
 
+      unlock_general_access();
+
       //-----------------------------------------------------------------------
       // if the commit actually worked, then we can release these locks
       //-----------------------------------------------------------------------
@@ -1618,7 +2026,7 @@ inline void boost::stm::transaction::invalidating_deferred_commit()
 
       tx_type(eNormalTx);
 #if PERFORMING_LATM
-      get_tx_conflicting_locks().clear();
+      forget_tx_conflicting_locks();
       clear_latm_obtained_locks();
 #endif
       state_ = e_committed;
@@ -1696,7 +2104,7 @@ inline void boost::stm::transaction::validating_direct_commit()
 
       tx_type_ref() = eNormalTx;
 #if PERFORMING_LATM
-      get_tx_conflicting_locks().clear();
+      forget_tx_conflicting_locks();
       clear_latm_obtained_locks();
 #endif
       state_ = e_committed;
@@ -1803,7 +2211,7 @@ inline void boost::stm::transaction::validating_deferred_commit()
       bookkeeping_.inc_commits();
       tx_type_ref() = eNormalTx;
 #if PERFORMING_LATM
-      get_tx_conflicting_locks().clear();
+      forget_tx_conflicting_locks();
       clear_latm_obtained_locks();
 #endif
       state_ = e_committed;
@@ -1901,104 +2309,97 @@ inline void boost::stm::transaction::deferredAbortWriteList() throw()
 }
 
 //----------------------------------------------------------------------------
-inline size_t boost::stm::transaction::earliest_start_time_of_inflight_txes()
+// announce the current global epoch for this thread. the epoch is re-read
+// after the announcement so that a reclaimer which advanced the epoch and
+// scanned the announcements in between cannot have missed us
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::announce_epoch()
 {
-   var_auto_lock<PLOCK> a(inflight_lock(), 0);
+   size_t epoch = globalEpoch_.load();
 
-   size_t secs = 0xffffffff;
-
-   for (InflightTxes::iterator j = transactionsInFlight_.begin();
-   j != transactionsInFlight_.end(); ++j)
+   for (;;)
    {
-      transaction *t = (transaction*)*j;
-      //-----------------------------------------------------------------------
-      // since this is called while direct_writes are occurring, the transaction
-      // calling it will be inflight, so we have to check for it and skip it
-      //-----------------------------------------------------------------------
-      if (t->startTime_ < secs) secs = t->startTime_;
-   }
+      epochRef_.announced.store(epoch);
 
-   return secs;
+      size_t const current = globalEpoch_.load();
+      if (current == epoch) break;
+      epoch = current;
+   }
 }
 
 //----------------------------------------------------------------------------
-inline void boost::stm::transaction::doIntervalDeletions()
+// the oldest epoch any thread may still be reading memory from. threads
+// which are quiescent announce kQuiescentEpoch and never hold it back
+//----------------------------------------------------------------------------
+inline size_t boost::stm::transaction::oldest_announced_epoch()
 {
-   using namespace boost::stm;
+   size_t oldest = globalEpoch_.load();
 
-   size_t earliestInFlightTx = earliest_start_time_of_inflight_txes();
-
-   var_auto_lock<PLOCK> a(&deletionBufferMutex_, 0);
-
-   for (DeletionBuffer::iterator i = deletionBuffer_.begin(); i != deletionBuffer_.end();)
+   for (ThreadEpochRecords::iterator i = threadEpochRecords_.begin();
+   i != threadEpochRecords_.end(); ++i)
    {
-      if (earliestInFlightTx > i->first)
-      {
-         for (MemoryContainerList::iterator j = i->second.begin(); j != i->second.end(); ++j)
-         {
-            delete *j;
-         }
-         deletionBuffer_.erase(i);
-         i = deletionBuffer_.begin();
-      }
-      // getting to the else means there is an inflight
-      // tx that is older than the first entry to delete,
-      // so exit, since no other deletions will succeed
-      else break;
+      size_t const announced = i->second->announced.load();
+      if (announced < oldest) oldest = announced;
    }
 
+   return oldest;
+}
+
 //----------------------------------------------------------------------------
-// TODO: Vicente, do you know what the below code is used for?
+// limbo lists are appended in epoch order, so everything retired before
+// safeEpoch is a prefix of the list
 //----------------------------------------------------------------------------
-#if 0
+inline void boost::stm::transaction::free_epoch_limbo(EpochLimbo &limbo, size_t safeEpoch)
+{
+   EpochLimbo::iterator i = limbo.begin();
 
-   for (UnsafeDeletionBuffer::iterator i = unsafeDeletionBuffer_.begin();
-        i != unsafeDeletionBuffer_.end();)
+   for (; i != limbo.end() && i->first < safeEpoch; ++i)
    {
-      if (earliestInFlightTx > i->first)
-      {
-         for (UnsafeMemoryContainerList::iterator j = i->second.begin(); j != i->second.end(); ++j)
-         {
-            free(j);
-         }
-         unsafeDeletionBuffer_.erase(i);
-         i = unsafeDeletionBuffer_.begin();
-      }
-      // getting to the else means there is an inflight
-      // tx that is older than the first entry to delete,
-      // so exit, since no other deletions will succeed
-      else break;
+      delete i->second;
    }
-#endif
 
+   limbo.erase(limbo.begin(), i);
 }
 
 //----------------------------------------------------------------------------
-inline void boost::stm::transaction::directCommitTransactionDeletedMemory() throw()
+inline void boost::stm::transaction::reclaim_epoch_limbo()
 {
-   using namespace boost::stm;
+   var_auto_lock<PLOCK> a(&epochMutex_, 0);
 
-   if (!deletedMemoryList().empty())
-   {
-      var_auto_lock<PLOCK> a(&deletionBufferMutex_, 0);
-      deletionBuffer_.insert( std::pair<size_t, MemoryContainerList>
-         ((size_t)time(0), deletedMemoryList()) );
-      deletedMemoryList().clear();
-   }
+   size_t safeEpoch = oldest_announced_epoch();
+
+   free_epoch_limbo(epochRef_.limbo, safeEpoch);
+   if (!orphanedLimbo_.empty()) free_epoch_limbo(orphanedLimbo_, safeEpoch);
 }
 
 //----------------------------------------------------------------------------
-inline void boost::stm::transaction::deferredCommitTransactionDeletedMemory() throw()
+// move the committed deletions into this thread's limbo list. the global
+// epoch is advanced past the stamp so transactions that start after this
+// point never hold back the reclamation of this memory
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::retire_deleted_memory() throw()
 {
-   using namespace boost::stm;
+   size_t const epoch = globalEpoch_.fetch_add(1);
 
-   if (!deletedMemoryList().empty())
+   for (MemoryContainerList::iterator i = deletedMemoryList().begin();
+   i != deletedMemoryList().end(); ++i)
    {
-      var_auto_lock<PLOCK> a(&deletionBufferMutex_, NULL);
-      deletionBuffer_.insert( std::pair<size_t, MemoryContainerList>
-         ((size_t)time(NULL), deletedMemoryList()) );
-      deletedMemoryList().clear();
+      epochRef_.limbo.push_back(EpochLimboEntry(epoch, *i));
    }
+
+   deletedMemoryList().clear();
+}
+
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::directCommitTransactionDeletedMemory() throw()
+{
+   if (!deletedMemoryList().empty()) retire_deleted_memory();
+}
+
+//----------------------------------------------------------------------------
+inline void boost::stm::transaction::deferredCommitTransactionDeletedMemory() throw()
+{
+   if (!deletedMemoryList().empty()) retire_deleted_memory();
 }
 
 ////////////////////////////////////////////////////////////////////////////
@@ -2095,6 +2496,7 @@ inline void boost::stm::transaction::verifyReadMemoryIsValidWithGlobalMemory()
       if (i->first->version_ != i->second)
       {
          bookkeeping_.inc_read_aborts();
+         abortReason_ = eTraceAbortInvalidRead;
          throw aborted_transaction_exception
          ("aborting committing transaction due to invalid read");
       }
@@ -2111,6 +2513,7 @@ inline void boost::stm::transaction::verifyWrittenMemoryIsValidWithGlobalMemory(
       if (i->first->version_ != i->second->version_)
       {
          bookkeeping_.inc_write_aborts();
+         abortReason_ = eTraceAbortInvalidWrite;
          throw aborted_transaction_exception
          ("aborting committing transaction due to invalid write");
       }
@@ -2220,10 +2623,12 @@ inline bool boost::stm::transaction::forceOtherInFlightTransactionsAccessingThis
 #if PERFORMING_LATM
                if (this->irrevocable())
                {
+                  t->conflicted_with(*this, i->first);
                   aborted.push_front(t);
                }
                else if (!t->irrevocable() && cm_->permission_to_abort(*this, *t))
                {
+                  t->conflicted_with(*this, i->first);
                   aborted.push_front(t);
                }
                else
@@ -2233,6 +2638,7 @@ inline bool boost::stm::transaction::forceOtherInFlightTransactionsAccessingThis
                   ("aborting committing transaction due to contention manager priority inversion");
                }
 #else
+               t->conflicted_with(*this, i->first);
                aborted.push_front(t);
 #endif
             }
@@ -2250,10 +2656,12 @@ inline bool boost::stm::transaction::forceOtherInFlightTransactionsAccessingThis
 #if PERFORMING_LATM
          if (this->irrevocable())
          {
+            t->conflicted_with(*this, 0);
             aborted.push_front(t);
          }
          else if (!t->irrevocable() && cm_->permission_to_abort(*this, *t))
          {
+            t->conflicted_with(*this, 0);
             aborted.push_front(t);
          }
          else
@@ -2263,6 +2671,7 @@ inline bool boost::stm::transaction::forceOtherInFlightTransactionsAccessingThis
             ("aborting committing transaction due to contention manager priority inversion");
          }
 #else
+         t->conflicted_with(*this, 0);
          aborted.push_front(t);
 #endif
       }
@@ -2331,16 +2740,18 @@ inline void boost::stm::transaction::forceOtherInFlightTransactionsReadingThisWr
          {
             if (this->irrevocable())
             {
+               t->conflicted_with(*this, i->first);
                aborted.push_front(t);
             }
             else if (!t->irrevocable() && cm_->permission_to_abort(*this, *t))
             {
+               t->conflicted_with(*this, i->first);
                aborted.push_front(t);
             }
             else
             {
                force_to_abort();
-               //bookkeeping_.inc_abort_perm_denied(threadId_);
+               //bookkeeping_.inc_abort_perm_denied();
                throw aborted_transaction_exception
                ("aborting committing transaction due to contention manager priority inversion");
             }
@@ -2368,13 +2779,10 @@ inline void boost::stm::transaction::forceOtherInFlightTransactionsReadingThisWr
 //-----------------------------------------------------------------------------
 inline bool boost::stm::transaction::other_in_flight_same_thread_transactions() const throw()
 {
-   for (InflightTxes::iterator i = transactionsInFlight_.begin();
-      i != transactionsInFlight_.end(); ++i)
+   for (InflightOfThread::const_iterator i = inflightOfThreadRef_.begin();
+      i != inflightOfThreadRef_.end(); ++i)
    {
-      if (((transaction*)*i) == this) continue;
-      // if this is not our threadId or this thread is not composable, skip it
-      if (((transaction*)*i)->threadId_ != this->threadId_) continue;
-      return true;
+      if (*i != this) return true;
    }
 
    return false;
@@ -2384,17 +2792,37 @@ inline bool boost::stm::transaction::
 otherInFlightTransactionsOfSameThreadNotIncludingThis(transaction const * const rhs)
 {
    //////////////////////////////////////////////////////////////////////
-   for (InflightTxes::iterator i = transactionsInFlight_.begin(); i != transactionsInFlight_.end(); ++i)
+   for (InflightOfThread::iterator i = inflightOfThreadRef_.begin(); i != inflightOfThreadRef_.end(); ++i)
    {
-      if (*i == rhs) continue;
-      // if this is not our threadId or this thread is not composable, skip it
-      if (((transaction*)*i)->threadId_ != this->threadId_) continue;
-      return true;
+      if (*i != rhs) return true;
    }
 
    return false;
 }
 
+//--------------------------------------------------------------------------
+//
+// PRE-CONDITION: transactionsInFlightMutex is obtained prior to call
+//
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::add_to_inflight(transaction *t)
+{
+   if (transactionsInFlight_.insert(t).second) t->inflightOfThreadRef_.push_back(t);
+}
+
+//--------------------------------------------------------------------------
+//
+// PRE-CONDITION: transactionsInFlightMutex is obtained prior to call
+//
+//--------------------------------------------------------------------------
+inline void boost::stm::transaction::remove_from_inflight(transaction *t)
+{
+   if (0 == transactionsInFlight_.erase(t)) return;
+
+   InflightOfThread &txs = t->inflightOfThreadRef_;
+   txs.erase(std::find(txs.begin(), txs.end(), t));
+}
+
 
 #endif // TRANSACTION_IMPL_H
 
@@ -0,0 +1,132 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef BOOST_STM_TX_HANDLE__HPP
+#define BOOST_STM_TX_HANDLE__HPP
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+#include <boost/stm/transaction.hpp>
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+namespace boost { namespace stm {
+
+//-----------------------------------------------------------------------------
+// one immutable version of the value held by a tx_handle. versions are only
+// ever created by a writing transaction and deleted through the transaction,
+// they are never written to by the STM
+//-----------------------------------------------------------------------------
+template <typename T>
+class tx_version : public transaction_object< tx_version<T> >
+{
+public:
+
+   tx_version() : value_() {}
+   explicit tx_version(T const &rhs) : value_(rhs) {}
+   tx_version(tx_version const &rhs) : value_(rhs.value_) {}
+   tx_version& operator=(tx_version const &rhs) { value_ = rhs.value_; return *this; }
+
+   T value_;
+};
+
+//-----------------------------------------------------------------------------
+// tx_handle<T> is an indirection object model for large objects. the shared
+// location is a transactional pointer to an immutable tx_version<T>:
+//
+//    read()  - returns the version the transaction sees, nothing is copied
+//    write() - copies the current version once into a new version private
+//              to the transaction and returns it for in-place modification
+//    reset() - builds the new version straight from a value
+//
+// only the pointer takes part in conflict detection, so commit publishes the
+// new version with a single pointer swap whatever the size of T. the replaced
+// version is deleted through the transaction and therefore goes through the
+// same epoch-based reclamation as any other deleted memory, so readers which
+// still hold it never see it freed or torn.
+//
+// as with protected_ptr, the handle is not copyable and deletes its current
+// version when destroyed.
+//-----------------------------------------------------------------------------
+template <typename T>
+class tx_handle
+{
+public:
+
+   typedef tx_version<T> version_type;
+
+   tx_handle() : slot_(new version_type) {}
+   explicit tx_handle(T const &rhs) : slot_(new version_type(rhs)) {}
+
+   ~tx_handle() { delete slot_.value(); }
+
+   //--------------------------------------------------------------------------
+   T const & read(transaction &t) const
+   {
+      return t.read(slot_).value()->value_;
+   }
+
+   //--------------------------------------------------------------------------
+   T& write(transaction &t)
+   {
+      //-----------------------------------------------------------------------
+      // if this transaction already replaced the version, keep writing to it
+      //-----------------------------------------------------------------------
+      slot_type *written = t.get_written(slot_);
+      if (0 != written) return written->value()->value_;
+
+      slot_type &slot = t.write(slot_);
+      version_type *old = slot.value();
+
+      slot.value() = t.new_memory_copy(*old);
+      t.delete_memory(*old);
+
+      return slot.value()->value_;
+   }
+
+   //--------------------------------------------------------------------------
+   void reset(transaction &t, T const &rhs)
+   {
+      t.throw_if_forced_to_abort_on_new();
+
+      slot_type *written = t.get_written(slot_);
+      if (0 != written)
+      {
+         written->value()->value_ = rhs;
+         return;
+      }
+
+      slot_type &slot = t.write(slot_);
+      version_type *old = slot.value();
+
+      slot.value() = t.as_new(new version_type(rhs));
+      t.delete_memory(*old);
+   }
+
+   // Dereferencing the handle, bypassing the protection. the version seen is
+   // always complete, but may be replaced by a concurrent commit
+   T const & unsafe_get() const { return slot_.value()->value_; }
+
+private:
+
+   typedef native_trans<version_type*> slot_type;
+   slot_type slot_;
+
+   /* Copy is not allowed */
+   tx_handle(tx_handle const &);
+   tx_handle& operator=(tx_handle const &);
+};
+
+}}
+#endif // BOOST_STM_TX_HANDLE__HPP
+
@@ -0,0 +1,160 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef BOOST_STM_TX_TRACE__HPP
+#define BOOST_STM_TX_TRACE__HPP
+
+//-----------------------------------------------------------------------------
+// binary transaction event tracing.
+//
+// every thread owns a fixed size ring of compact records, so tracing never
+// allocates or formats on the transactional path and a long run keeps only
+// its most recent events. rings are written to disk as raw records when the
+// thread terminates and turned into text or CSV offline by
+// libs/stm/tools/stm_trace_decode.cpp.
+//
+// this header is shared with the decoder, it must not depend on the rest of
+// the STM.
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+namespace boost { namespace stm {
+
+   enum trace_event
+   {
+      eTraceBegin = 1,
+      eTraceCommit,
+      eTraceAbort
+   };
+
+   enum trace_abort_reason
+   {
+      eTraceNoReason = 0,
+      eTraceAbortSelf,           // explicit abort or restart of the tx itself
+      eTraceAbortForced,         // doomed by another transaction or a lock
+      eTraceAbortInvalidRead,    // commit time validation of the read set
+      eTraceAbortInvalidWrite,   // commit time validation of the write set
+      eTraceAbortCmDenied        // contention manager refused the commit
+   };
+
+   //--------------------------------------------------------------------------
+   // one traced event, fixed width so traces are readable on any platform
+   //--------------------------------------------------------------------------
+   struct trace_record
+   {
+      uint64_t time_;            // steady clock, nanoseconds
+      uint32_t reads_;
+      uint32_t writes_;
+      uint8_t event_;
+      uint8_t reason_;
+      uint8_t pad_[6];
+   };
+
+   struct trace_file_header
+   {
+      char magic_[8];
+      uint32_t version_;
+      uint32_t recordSize_;
+      uint64_t threadId_;
+      uint64_t recorded_;        // events traced by the thread
+      uint64_t kept_;            // newest events stored after the header
+   };
+
+   char const kTraceFileMagic[8] = { 'S', 'T', 'M', 'T', 'R', 'A', 'C', 'E' };
+   uint32_t const kTraceFileVersion = 1;
+   size_t const kDefaultTraceRingSize = 1 << 14;
+
+   //--------------------------------------------------------------------------
+   inline uint64_t trace_now()
+   {
+      using namespace std::chrono;
+      return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+   }
+
+//-----------------------------------------------------------------------------
+// trace_ring is only ever touched by its own thread. the records are
+// allocated on the first event so threads which never trace cost nothing.
+//-----------------------------------------------------------------------------
+class trace_ring
+{
+public:
+
+   explicit trace_ring(size_t threadId, size_t capacity = kDefaultTraceRingSize) :
+      threadId_(threadId), head_(0), mask_(0)
+   {
+      size_t size = 1;
+      while (size < capacity) size <<= 1;
+      mask_ = size - 1;
+   }
+
+   //--------------------------------------------------------------------------
+   void push(trace_event event, trace_abort_reason reason, size_t reads, size_t writes)
+   {
+      if (records_.empty()) records_.resize(mask_ + 1);
+
+      trace_record &r = records_[head_ & mask_];
+      r.time_ = trace_now();
+      r.reads_ = (uint32_t)reads;
+      r.writes_ = (uint32_t)writes;
+      r.event_ = (uint8_t)event;
+      r.reason_ = (uint8_t)reason;
+      ++head_;
+   }
+
+   uint64_t recorded() const { return head_; }
+
+   //--------------------------------------------------------------------------
+   // write the header and the kept records, oldest first
+   //--------------------------------------------------------------------------
+   bool write(char const *fileName) const
+   {
+      FILE *out = fopen(fileName, "wb");
+      if (0 == out) return false;
+
+      trace_file_header header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic_, kTraceFileMagic, sizeof(header.magic_));
+      header.version_ = kTraceFileVersion;
+      header.recordSize_ = sizeof(trace_record);
+      header.threadId_ = threadId_;
+      header.recorded_ = head_;
+      header.kept_ = head_ < records_.size() ? head_ : records_.size();
+
+      bool ok = 1 == fwrite(&header, sizeof(header), 1, out);
+
+      for (uint64_t i = head_ - header.kept_; ok && i < head_; ++i)
+      {
+         ok = 1 == fwrite(&records_[i & mask_], sizeof(trace_record), 1, out);
+      }
+
+      fclose(out);
+      return ok;
+   }
+
+private:
+
+   size_t threadId_;
+   uint64_t head_;
+   size_t mask_;
+   std::vector<trace_record> records_;
+};
+
+}}
+#endif // BOOST_STM_TX_TRACE__HPP
+
@@ -39,6 +39,8 @@
 #include <boost/stm/detail/config.hpp>
 #include <boost/stm/detail/datatypes.hpp>
 #include <boost/stm/detail/transaction_bookkeeping.hpp>
+#include <boost/stm/detail/tx_trace.hpp>
+#include <boost/stm/detail/top_counter.hpp>
 #include <boost/stm/base_transaction.hpp>
 #include <boost/stm/detail/bloom_filter.hpp>
 #include <boost/stm/detail/vector_map.hpp>
@@ -50,7 +52,10 @@
 #include <set>
 #include <map>
 #include <vector>
+#include <typeinfo>
+#include <atomic>
 #include <pthread.h>
+#include <errno.h>
 
 #include <boost/stm/detail/transactions_stack.hpp>
 
@@ -94,12 +99,11 @@ namespace boost { namespace stm {
 #endif
 
 
-#if CAPTURING_PROFILE_DATA
 ///////////////////////////////////////////////////////////////////////////////
 class TxFileAndNumber
 {
 public:
-   TxFileAndNumber(char* str, size_t num) { fileName_ = str; lineNumber_ = num; }
+   TxFileAndNumber(char const *str, size_t num) { fileName_ = str; lineNumber_ = num; }
 
    bool operator<(TxFileAndNumber const &rhs) const
    {
@@ -111,10 +115,168 @@ public:
       return lineNumber_ < rhs.lineNumber_;
    }
 
-   char *fileName_;
+   char const *fileName_;
    size_t lineNumber_;
 };
-#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// a snapshot of what the transactions of one atomic site have done
+///////////////////////////////////////////////////////////////////////////////
+class tx_site_profile
+{
+public:
+   explicit tx_site_profile(TxFileAndNumber const &location) : location_(location),
+      commits_(0), aborts_(0), retries_(0), reads_(0), writes_(0), timeNs_(0) {}
+
+   //--------------------------------------------------------------------------
+   // reads and writes are per attempt, committed or aborted
+   //--------------------------------------------------------------------------
+   double mean_reads() const { return attempts() ? double(reads_) / attempts() : 0; }
+   double mean_writes() const { return attempts() ? double(writes_) / attempts() : 0; }
+   uint64 attempts() const { return commits_ + aborts_; }
+
+   TxFileAndNumber location_;
+   uint64 commits_;
+   uint64 aborts_;
+   uint64 retries_;
+   uint64 reads_;
+   uint64 writes_;
+   uint64 timeNs_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// tx_site is the static per source location descriptor the atomic macros
+// hand to their transaction (see BOOST_STM_TX_SITE). the transaction keeps
+// its own counts across retries and adds them to the site once, when it is
+// destroyed, so a site costs a few uncontended adds per atomic block.
+///////////////////////////////////////////////////////////////////////////////
+class tx_site
+{
+public:
+
+   inline tx_site(char const *file, size_t line);
+
+   TxFileAndNumber const & location() const { return location_; }
+
+   void record(bool committed, size_t aborts, size_t retries, size_t reads,
+      size_t writes, uint64 timeNs)
+   {
+      if (committed) commits_.fetch_add(1, std::memory_order_relaxed);
+      aborts_.fetch_add(aborts, std::memory_order_relaxed);
+      retries_.fetch_add(retries, std::memory_order_relaxed);
+      reads_.fetch_add(reads, std::memory_order_relaxed);
+      writes_.fetch_add(writes, std::memory_order_relaxed);
+      timeNs_.fetch_add(timeNs, std::memory_order_relaxed);
+   }
+
+   void add_to(tx_site_profile &profile) const
+   {
+      profile.commits_ += commits_.load(std::memory_order_relaxed);
+      profile.aborts_ += aborts_.load(std::memory_order_relaxed);
+      profile.retries_ += retries_.load(std::memory_order_relaxed);
+      profile.reads_ += reads_.load(std::memory_order_relaxed);
+      profile.writes_ += writes_.load(std::memory_order_relaxed);
+      profile.timeNs_ += timeNs_.load(std::memory_order_relaxed);
+   }
+
+private:
+
+   TxFileAndNumber location_;
+   std::atomic<uint64> commits_;
+   std::atomic<uint64> aborts_;
+   std::atomic<uint64> retries_;
+   std::atomic<uint64> reads_;
+   std::atomic<uint64> writes_;
+   std::atomic<uint64> timeNs_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// what a committing transaction leaves in the descriptor of a transaction it
+// forces to abort. the object is 0 when only the bloom filters of the two
+// transactions intersected and the aborter site is 0 when the aborter was
+// not built by an atomic macro.
+//
+// the committer writes it while the victim may be reading it, so the fields
+// are atomic: the committer stores forced_ last with release, and the other
+// fields may only be read once forced() has returned true.
+///////////////////////////////////////////////////////////////////////////////
+class tx_conflict
+{
+public:
+   tx_conflict() : forced_(false), object_(0), type_(0), aborter_(0) {}
+
+   void blame(base_transaction_object const *object, char const *type, tx_site const *aborter)
+   {
+      object_.store(object, std::memory_order_relaxed);
+      type_.store(type, std::memory_order_relaxed);
+      aborter_.store(aborter, std::memory_order_relaxed);
+      forced_.store(true, std::memory_order_release);
+   }
+
+   void reset() { forced_.store(false, std::memory_order_relaxed); }
+
+   bool forced() const { return forced_.load(std::memory_order_acquire); }
+   base_transaction_object const * object() const { return object_.load(std::memory_order_relaxed); }
+   char const * type() const { return type_.load(std::memory_order_relaxed); }
+   tx_site const * aborter() const { return aborter_.load(std::memory_order_relaxed); }
+
+private:
+   tx_conflict(tx_conflict const &);
+   tx_conflict & operator=(tx_conflict const &);
+
+   std::atomic<bool> forced_;
+   std::atomic<base_transaction_object const *> object_;
+   std::atomic<char const *> type_;    // typeid(*object_).name()
+   std::atomic<tx_site const *> aborter_;
+};
+
+// the keys of the conflict profile
+struct tx_conflict_object
+{
+   tx_conflict_object(void const *object, char const *type) : object_(object), type_(type) {}
+   bool operator==(tx_conflict_object const &rhs) const { return object_ == rhs.object_; }
+
+   void const *object_;
+   char const *type_;
+};
+
+struct tx_conflict_pair
+{
+   tx_conflict_pair(tx_site const *aborter, tx_site const *victim) :
+      aborter_(aborter), victim_(victim) {}
+   bool operator==(tx_conflict_pair const &rhs) const
+   { return aborter_ == rhs.aborter_ && victim_ == rhs.victim_; }
+
+   tx_site const *aborter_;
+   tx_site const *victim_;
+};
+
+size_t const kConflictProfileEntries = 256;
+
+// the contention intensity above which a thread is scheduled, and how much
+// of the intensity is kept at the end of every attempt
+double const kDefaultScheduleThreshold = 0.5;
+double const kScheduleIntensityDecay = 0.7;
+
+// the serial fallback: the abort ratio which trips it, the window it is
+// measured over, the fewest attempts a window needs to count and the
+// shortest and longest trip in windows
+double const kDefaultSerialFallbackThreshold = 0.5;
+uint64 const kSerialFallbackWindowNs = 10 * 1000 * 1000;
+uint64 const kSerialFallbackMinAttempts = 32;
+size_t const kSerialFallbackMinHold = 4;
+size_t const kSerialFallbackMaxHold = 256;
+
+// the longest a transaction parks at a closed LATM begin gate before it
+// checks again
+uint64 const kLatmGateParkNs = 10 * 1000 * 1000;
+
+// the longest a transaction blocked by LATM waits before it checks again
+uint64 const kLatmBlockParkNs = 10 * 1000 * 1000;
+
+// how often a transaction waiting for a reader-writer lock checks whether
+// it has been forced to abort
+uint64 const kLatmRwLockPollNs = 1000 * 1000;
 
 ///////////////////////////////////////////////////////////////////////////////
 // transaction Class
@@ -148,19 +310,88 @@ public:
    typedef std::list<base_transaction_object*> MemoryContainerList;
 #endif
 
-#if CAPTURING_PROFILE_DATA
-   typedef std::map<size_t, std::ostringstream*> ThreadOstringStream;
-   typedef std::map<size_t, std::map<TxFileAndNumber, size_t>* > ThreadMapTxFileAndNumber;
-#endif
+   typedef std::vector<tx_site*> TxSites;
 
    typedef std::map<size_t, TransactionsStack*> ThreadTransactionsStack;
+   typedef std::map<size_t, trace_ring*> ThreadTraceRings;
    typedef std::map<size_t, WriteContainer*> ThreadWriteContainer;
    typedef std::map<size_t, TxType*> ThreadTxTypeContainer;
 
    typedef std::set<transaction*> TContainer;
    typedef std::set<transaction*> InflightTxes;
 
-   typedef std::multimap<size_t, MemoryContainerList > DeletionBuffer;
+   //--------------------------------------------------------------------------
+   // epoch-based reclamation: a thread announces the global epoch when its
+   // outermost transaction goes in-flight and parks the memory its commits
+   // delete in its own limbo list, stamped with the epoch of retirement. limbo
+   // entries are freed in batches once every announced epoch is past them.
+   //--------------------------------------------------------------------------
+   typedef std::pair<size_t, base_transaction_object*> EpochLimboEntry;
+   typedef std::vector<EpochLimboEntry> EpochLimbo;
+
+   static size_t const kQuiescentEpoch = ~size_t(0);
+   static size_t const kEpochReclaimBatch = 64;
+
+   struct epoch_record
+   {
+      epoch_record() : announced(kQuiescentEpoch), depth(0) {}
+
+      std::atomic<size_t> announced;
+      size_t depth;
+      EpochLimbo limbo;
+   };
+
+   typedef std::map<size_t, epoch_record*> ThreadEpochRecords;
+
+   //--------------------------------------------------------------------------
+   // the contention intensity of a thread, see enable_scheduling()
+   //--------------------------------------------------------------------------
+   struct schedule_record
+   {
+      schedule_record() : intensity(0) {}
+
+      double intensity;
+   };
+
+   typedef std::map<size_t, schedule_record*> ThreadScheduleRecords;
+
+   //--------------------------------------------------------------------------
+   // the LATM locks a thread owns, of all latmLockedLocksOfThreadMap_ and of
+   // those in tmConflictingLocks_, see can_go_inflight()
+   //--------------------------------------------------------------------------
+   struct latm_held_record
+   {
+      latm_held_record() : locks(0), tmConflictingLocks(0) {}
+
+      std::atomic<size_t> locks;
+      std::atomic<size_t> tmConflictingLocks;
+   };
+
+   typedef std::map<size_t, latm_held_record*> ThreadLatmHeldRecords;
+
+   //--------------------------------------------------------------------------
+   // what a thread blocked by LATM waits on, signaled when it is unblocked,
+   // see wake_latm_blocked_thread()
+   //--------------------------------------------------------------------------
+   struct latm_wait_record
+   {
+      latm_wait_record()
+      {
+         pthread_mutex_init(&mutex, 0);
+         pthread_cond_init(&cond, 0);
+      }
+
+      ~latm_wait_record()
+      {
+         pthread_cond_destroy(&cond);
+         pthread_mutex_destroy(&mutex);
+      }
+
+      Mutex mutex;
+      pthread_cond_t cond;
+   };
+
+   typedef std::map<size_t, latm_wait_record*> ThreadLatmWaitRecords;
 
     typedef std::set<Mutex*> MutexSet;
 
@@ -191,6 +422,46 @@ typedef std::map<size_t, boost::stm::bit_vector*> ThreadBitVectorList;
 
    typedef std::map<Mutex*, ThreadIdSet > MutexThreadSetMap;
    typedef std::map<Mutex*, size_t> MutexThreadMap;
+   typedef std::map<Mutex*, size_t> MutexCountMap;
+
+   //--------------------------------------------------------------------------
+   // the shared holds of a reader-writer LATM lock, see pthread_rdlock().
+   // stopsAllWriters is fixed by the first holder: under full protection, or
+   // tm protection of a tm conflicting lock, every writing tx conflicts with
+   // the hold, otherwise only those with the lock in their tx conflicting set
+   //--------------------------------------------------------------------------
+   struct latm_shared_record
+   {
+      latm_shared_record() : stopsAllWriters(false) {}
+
+      std::vector<size_t> holders;   // a thread id per hold
+      bool stopsAllWriters;
+   };
+
+   typedef std::map<Mutex*, latm_shared_record> LatmSharedLocks;
+   typedef std::map<RwMutex*, Mutex*> RwMutexLatmMap;
+
+   //--------------------------------------------------------------------------
+   // a reader-writer hold taken inside a tx, see release_latm_rw_holds()
+   //--------------------------------------------------------------------------
+   struct latm_rw_hold
+   {
+      latm_rw_hold(RwMutex *l, bool s) : lock(l), shared(s) {}
+
+      RwMutex *lock;
+      bool shared;
+   };
+
+   typedef std::map<size_t, std::vector<latm_rw_hold> > LatmRwHolds;
+   typedef std::map<Mutex*, bloom_filter*> MutexBloomMap;
+
+   //--------------------------------------------------------------------------
+   // the in-flight transactions of one thread, kept next to
+   // transactionsInFlight_ so the transactions of a thread are found
+   // without walking every transaction in flight
+   //--------------------------------------------------------------------------
+   typedef std::vector<transaction*> InflightOfThread;
+   typedef std::map<size_t, InflightOfThread*> ThreadInflightTxes;
 
    typedef std::set<transaction*> LockedTransactionContainer;
 
@@ -227,6 +498,80 @@ typedef std::map<size_t, boost::stm::bit_vector*> ThreadBitVectorList;
 
    inline static const transaction_bookkeeping & bookkeeping() { return bookkeeping_; }
 
+   //--------------------------------------------------------------------------
+   // binary event tracing, see tx_trace.hpp. when off it costs one branch per
+   // begin, commit and abort
+   //--------------------------------------------------------------------------
+   inline static void enable_tracing() { tracing_ = true; }
+   inline static void disable_tracing() { tracing_ = false; }
+   inline static bool tracing() { return tracing_; }
+
+   //--------------------------------------------------------------------------
+   // per atomic site profiling. only transactions built by the atomic macros
+   // have a site, and only while profiling is on when they are constructed
+   //--------------------------------------------------------------------------
+   inline static void enable_site_profiling() { siteProfiling_ = true; }
+   inline static void disable_site_profiling() { siteProfiling_ = false; }
+   inline static bool site_profiling() { return siteProfiling_; }
+
+   static void register_site(tx_site *site);
+   static std::vector<tx_site_profile> site_profile();
+   static void output_site_profile(std::ostream &out, size_t top = 0);
+
+   //--------------------------------------------------------------------------
+   // conflict attribution. a transaction forced to abort by a commit always
+   // knows the object and the site of the committer through conflict(); while
+   // conflict profiling is on, the forced aborts are also counted by object
+   // and by (aborter site, victim site) in bounded top-N tables
+   //--------------------------------------------------------------------------
+   inline static void enable_conflict_profiling() { conflictProfiling_ = true; }
+   inline static void disable_conflict_profiling() { conflictProfiling_ = false; }
+   inline static bool conflict_profiling() { return conflictProfiling_; }
+
+   static std::vector<top_counter<tx_conflict_object>::entry> hot_objects(size_t top = 0);
+   static std::vector<top_counter<tx_conflict_pair>::entry> conflict_pairs(size_t top = 0);
+   static void output_conflict_profile(std::ostream &out, size_t top = 10);
+
+   tx_conflict const & conflict() const { return conflict_; }
+
+   //--------------------------------------------------------------------------
+   // abort driven scheduling, after adaptive transaction scheduling (Yoo and
+   // Lee). every thread keeps its contention intensity, a decaying average of
+   // how often its attempts abort. while scheduling is on, a thread above the
+   // threshold starts its outermost transactions only once it holds the
+   // scheduler token, so the threads which keep conflicting run one at a
+   // time instead of aborting each other. the token is held until the
+   // attempt commits or aborts
+   //--------------------------------------------------------------------------
+   inline static void enable_scheduling(double threshold = kDefaultScheduleThreshold)
+   {
+      scheduleThreshold_ = threshold;
+      scheduling_ = true;
+   }
+   inline static void disable_scheduling() { scheduling_ = false; }
+   inline static bool scheduling() { return scheduling_; }
+   inline static double schedule_threshold() { return scheduleThreshold_; }
+
+   inline double contention_intensity() const { return scheduleRef_.intensity; }
+
+   //--------------------------------------------------------------------------
+   // serial fallback, a process wide circuit breaker. while it is enabled the
+   // abort ratio of all threads is sampled every window; above the threshold
+   // the STM trips into serial mode, where outermost transactions go in
+   // flight one at a time under the serial lock, so they cannot conflict.
+   // the first of them waits for the transactions already in flight to
+   // commit or abort, and a transaction which began before the trip waits
+   // while a serialized one is in flight. serial mode lasts a number of
+   // windows which doubles each time it trips again right after recovering
+   //--------------------------------------------------------------------------
+   static void enable_serial_fallback(double threshold = kDefaultSerialFallbackThreshold);
+   static void disable_serial_fallback();
+   inline static bool serial_fallback() { return serialFallback_; }
+   inline static bool serial_mode() { return serialMode_.load(std::memory_order_relaxed); }
+
+   // whether the current attempt runs under the serial lock
+   inline bool serialized() const { return serialized_; }
+
    inline static bool early_conflict_detection() { return !directLateWriteReadConflict_ && direct_updating(); }
    inline static bool late_conflict_detection() { return directLateWriteReadConflict_ || !direct_updating(); }
 
@@ -374,6 +719,17 @@ typedef std::map<size_t, boost::stm::bit_vector*> ThreadBitVectorList;
    static int pthread_trylock(Mutex *lock);
    static int pthread_unlock(Mutex *lock);
 
+   //--------------------------------------------------------------------------
+   // reader-writer locks. an exclusive hold is a LATM lock like any Mutex's.
+   // a shared hold only keeps the txs it conflicts with from writing, so
+   // read-only txs run alongside the readers
+   //--------------------------------------------------------------------------
+   static int pthread_rdlock(RwMutex *lock);
+   static int pthread_tryrdlock(RwMutex *lock);
+   static int pthread_wrlock(RwMutex *lock);
+   static int pthread_trywrlock(RwMutex *lock);
+   static int pthread_rwunlock(RwMutex *lock);
+
    inline size_t const & commits() const { return *commits_ref_; }
    inline size_t & commits() { return *commits_ref_; }
 
@@ -466,6 +822,15 @@ typedef std::map<size_t, boost::stm::bit_vector*> ThreadBitVectorList;
    }
    static void tm_lock_conflict(Mutex *lock);
 
+   inline static void tm_lock_conflict(RwMutex &lock)
+   {
+      tm_lock_conflict(&lock);
+   }
+   inline static void tm_lock_conflict(RwMutex *lock)
+   {
+      tm_lock_conflict(latm_rw_mutex(lock));
+   }
+
    static void clear_tm_conflicting_locks();
    inline static MutexSet get_tm_conflicting_locks() { return tmConflictingLocks_; }
 
@@ -487,13 +852,70 @@ typedef std::map<size_t, boost::stm::bit_vector*> ThreadBitVectorList;
    }
    void add_tx_conflicting_lock(Mutex *lock);
 
+   inline void lock_conflict(RwMutex &lock)
+   { add_tx_conflicting_lock(&lock); }
+
+   inline void lock_conflict(RwMutex *lock)
+   { add_tx_conflicting_lock(latm_rw_mutex(lock)); }
+
+   inline void add_tx_conflicting_lock(RwMutex &lock)
+   {
+      add_tx_conflicting_lock(&lock);
+   }
+   inline void add_tx_conflicting_lock(RwMutex *lock)
+   {
+      add_tx_conflicting_lock(latm_rw_mutex(lock));
+   }
+
+   //--------------------------------------------------------------------------
+   // binds objects to a tx conflicting lock. once a lock has objects bound to
+   // it, taking it only aborts the in-flight txs which have touched them and
+   // only the txs which touch them afterwards block; the other txs with the
+   // lock in their tx conflicting set run on. bind before the lock is used,
+   // see latm_object_impl.hpp
+   //--------------------------------------------------------------------------
+   template <typename T>
+   inline static void add_lock_protected_object(Mutex *lock, T const &obj)
+   {
+      add_latm_protected_address(lock, &obj);
+   }
+
+   template <typename T>
+   inline static void add_lock_protected_range(Mutex *lock, T const *first, T const *last)
+   {
+      for (; first != last; ++first) add_latm_protected_address(lock, first);
+   }
+
+   static void clear_lock_protected_objects(Mutex *lock);
+
+   template <typename T>
+   inline static void add_lock_protected_object(RwMutex *lock, T const &obj)
+   {
+      add_lock_protected_object(latm_rw_mutex(lock), obj);
+   }
+
+   template <typename T>
+   inline static void add_lock_protected_range(RwMutex *lock, T const *first, T const *last)
+   {
+      add_lock_protected_range(latm_rw_mutex(lock), first, last);
+   }
+
+   inline static void clear_lock_protected_objects(RwMutex *lock)
+   {
+      clear_lock_protected_objects(latm_rw_mutex(lock));
+   }
+
    void clear_tx_conflicting_locks();
+   void forget_tx_conflicting_locks();
    //MutexSet get_tx_conflicting_locks() { return conflictingMutexRef_; }
 #endif
 
    void add_to_obtained_locks(Mutex* );
    static void unblock_conflicting_threads(Mutex *mutex);
    static bool mutex_is_on_obtained_tx_list(Mutex *mutex);
+   bool mutex_is_obtained_by_other_thread(Mutex *mutex);
+   static void forget_obtained_lock(Mutex *mutex);
+   static bool release_aborted_tx_lock(Mutex *mutex);
    static void unblock_threads_if_locks_are_empty();
    void clear_latm_obtained_locks();
 
@@ -506,6 +928,7 @@ typedef std::map<size_t, boost::stm::bit_vector*> ThreadBitVectorList;
    //--------------------------------------------------------------------------
    //--------------------------------------------------------------------------
    transaction();
+   explicit transaction(tx_site &site);
    ~transaction();
 
 
@@ -639,12 +1062,16 @@ typedef std::map<size_t, boost::stm::bit_vector*> ThreadBitVectorList;
 #if PERFORMING_VALIDATION
          throw "direct updating not implemented for validation yet";
 #else
-         return direct_read(in);
+         T const &out = direct_read(in);
+         check_latm_protected_object(&in);
+         return out;
 #endif
       }
       else
       {
-         return deferred_read(in);
+         T const &out = deferred_read(in);
+         check_latm_protected_object(&in);
+         return out;
       }
    }
 
@@ -665,15 +1092,43 @@ typedef std::map<size_t, boost::stm::bit_vector*> ThreadBitVectorList;
 #if PERFORMING_VALIDATION
          throw "direct updating not implemented for validation yet";
 #else
+         // the memory is written in place, check it before it is handed out
+         check_latm_protected_object(&in, true);
          return direct_write(in);
 #endif
       }
       else
       {
-         return deferred_write(in);
+         T &out = deferred_write(in);
+         check_latm_protected_object(&in);
+         return out;
       }
    }
 
+   //--------------------------------------------------------------------------
+   // an object bound to a LATM lock is checked against the claims on the
+   // locks in this tx's conflicting set once it is in this tx's bloom. a
+   // claimant counts its claim before it looks at the blooms of the
+   // in-flight txs, so either it sees the object or the object's check sees
+   // the claim. before a direct write the object is put in the bloom here
+   //--------------------------------------------------------------------------
+   inline void check_latm_protected_object(void const *obj, bool beforeWrite = false)
+   {
+#if PERFORMING_LATM && USING_TRANSACTION_SPECIFIC_LATM && USE_BLOOM_FILTER
+      if (get_tx_conflicting_locks().empty()) return;
+
+      if (beforeWrite)
+      {
+         lock_tx();
+         bloom().insert(obj);
+         unlock_tx();
+      }
+
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (0 != latmProtectedClaims_) block_on_latm_protected_object(obj);
+#endif
+   }
+
    //--------------------------------------------------------------------------
    template <typename T>
    inline void delete_memory(T &in)
@@ -836,6 +1291,36 @@ typedef std::map<size_t, boost::stm::bit_vector*> ThreadBitVectorList;
    inline size_t writeListSize() const { return write_list()->size(); }
 
    inline size_t const &priority() const { return priority_; }
+
+   //--------------------------------------------------------------------------
+   // for the contention managers: the commits seen at the first begin since
+   // the last commit (the age of the transaction, kept across retries), the
+   // aborts since the last commit and the reads of the current attempt
+   //--------------------------------------------------------------------------
+   inline size_t begin_stamp() const { return beginStamp_; }
+   inline size_t consecutive_aborts() const { return consecutiveAborts_; }
+   inline size_t attempt_reads() const { return reads_ - readsAtBegin_; }
+
+   //--------------------------------------------------------------------------
+   // starvation freedom: once a transaction has aborted retry_budget() times
+   // in a row, restart() makes it irrevocable. committers then abort
+   // themselves rather than it, so its next attempt commits. 0 never
+   // promotes. the budget of a new transaction is the default budget
+   //--------------------------------------------------------------------------
+   inline static void set_default_retry_budget(size_t const &rhs) { defaultRetryBudget_ = rhs; }
+   inline static size_t default_retry_budget() { return defaultRetryBudget_; }
+
+   inline void set_retry_budget(size_t const &rhs) { retryBudget_ = rhs; }
+   inline size_t retry_budget() const { return retryBudget_; }
+
+   //--------------------------------------------------------------------------
+   // lock elision: the aborts in a row after which an elided lock's critical
+   // section takes the lock rather than running speculatively again, see
+   // elided_lock
+   //--------------------------------------------------------------------------
+   inline static void set_lock_elision_retries(size_t const &rhs) { lockElisionRetries_ = rhs; }
+   inline static size_t lock_elision_retries() { return lockElisionRetries_; }
+
    inline void set_priority(uint32 const &rhs) const { priority_ = rhs; }
    inline void raise_priority()
    {
@@ -849,6 +1334,8 @@ typedef std::map<size_t, boost::stm::bit_vector*> ThreadBitVectorList;
 
    void make_irrevocable();
    void make_isolated();
+   bool try_make_irrevocable();
+   bool try_make_isolated();
    bool irrevocable() const;
    bool isolated() const;
 
@@ -880,12 +1367,21 @@ private:
 
    bool irrevocableTxInFlight();
    bool isolatedTxInFlight();
+   bool otherThreadTxInFlight();
+   bool otherThreadSerialTxInFlight() const;
+
+   static void add_to_inflight(transaction *t);
+   static void remove_from_inflight(transaction *t);
+   inline static InflightOfThread& inflight_of_thread(size_t threadId)
+   { return *threadInflightTxes_.find(threadId)->second; }
    void commit_deferred_update_tx();
 
    bool canAbortAllInFlightTxs();
    bool abortAllInFlightTxs();
+   bool wait_to_become_irrevocable();
    void put_tx_inflight();
    bool can_go_inflight();
+   void wait_while_blocked();
    static transaction* get_inflight_tx_of_same_thread(bool);
 
 #if !PERFORMING_VALIDATION
@@ -1020,11 +1516,31 @@ private:
       //-----------------------------------------------------------------------
       lock(&transactionMutex_);
 
+#if PERFORMING_LATM
+      //-----------------------------------------------------------------------
+      // the memory is written in place, so wait out the shared LATM holds
+      // this tx conflicts with before writing
+      //-----------------------------------------------------------------------
+      if (!latmSharedLocks_.empty())
+      {
+         wait_for_shared_latm_locks();
+
+         if (forced_to_abort())
+         {
+            unlock(&transactionMutex_);
+            lock_and_abort();
+            throw aborted_tx("aborting writer of memory under a shared LATM lock");
+         }
+      }
+#endif
+
       // we currently don't allow write stealing in direct update. if another
-      // tx beat us to the memory, we abort
+      // tx beat us to the memory, we abort. the tx must be aborted before
+      // the throw, atomic() would otherwise commit it without this write
       if (in.transaction_thread() != boost::stm::kInvalidThread)
       {
          unlock(&transactionMutex_);
+         lock_and_abort();
          throw aborted_tx("direct writer already exists.");
       }
 
@@ -1309,8 +1825,15 @@ private:
    // direct and deferred transaction method for version / memory management
    //--------------------------------------------------------------------------
    void directCommitTransactionDeletedMemory() throw();
-   size_t earliest_start_time_of_inflight_txes();
-   void doIntervalDeletions();
+   void retire_deleted_memory() throw();
+   void announce_epoch();
+   void reclaim_epoch_limbo();
+   static size_t oldest_announced_epoch();
+   static void free_epoch_limbo(EpochLimbo &limbo, size_t safeEpoch);
+
+   static size_t next_trace_number(trace_ring const *trace);
+   static void write_trace(trace_ring *trace, size_t traceNumber);
+   static void write_exiting_thread_trace();
 
    void deferredCommitTransactionDeletedMemory() throw();
    void directCommitTransactionNewMemory() { deferredCommitTransactionNewMemory(); }
@@ -1362,16 +1885,65 @@ private:
    //--------------------------------------------------------------------------
    // direct updating methods
    //--------------------------------------------------------------------------
+   //
+   // blocking false makes them fail, rather than wait, when in-flight txs
+   // would have to finish before the lock can be taken (for trylock)
+   //--------------------------------------------------------------------------
    static bool dir_do_core_tm_conflicting_lock_pthread_lock_mutex
-      (Mutex *mutex, int lockWaitTime, int lockAborted);
+      (Mutex *mutex, int lockWaitTime, int lockAborted, bool blocking = true);
    static bool dir_do_core_tx_conflicting_lock_pthread_lock_mutex
-      (Mutex *mutex, int lockWaitTime, int lockAborted, bool txIsIrrevocable);
+      (Mutex *mutex, int lockWaitTime, int lockAborted, bool txIsIrrevocable,
+      bool blocking = true);
    static bool dir_do_core_full_pthread_lock_mutex
-      (Mutex *mutex, int lockWaitTime, int lockAborted);
+      (Mutex *mutex, int lockWaitTime, int lockAborted, bool blocking = true);
 
    static int thread_id_occurance_in_locked_locks_map(size_t threadId);
+   static bool abort_txs_conflicting_with_latm_lock
+      (Mutex *mutex, int lockWaitTime, int lockAborted, bool txIsIrrevocable);
+   static bool tx_conflicting_with_latm_lock_in_flight(Mutex *mutex, bool forcedOnly);
+   static void block_thread_on_latm_lock(Mutex *mutex, size_t threadId);
+   static void unblock_threads_on_latm_lock(Mutex *mutex);
+   static size_t latm_blocks(size_t threadId);
+   static void set_latm_lock_owner(Mutex *mutex);
+   static void clear_latm_lock_owner(Mutex *mutex);
+   static void count_latm_lock_owner(Mutex *mutex, size_t threadId, bool locked);
+   void park_at_latm_gate();
+   static void timed_wait_at_latm_gate();
+   static void wake_latm_blocked_thread(thread_id_t id);
+
+   //--------------------------------------------------------------------------
+   // reader-writer LATM locks keep their LATM state under a Mutex of their
+   // own, see latm_rw_impl.hpp
+   //--------------------------------------------------------------------------
+   static Mutex* latm_rw_mutex(RwMutex *lock);
+   static int lock_rw_in_tx(transaction *t, RwMutex *lock, bool shared);
+   static int latm_shared_lock(Mutex *mutex, bool blocking);
+   static bool latm_shared_unlock(Mutex *mutex);
+   static void remember_latm_rw_hold(RwMutex *lock, bool shared);
+   static void forget_latm_rw_hold(RwMutex *lock);
+   static void forget_latm_rw_holds();
+   void release_latm_rw_holds();
+   static bool abort_txs_writing_under_shared_latm_lock
+      (Mutex *mutex, bool allTxs, int lockWaitTime, int lockAborted, bool blocking);
+   bool shared_latm_lock_stops_writes();
+   void wait_for_shared_latm_locks();
+
+   //--------------------------------------------------------------------------
+   // tx conflicting locks with objects bound to them, see
+   // latm_object_impl.hpp
+   //--------------------------------------------------------------------------
+   static void add_latm_protected_address(Mutex *lock, void const *address);
+   static bloom_filter* latm_protected_objects(Mutex *mutex);
+   static bool claim_latm_protected_lock(Mutex *mutex);
+   static void release_latm_protected_lock(Mutex *mutex);
+   bool latm_protected_objects_touched(Mutex *mutex);
+   void block_on_latm_protected_object(void const *obj);
+
+   void lock_latm_access_unless_aborted();
+   void make_irrevocable_unless_aborted();
 
    static void wait_until_all_locks_are_released(bool);
+   static bool wait_until_in_flight_txs_are_gone();
 
    //--------------------------------------------------------------------------
    // deferred updating locking methods
@@ -1406,7 +1978,9 @@ private:
    //--------------------------------------------------------------------------
 
    //--------------------------------------------------------------------------
-   static DeletionBuffer deletionBuffer_;
+   static std::atomic<size_t> globalEpoch_;
+   static ThreadEpochRecords threadEpochRecords_;
+   static EpochLimbo orphanedLimbo_;
    static std::ofstream logFile_;
 
    static MutexSet tmConflictingLocks_;
@@ -1417,7 +1991,7 @@ private:
    static LatmType eLatmType_;
    static InflightTxes transactionsInFlight_;
 
-   static Mutex deletionBufferMutex_;
+   static Mutex epochMutex_;
    static Mutex transactionMutex_;
    static Mutex transactionsInFlightMutex_;
    static Mutex latmMutex_;
@@ -1427,7 +2001,83 @@ private:
    static bool directLateWriteReadConflict_;
    static bool dynamicPriorityAssignment_;
    static bool usingMoveSemantics_;
+   static bool tracing_;
+   static bool siteProfiling_;
+   static bool conflictProfiling_;
+   static bool scheduling_;
+   static size_t defaultRetryBudget_;
+   static size_t lockElisionRetries_;
+   static bool serialFallback_;
+   static double serialFallbackThreshold_;
+   static std::atomic<bool> serialMode_;
+   static std::atomic<uint64> lastSerialSample_;
+   static std::atomic<size_t> serialThread_;   // of the serialized tx in flight
+   static Mutex serialMutex_;
+   static Mutex serialSampleMutex_;
+   static ThreadInflightTxes threadInflightTxes_;
+
+   //--------------------------------------------------------------------------
+   // tx conflicting lock indexes, so locking and unlocking cost the threads
+   // involved rather than every thread and every lock:
+   //
+   //    latmConflictingThreads_ - mutex -> threads with it in their tx
+   //                              conflicting lock set
+   //    latmObtainedLockCounts_ - mutex -> threads with it on their obtained
+   //                              locks list
+   //    threadLatmBlocks_       - thread -> entries of
+   //                              latmLockedLocksAndThreadIdsMap_ naming it
+   //
+   // all three are kept under latmIndexMutex_, which is never held while
+   // another lock is taken
+   //--------------------------------------------------------------------------
+#if PERFORMING_LATM
+   static MutexThreadSetMap latmConflictingThreads_;
+   static MutexCountMap latmObtainedLockCounts_;
+   static ThreadSizetMap threadLatmBlocks_;
+   static Mutex latmIndexMutex_;
+
+   //--------------------------------------------------------------------------
+   // the begin gate counters: entries of latmLockedLocksOfThreadMap_ and those
+   // of them in tmConflictingLocks_, changed under latmMutex_ and read without
+   // it. the per-thread part lives in threadLatmHeld_, kept under
+   // latmIndexMutex_. transactions parked at a closed gate wait on
+   // latmGateCond_
+   //--------------------------------------------------------------------------
+   static std::atomic<size_t> latmHeldLocks_;
+   static std::atomic<size_t> latmHeldTmConflictingLocks_;
+   static ThreadLatmHeldRecords threadLatmHeld_;
+   static std::atomic<size_t> latmGateWaiters_;
+   static Mutex latmGateMutex_;
+   static pthread_cond_t latmGateCond_;
+
+   // the wait records of the threads, kept under latmIndexMutex_
+   static ThreadLatmWaitRecords threadLatmWaits_;
+
+   //--------------------------------------------------------------------------
+   // shared holds of reader-writer locks, changed under latmMutex_ and
+   // general_lock() and read under general_lock(), which writers hold when
+   // they write (direct) or commit (deferred). the Mutexes of the
+   // reader-writer locks and the holds taken inside txs, per thread, are
+   // kept under latmIndexMutex_
+   //--------------------------------------------------------------------------
+   static LatmSharedLocks latmSharedLocks_;
+   static RwMutexLatmMap latmRwMutexes_;
+   static LatmRwHolds latmRwHolds_;
+
+   //--------------------------------------------------------------------------
+   // the objects bound to tx conflicting locks and the threads claiming the
+   // locks, both changed under latmMutex_. latmProtectedClaims_ counts the
+   // claims for the txs checking objects without latmMutex_
+   //--------------------------------------------------------------------------
+   static MutexBloomMap latmProtectedObjects_;
+   static MutexThreadMap latmProtectedLockClaims_;
+   static std::atomic<size_t> latmProtectedClaims_;
+#endif
+   static double scheduleThreshold_;
+   static ThreadScheduleRecords threadScheduleRecords_;
+   static Mutex scheduleMutex_;
    static transaction_bookkeeping bookkeeping_;
+   static ThreadTraceRings threadTraceRings_;
    static base_contention_manager *cm_;
 
    static MapOfTxObjects threadBoundObjects_;
@@ -1584,25 +2234,31 @@ private:
        return *threadConflictingMutexes_.find(threadId_)->second;
     }
     static void thread_conflicting_mutexes_set_all(int b) {
+        var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
         for (ThreadMutexSetContainer::iterator iter = threadConflictingMutexes_.begin();
             threadConflictingMutexes_.end() != iter; ++iter)
         {
-            blocked(iter->first) = b;
+            if (b) blocked(iter->first) = b;
+            else wake_latm_blocked_thread(iter->first);
         }
     }
 
     static void thread_conflicting_mutexes_set_all_cnd(Mutex *mutex, int b) {
-        for (ThreadMutexSetContainer::iterator iter = threadConflictingMutexes_.begin();
-            threadConflictingMutexes_.end() != iter; ++iter)
+        var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+        MutexThreadSetMap::iterator i = latmConflictingThreads_.find(mutex);
+        if (latmConflictingThreads_.end() == i) return;
+
+        for (ThreadIdSet::iterator iter = i->second.begin(); i->second.end() != iter; ++iter)
         {
         // if this mutex is found in the transaction's conflicting mutexes
         // list, then allow the thread to make forward progress again
         // by turning its "blocked" but only if it does not appear in the
         // locked_locks_thread_id_map
-            if (iter->second->find(mutex) != iter->second->end() &&
-                0 == thread_id_occurance_in_locked_locks_map(iter->first))
+            if (0 == latm_blocks(*iter))
             {
-                blocked(iter->first) = false;
+                wake_latm_blocked_thread(*iter);
             }
         }
    }
@@ -1614,25 +2270,24 @@ private:
 
     void block_if_conflict_mutex() {
         //--------------------------------------------------------------------------
-        // iterate through all currently locked locks
+        // if one of the locks obtained by the txs of other threads is in this
+        // tx's conflicting mutex set, we need to block this tx. locks obtained
+        // by this thread (in a parent tx) don't block, nor do locks with
+        // objects bound to them.
+        //
+        // the tx is blocked under latmIndexMutex_, which the thread which
+        // obtained the lock takes to forget it before it unblocks the
+        // conflicting threads, so the block can't slip in after the unblock
         //--------------------------------------------------------------------------
-        for (ThreadMutexSetContainer::iterator i = threadObtainedLocks_.begin();
-        threadObtainedLocks_.end() != i; ++i)
-        {
-            // if these are locks obtained by this thread (in a parent tx), don't block
-            if (i->first == THREAD_ID) continue;
+        var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
 
-            for (MutexSet::iterator j = i->second->begin(); j != i->second->end(); ++j)
+        for (MutexSet::iterator j = get_tx_conflicting_locks().begin();
+        j != get_tx_conflicting_locks().end(); ++j)
+        {
+            if (latm_protected_objects(*j)) continue;
+            if (mutex_is_obtained_by_other_thread(*j))
             {
-                //-----------------------------------------------------------------------
-                // iterate through this transaction's conflicting mutex ref - if one of
-                // the obtained locked locks is in this tx's conflicting mutex set,
-                // we need to block this tx
-                //-----------------------------------------------------------------------
-                if (get_tx_conflicting_locks().find(*j) != get_tx_conflicting_locks().end())
-                {
-                    this->block(); break;
-                }
+                this->block(); break;
             }
         }
    }
@@ -1645,16 +2300,12 @@ private:
     static ThreadTransactionsStack threadTransactionsStack_;
     TransactionsStack& transactionsRef_;
 
-#if CAPTURING_PROFILE_DATA
-   unsigned int txTime();
-
-   static ThreadOstringStream threadOstringStream_;
-   std::ostringstream& ostrRef_;
+   static TxSites sites_;
+   static Mutex siteMutex_;
 
-   static ThreadMapTxFileAndNumber threadFileAndNumberMap_;
-   std::map<TxFileAndNumber, size_t> &txFileAndNumberMap_;
-
-#endif
+   static top_counter<tx_conflict_object> conflictObjects_;
+   static top_counter<tx_conflict_pair> conflictPairs_;
+   static Mutex conflictMutex_;
 
    public:
     inline TransactionsStack& transactions() {return transactionsRef_;}
@@ -1746,25 +2397,31 @@ private:
        return *threadConflictingMutexes_.find(threadId_)->second;
     }
     static void thread_conflicting_mutexes_set_all(int b) {
+        var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
         for (ThreadMutexSetContainer::iterator iter = threadConflictingMutexes_.begin();
             threadConflictingMutexes_.end() != iter; ++iter)
         {
-            blocked(iter->first) = b;
+            if (b) blocked(iter->first) = b;
+            else wake_latm_blocked_thread(iter->first);
         }
     }
 
     static void thread_conflicting_mutexes_set_all_cnd(Mutex *mutex, int b) {
-        for (ThreadMutexSetContainer::iterator iter = threadConflictingMutexes_.begin();
-            threadConflictingMutexes_.end() != iter; ++iter)
+        var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+        MutexThreadSetMap::iterator i = latmConflictingThreads_.find(mutex);
+        if (latmConflictingThreads_.end() == i) return;
+
+        for (ThreadIdSet::iterator iter = i->second.begin(); i->second.end() != iter; ++iter)
         {
         // if this mutex is found in the transaction's conflicting mutexes
         // list, then allow the thread to make forward progress again
         // by turning its "blocked" but only if it does not appear in the
         // locked_locks_thread_id_map
-            if (iter->second->find(mutex) != iter->second->end() &&
-                0 == thread_id_occurance_in_locked_locks_map(iter->first))
+            if (0 == latm_blocks(*iter))
             {
-                blocked(iter->first) = false;
+                wake_latm_blocked_thread(*iter);
             }
         }
    }
@@ -1776,25 +2433,24 @@ private:
 
     void block_if_conflict_mutex() {
         //--------------------------------------------------------------------------
-        // iterate through all currently locked locks
+        // if one of the locks obtained by the txs of other threads is in this
+        // tx's conflicting mutex set, we need to block this tx. locks obtained
+        // by this thread (in a parent tx) don't block, nor do locks with
+        // objects bound to them.
+        //
+        // the tx is blocked under latmIndexMutex_, which the thread which
+        // obtained the lock takes to forget it before it unblocks the
+        // conflicting threads, so the block can't slip in after the unblock
         //--------------------------------------------------------------------------
-        for (ThreadMutexSetContainer::iterator i = threadObtainedLocks_.begin();
-        threadObtainedLocks_.end() != i; ++i)
-        {
-            // if these are locks obtained by this thread (in a parent tx), don't block
-            if (i->first == THREAD_ID) continue;
+        var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
 
-            for (MutexSet::iterator j = i->second->begin(); j != i->second->end(); ++j)
+        for (MutexSet::iterator j = get_tx_conflicting_locks().begin();
+        j != get_tx_conflicting_locks().end(); ++j)
+        {
+            if (latm_protected_objects(*j)) continue;
+            if (mutex_is_obtained_by_other_thread(*j))
             {
-                //-----------------------------------------------------------------------
-                // iterate through this transaction's conflicting mutex ref - if one of
-                // the obtained locked locks is in this tx's conflicting mutex set,
-                // we need to block this tx
-                //-----------------------------------------------------------------------
-                if (get_tx_conflicting_locks().find(*j) != get_tx_conflicting_locks().end())
-                {
-                    this->block(); break;
-                }
+                this->block(); break;
             }
         }
    }
@@ -1826,7 +2482,62 @@ private:
    mutable size_t priority_;
    transaction_state state_;
    size_t reads_;
-   mutable size_t startTime_;
+   epoch_record &epochRef_;
+   trace_ring &traceRef_;
+   trace_abort_reason abortReason_;
+
+   tx_site *site_;
+   uint64 siteStart_;
+   size_t siteAborts_;
+   size_t siteRetries_;
+   size_t siteWrites_;
+
+   // steady clock of the last begin and of the first begin since the last
+   // commit, for the begin to commit and retry latencies (MEASURING_LATENCIES),
+   // and global_clock() at that first begin
+   uint64 beginTime_;
+   uint64 firstBeginTime_;
+   size_t beginStamp_;
+   size_t consecutiveAborts_;
+   size_t readsAtBegin_;
+   size_t retryBudget_;
+
+   // the atomic site this transaction was built for, kept even when site
+   // profiling is off, and the last commit that forced it to abort
+   tx_site *origin_;
+   tx_conflict conflict_;
+
+   // the scheduling record of the thread, and whether this attempt holds
+   // the scheduler token
+   schedule_record &scheduleRef_;
+   bool scheduled_;
+   bool serialized_;
+#if PERFORMING_LATM
+   latm_held_record &latmHeldRef_;
+   latm_wait_record &latmWaitRef_;
+#endif
+   InflightOfThread &inflightOfThreadRef_;
+
+   void enter_schedule();
+   void release_schedule();
+   void enter_serial();
+   void release_serial();
+   void leave_schedule(bool const aborted);
+   static void sample_serial_fallback();
+
+   //--------------------------------------------------------------------------
+   // called by the committing transaction, before it forces this one to abort
+   //--------------------------------------------------------------------------
+   void conflicted_with(transaction const &aborter, base_transaction_object const *object)
+   {
+      conflict_.blame(object, 0 != object ? typeid(*object).name() : 0, aborter.origin_);
+   }
+
+   void record_conflict();
+
+   void end_transaction();
+   void profiled_end_transaction();
+   void trace_abort();
 
    inline transaction_state const & state() const { return state_; }
 
@@ -1879,14 +2590,28 @@ struct thread_initializer {
 // rand()+1 check is necessarily complex so smart compilers can't
 // optimize the if away
 //---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// BOOST_STM_TX_SITE is the tx_site of the line it is expanded on. the lambda
+// gives every expansion its own function local static, which registers
+// itself the first time the atomic block runs.
+//---------------------------------------------------------------------------
+#define BOOST_STM_TX_SITE \
+   ([]() -> boost::stm::tx_site& { static boost::stm::tx_site site(__FILE__, __LINE__); return site; }())
+
+#if CAPTURING_PROFILE_DATA
+#define BOOST_STM_TX_SITE_ARGS (BOOST_STM_TX_SITE)
+#else
+#define BOOST_STM_TX_SITE_ARGS
+#endif
+
 #ifdef BOOST_STM_COMPILER_DONT_DESTROY_FOR_VARIABLES
-#define use_atomic(T) if (0==rnd()+1) {} else for (boost::stm::transaction T; !T.committed() && T.restart(); T.end())
-#define try_atomic(T) if (0==rnd()+1) {} else for (boost::stm::transaction T; !T.committed() && T.restart(); T.no_throw_end()) try
-#define atomic(T)     if (0==rnd()+1) {} else for (boost::stm::transaction T; !T.committed() && T.check_throw_before_restart() && T.restart_if_not_inflight(); T.no_throw_end()) try
+#define use_atomic(T) if (0==rnd()+1) {} else for (boost::stm::transaction T BOOST_STM_TX_SITE_ARGS; !T.committed() && T.restart_if_not_inflight(); T.end())
+#define try_atomic(T) if (0==rnd()+1) {} else for (boost::stm::transaction T BOOST_STM_TX_SITE_ARGS; !T.committed() && T.restart_if_not_inflight(); T.no_throw_end()) try
+#define atomic(T)     if (0==rnd()+1) {} else for (boost::stm::transaction T BOOST_STM_TX_SITE_ARGS; !T.committed() && T.check_throw_before_restart() && T.restart_if_not_inflight(); T.no_throw_end()) try
 #else
-#define use_atomic(T) for (boost::stm::transaction T; !T.committed() && T.restart(); T.end())
-#define try_atomic(T) for (boost::stm::transaction T; !T.committed() && T.restart(); T.no_throw_end()) try
-#define atomic(T)     for (boost::stm::transaction T; !T.committed() && T.check_throw_before_restart() && T.restart_if_not_inflight(); T.no_throw_end()) try
+#define use_atomic(T) for (boost::stm::transaction T BOOST_STM_TX_SITE_ARGS; !T.committed() && T.restart_if_not_inflight(); T.end())
+#define try_atomic(T) for (boost::stm::transaction T BOOST_STM_TX_SITE_ARGS; !T.committed() && T.restart_if_not_inflight(); T.no_throw_end()) try
+#define atomic(T)     for (boost::stm::transaction T BOOST_STM_TX_SITE_ARGS; !T.committed() && T.check_throw_before_restart() && T.restart_if_not_inflight(); T.no_throw_end()) try
 #endif
 
 
@@ -1909,6 +2634,7 @@ struct thread_initializer {
 #include <boost/stm/detail/latm_general_impl.hpp>
 #include <boost/stm/detail/auto_lock.hpp>
 #include <boost/stm/detail/tx_ptr.hpp>
+#include <boost/stm/detail/tx_handle.hpp>
 
 ///////////////////////////////////////////////////////////////////////////////
 #endif // BOOST_STM_TRANSACTION__HPP
@@ -33,11 +33,43 @@
 #include <boost/stm/contention_manager.hpp>
 #include <boost/stm/transaction.hpp>
 #include <pthread.h>
+#include <thread>
+#include <chrono>
 
 eContentionManager currentCm = iAggr;
 
 using namespace boost::stm;
 
+////////////////////////////////////////////////////////////////////////////
+// below this a sleep mostly measures the scheduler, not the wait asked for
+////////////////////////////////////////////////////////////////////////////
+static uint64 const kSpinBackoffUs = 50;
+
+void backoff_for(uint64 us)
+{
+   if (0 == us) return;
+
+   if (us < kSpinBackoffUs)
+   {
+      uint64 const until = trace_now() + us * 1000;
+      while (trace_now() < until) std::this_thread::yield();
+   }
+   else std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+////////////////////////////////////////////////////////////////////////////
+// the random number only spreads the threads out, so a hash of the clock
+// and the thread is enough and needs no shared generator
+////////////////////////////////////////////////////////////////////////////
+uint64 backoff_random(size_t threadId)
+{
+   uint64 x = trace_now() ^ (uint64(threadId) * 0x9E3779B97F4A7C15ull);
+   x ^= x >> 33;
+   x *= 0xff51afd7ed558ccdull;
+   x ^= x >> 33;
+   return x;
+}
+
 ////////////////////////////////////////////////////////////////////////////
 void DefaultContentionManager::abort_on_write
 (transaction &t, base_transaction_object const &in)
@@ -140,3 +172,211 @@ void ExceptAndBackOffOnAbortNoticeCM::abort_on_new(boost::stm::transaction const
    t.lock_and_abort();
    throw aborted_transaction_exception("aborting transaction");
 }
+
+/////////////////////////////////////////////////////////////////////////
+char const * ExceptAndBackOffOnAbortNoticeCM::name() const
+{
+   switch (currentCm)
+   {
+   case iAggr: return "iAggr";
+   case iPrio: return "iPrio";
+   case iFair: return "iFair";
+   case threadFair: return "threadFair";
+   case iBalanced: return "iBalanced";
+   default: return "unknown";
+   }
+}
+
+/////////////////////////////////////////////////////////////////////////
+// consecutive_aborts() is reset when the transaction commits
+/////////////////////////////////////////////////////////////////////////
+void ExceptAndBackOffOnAbortNoticeCM::on_restart(transaction &t)
+{
+   uint64 const window = backoff_window_us(t.consecutive_aborts());
+   if (0 != window) backoff_for(backoff_random(t.thread_id()) % window);
+}
+
+uint64 ExceptAndBackOffOnAbortNoticeCM::backoff_window_us(size_t aborts) const
+{
+   if (0 == aborts || initialSleepTime_ <= 0) return 0;
+
+   uint64 window = initialSleepTime_;
+   for (size_t i = 1; i < aborts && (int)i <= kMaxIncreases_; ++i)
+   {
+      window *= kSleepFactorIncrease_ > 1 ? kSleepFactorIncrease_ : 1;
+   }
+
+   return window < kMaxSleepTime_ || 0 == kMaxSleepTime_ ? window : kMaxSleepTime_;
+}
+
+/////////////////////////////////////////////////////////////////////////
+void PolicyContentionManager::random_backoff(transaction const &t, size_t exponent)
+{
+   if (0 == exponent) return;
+   if (exponent > kMaxBackoffExponent) exponent = kMaxBackoffExponent;
+
+   backoff_for(backoff_random(t.thread_id()) % (uint64(kBackoffUnitUs) << exponent));
+}
+
+/////////////////////////////////////////////////////////////////////////
+void TimestampCM::on_restart(transaction &t)
+{
+   if (0 != t.consecutive_aborts())
+   {
+      backoff_for(kTimestampWaitUs);
+   }
+}
+
+/////////////////////////////////////////////////////////////////////////
+// a transaction of a thread which holds the token (a nested transaction
+// of the holder) goes on, it must not wait for its own thread
+/////////////////////////////////////////////////////////////////////////
+void SerializingCM::on_restart(transaction &t)
+{
+   if (0 == t.consecutive_aborts()) return;
+   if (t.thread_id() == ownerThread_.load()) return;
+
+   while (true)
+   {
+      transaction const *expected = 0;
+      if (owner_.compare_exchange_weak(expected, &t))
+      {
+         ownerThread_.store(t.thread_id());
+         return;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(kBackoffUnitUs));
+   }
+}
+
+/////////////////////////////////////////////////////////////////////////
+double const AdaptiveCM::kAdaptiveEscalate = 0.25;
+double const AdaptiveCM::kAdaptiveRelax = 0.05;
+
+AdaptiveCM::AdaptiveCM() : current_(0), switches_(0), lastSample_(0),
+   windows_(kAdaptiveWindows), nextWindow_(0), above_(0), below_(0)
+{
+   policies_.push_back(new AggressiveCM);
+   policies_.push_back(new PolkaCM);
+   policies_.push_back(new GreedyCM);
+   policies_.push_back(new SerializingCM);
+
+   pthread_mutex_init(&sampleMutex_, 0);
+}
+
+AdaptiveCM::AdaptiveCM(std::vector<base_contention_manager*> const &policies) :
+   policies_(policies), current_(0), switches_(0), lastSample_(0),
+   windows_(kAdaptiveWindows), nextWindow_(0), above_(0), below_(0)
+{
+   if (policies_.empty()) throw "adaptive contention manager without policies";
+   pthread_mutex_init(&sampleMutex_, 0);
+}
+
+AdaptiveCM::~AdaptiveCM()
+{
+   for (size_t i = 0; i < policies_.size(); ++i) delete policies_[i];
+   pthread_mutex_destroy(&sampleMutex_);
+}
+
+/////////////////////////////////////////////////////////////////////////
+// cheap for every thread but the one which takes the sample
+/////////////////////////////////////////////////////////////////////////
+void AdaptiveCM::sample()
+{
+   uint64 const now = trace_now();
+   if (now - lastSample_.load(std::memory_order_relaxed) < kAdaptiveWindowNs) return;
+
+   if (0 != pthread_mutex_trylock(&sampleMutex_)) return;
+
+   if (now - lastSample_.load(std::memory_order_relaxed) >= kAdaptiveWindowNs)
+   {
+      lastSample_.store(now, std::memory_order_relaxed);
+      take_sample();
+   }
+
+   pthread_mutex_unlock(&sampleMutex_);
+}
+
+/////////////////////////////////////////////////////////////////////////
+void AdaptiveCM::take_sample()
+{
+   //--------------------------------------------------------------------------
+   // every commit counts in allCommits(), read only ones too
+   //--------------------------------------------------------------------------
+   bookkeeping_snapshot const counts = transaction::bookkeeping().aggregate();
+
+   window cumulative;
+   cumulative.commits_ = counts.allCommits();
+   cumulative.aborts_ = counts.totalAborts();
+   cumulative.committedWork_ = counts.committedWork();
+   cumulative.abortedWork_ = counts.abortedWork();
+
+   window w;
+   w.commits_ = cumulative.commits_ - total_.commits_;
+   w.aborts_ = cumulative.aborts_ - total_.aborts_;
+   w.committedWork_ = cumulative.committedWork_ - total_.committedWork_;
+   w.abortedWork_ = cumulative.abortedWork_ - total_.abortedWork_;
+   total_ = cumulative;
+
+   adapt(w);
+}
+
+/////////////////////////////////////////////////////////////////////////
+void AdaptiveCM::add_sample(uint64 commits, uint64 aborts,
+   uint64 committedWork, uint64 abortedWork)
+{
+   window w;
+   w.commits_ = commits;
+   w.aborts_ = aborts;
+   w.committedWork_ = committedWork;
+   w.abortedWork_ = abortedWork;
+
+   pthread_mutex_lock(&sampleMutex_);
+   adapt(w);
+   pthread_mutex_unlock(&sampleMutex_);
+}
+
+/////////////////////////////////////////////////////////////////////////
+// the caller holds sampleMutex_
+/////////////////////////////////////////////////////////////////////////
+void AdaptiveCM::adapt(window const &w)
+{
+   windows_[nextWindow_] = w;
+   nextWindow_ = (nextWindow_ + 1) % windows_.size();
+
+   window sum;
+   for (size_t i = 0; i < windows_.size(); ++i)
+   {
+      sum.commits_ += windows_[i].commits_;
+      sum.aborts_ += windows_[i].aborts_;
+      sum.committedWork_ += windows_[i].committedWork_;
+      sum.abortedWork_ += windows_[i].abortedWork_;
+   }
+
+   uint64 const attempts = sum.commits_ + sum.aborts_;
+   uint64 const work = sum.committedWork_ + sum.abortedWork_;
+
+   double const abortRatio = 0 == attempts ? 0 : double(sum.aborts_) / double(attempts);
+   double const wasted = 0 == work ? 0 : double(sum.abortedWork_) / double(work);
+   double const contention = abortRatio > wasted ? abortRatio : wasted;
+
+   //--------------------------------------------------------------------------
+   // hysteresis: move one policy at a time and only on a confirmed trend
+   //--------------------------------------------------------------------------
+   above_ = contention > kAdaptiveEscalate ? above_ + 1 : 0;
+   below_ = contention < kAdaptiveRelax ? below_ + 1 : 0;
+
+   size_t const at = current_.load(std::memory_order_relaxed);
+
+   if (above_ >= kAdaptiveConfirm && at + 1 < policies_.size())
+   {
+      current_.store(at + 1, std::memory_order_relaxed);
+      switches_.fetch_add(1, std::memory_order_relaxed);
+      above_ = 0;
+   }
+   else if (below_ >= kAdaptiveConfirm && at > 0)
+   {
+      current_.store(at - 1, std::memory_order_relaxed);
+      switches_.fetch_add(1, std::memory_order_relaxed);
+      below_ = 0;
+   }
+}
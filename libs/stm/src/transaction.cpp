@@ -14,14 +14,17 @@
 #include <boost/stm/transaction.hpp>
 #include <boost/stm/contention_manager.hpp>
 #include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#include <stdlib.h>
+#endif
 
 using namespace std;
 using namespace boost::stm;
 
-#if CAPTURING_PROFILE_DATA
-std::string const kProfilerVersion = "v.2";
-#endif
-
 ///////////////////////////////////////////////////////////////////////////////
 // Static initialization
 ///////////////////////////////////////////////////////////////////////////////
@@ -31,47 +34,86 @@ transaction::MutexThreadSetMap transaction::latmLockedLocksAndThreadIdsMap_;
 transaction::MutexThreadMap transaction::latmLockedLocksOfThreadMap_;
 transaction::ThreadSizetMap transaction::threadCommitMap_;
 transaction::MutexSet transaction::tmConflictingLocks_;
-transaction::DeletionBuffer transaction::deletionBuffer_;
+std::atomic<size_t> transaction::globalEpoch_(0);
+transaction::ThreadEpochRecords transaction::threadEpochRecords_;
+transaction::EpochLimbo transaction::orphanedLimbo_;
 transaction::ThreadTransactionsStack transaction::threadTransactionsStack_;
 transaction::MapOfTxObjects transaction::threadBoundObjects_;
 
-#if CAPTURING_PROFILE_DATA
-transaction::ThreadOstringStream transaction::threadOstringStream_;
-transaction::ThreadMapTxFileAndNumber transaction::threadFileAndNumberMap_;
+transaction::ThreadTraceRings transaction::threadTraceRings_;
+transaction::ThreadScheduleRecords transaction::threadScheduleRecords_;
+transaction::ThreadInflightTxes transaction::threadInflightTxes_;
+#if PERFORMING_LATM
+transaction::MutexThreadSetMap transaction::latmConflictingThreads_;
+transaction::MutexCountMap transaction::latmObtainedLockCounts_;
+transaction::ThreadSizetMap transaction::threadLatmBlocks_;
+std::atomic<size_t> transaction::latmHeldLocks_(0);
+std::atomic<size_t> transaction::latmHeldTmConflictingLocks_(0);
+transaction::ThreadLatmHeldRecords transaction::threadLatmHeld_;
+transaction::ThreadLatmWaitRecords transaction::threadLatmWaits_;
+std::atomic<size_t> transaction::latmGateWaiters_(0);
+transaction::LatmSharedLocks transaction::latmSharedLocks_;
+transaction::RwMutexLatmMap transaction::latmRwMutexes_;
+transaction::LatmRwHolds transaction::latmRwHolds_;
+transaction::MutexBloomMap transaction::latmProtectedObjects_;
+transaction::MutexThreadMap transaction::latmProtectedLockClaims_;
+std::atomic<size_t> transaction::latmProtectedClaims_(0);
 #endif
 
+transaction::TxSites transaction::sites_;
+top_counter<tx_conflict_object> transaction::conflictObjects_(kConflictProfileEntries);
+top_counter<tx_conflict_pair> transaction::conflictPairs_(kConflictProfileEntries);
+
 size_t transaction::global_clock_ = 0;
 size_t transaction::stalls_ = 0;
 
 bool transaction::dynamicPriorityAssignment_ = false;
 bool transaction::direct_updating_ = false;
 bool transaction::directLateWriteReadConflict_ = false;
-bool transaction::usingMoveSemantics_ = false;
+bool transaction::usingMoveSemantics_ = kDracoMoveSemanticsCompiled;
+bool transaction::tracing_ = false;
+bool transaction::siteProfiling_ = false;
+bool transaction::conflictProfiling_ = false;
+bool transaction::scheduling_ = false;
+size_t transaction::defaultRetryBudget_ = 0;
+size_t transaction::lockElisionRetries_ = 3;
+bool transaction::serialFallback_ = false;
+double transaction::serialFallbackThreshold_ = kDefaultSerialFallbackThreshold;
+std::atomic<bool> transaction::serialMode_(false);
+std::atomic<uint64> transaction::lastSerialSample_(0);
+std::atomic<size_t> transaction::serialThread_(kInvalidThread);
+double transaction::scheduleThreshold_ = kDefaultScheduleThreshold;
 
 pthread_mutexattr_t transaction::transactionMutexAttribute_;
 
 Mutex transaction::transactionsInFlightMutex_;
 Mutex transaction::transactionMutex_;
-Mutex transaction::deletionBufferMutex_;
+Mutex transaction::epochMutex_;
+Mutex transaction::siteMutex_;
+Mutex transaction::conflictMutex_;
+Mutex transaction::scheduleMutex_;
+Mutex transaction::serialMutex_;
+Mutex transaction::serialSampleMutex_;
 Mutex transaction::latmMutex_;
+#if PERFORMING_LATM
+Mutex transaction::latmIndexMutex_;
+Mutex transaction::latmGateMutex_;
+pthread_cond_t transaction::latmGateCond_;
+#endif
 
 boost::stm::LatmType transaction::eLatmType_ = eFullLatmProtection;
 std::ofstream transaction::logFile_;
 
 #if USE_STM_MEMORY_MANAGER
-#ifndef BOOST_STM_USE_BOOST_MUTEX
-Mutex base_transaction_object::transactionObjectMutex_ = PTHREAD_MUTEX_INITIALIZER;
-#else
-boost::mutex base_transaction_object::transactionObjectMutex_;
-#endif
-boost::stm::MemoryPool<base_transaction_object> base_transaction_object::memory_(16384);
+boost::stm::CachingMemoryPool<base_transaction_object>
+   base_transaction_object::memory_(kDefaultMagazineSize);
 #endif
 
 bool transaction::initialized_ = false;
 ///////////////////////////////////////////////////////////////////////////////
-// first param = initialSleepTime (millis)
+// first param = initialSleepTime (micros), 0 never backs off
 // second param = sleepIncrease factor (initialSleepTime * factor)
-// third param = # of increases before resetting
+// third param = # of increases before the backoff stops growing
 ///////////////////////////////////////////////////////////////////////////////
 base_contention_manager *transaction::cm_ =
     new ExceptAndBackOffOnAbortNoticeCM(0, 0, 0);
@@ -127,22 +169,30 @@ transaction::tss_context_map_type transaction::tss_context_map_;
 ///////////////////////////////////////////////////////////////////////////////
 void transaction::initialize()
 {
-#if USE_STM_MEMORY_MANAGER
-   base_transaction_object::alloc_size(16384);
-#endif
-
    if (initialized_) return;
    initialized_ = true;
 
    logFile_.open("DracoSTM_log.txt");
 
+   atexit(&transaction::write_exiting_thread_trace);
+
 #ifndef BOOST_STM_USE_BOOST_MUTEX
    //pthread_mutexattr_settype(&transactionMutexAttribute_, PTHREAD_MUTEX_NORMAL);
 
    pthread_mutex_init(&transactionMutex_, 0);
    pthread_mutex_init(&transactionsInFlightMutex_, 0);
-   pthread_mutex_init(&deletionBufferMutex_, 0);
+   pthread_mutex_init(&epochMutex_, 0);
+   pthread_mutex_init(&siteMutex_, 0);
+   pthread_mutex_init(&conflictMutex_, 0);
+   pthread_mutex_init(&scheduleMutex_, 0);
+   pthread_mutex_init(&serialMutex_, 0);
+   pthread_mutex_init(&serialSampleMutex_, 0);
    pthread_mutex_init(&latmMutex_, 0);
+#if PERFORMING_LATM
+   pthread_mutex_init(&latmIndexMutex_, 0);
+   pthread_mutex_init(&latmGateMutex_, 0);
+   pthread_cond_init(&latmGateCond_, 0);
+#endif
 
    //pthread_mutex_init(&transactionMutex_, &transactionMutexAttribute_);
    //pthread_mutex_init(&transactionsInFlightMutex_, &transactionMutexAttribute_);
@@ -366,21 +416,55 @@ void transaction::initialize_thread()
       memIter->second->txType = eNormalTx;
    }
 
-#if CAPTURING_PROFILE_DATA
-   ThreadOstringStream::iterator transactionOstringStreamIter = threadOstringStream_.find(threadId);
-   if (threadOstringStream_.end() == transactionOstringStreamIter)
+#endif
+
+   //--------------------------------------------------------------------------
+   // the epoch record is scanned by reclaiming threads which do not hold the
+   // general access mutex, so it is registered under the epoch mutex as well
+   //--------------------------------------------------------------------------
    {
-      threadOstringStream_[threadId] = new std::ostringstream;
-      *threadOstringStream_[threadId] << "Thread Started: " << threadId << "\t" << kProfilerVersion << endl;
+      var_auto_lock<PLOCK> a(&epochMutex_, 0);
+      if (threadEpochRecords_.end() == threadEpochRecords_.find(threadId))
+      {
+         threadEpochRecords_[threadId] = new epoch_record;
+      }
    }
 
-   ThreadMapTxFileAndNumber::iterator txFileAndNumberIter = threadFileAndNumberMap_.find(threadId);
-   if (threadFileAndNumberMap_.end() == txFileAndNumberIter)
+   ThreadTraceRings::iterator traceIter = threadTraceRings_.find(threadId);
+   if (threadTraceRings_.end() == traceIter)
    {
-      threadFileAndNumberMap_[threadId] = new std::map<TxFileAndNumber, size_t>;
+      threadTraceRings_[threadId] = new trace_ring(threadId);
+   }
+
+   if (threadScheduleRecords_.end() == threadScheduleRecords_.find(threadId))
+   {
+      threadScheduleRecords_[threadId] = new schedule_record;
+   }
+
+   {
+      var_auto_lock<PLOCK> a(inflight_lock(), 0);
+      if (threadInflightTxes_.end() == threadInflightTxes_.find(threadId))
+      {
+         threadInflightTxes_[threadId] = new InflightOfThread;
+      }
    }
-#endif
 
+#if PERFORMING_LATM
+   {
+      var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+      if (threadLatmBlocks_.end() == threadLatmBlocks_.find(threadId))
+      {
+         threadLatmBlocks_[threadId] = new size_t(0);
+      }
+      if (threadLatmHeld_.end() == threadLatmHeld_.find(threadId))
+      {
+         threadLatmHeld_[threadId] = new latm_held_record;
+      }
+      if (threadLatmWaits_.end() == threadLatmWaits_.find(threadId))
+      {
+         threadLatmWaits_[threadId] = new latm_wait_record;
+      }
+   }
 #endif
 
    //--------------------------------------------------------------------------
@@ -513,6 +597,77 @@ void transaction::terminate_thread()
 
 
 
+   //--------------------------------------------------------------------------
+   // free what we can of this thread's limbo list and hand the rest over to
+   // the orphaned limbo list, which is drained by the remaining threads. the
+   // orphaned list must stay ordered by epoch, so the two are merged
+   //--------------------------------------------------------------------------
+   {
+      var_auto_lock<PLOCK> a(&epochMutex_, 0);
+      ThreadEpochRecords::iterator epochIter = threadEpochRecords_.find(threadId);
+      epoch_record *record = epochIter->second;
+      threadEpochRecords_.erase(epochIter);
+
+      free_epoch_limbo(record->limbo, oldest_announced_epoch());
+
+      size_t const orphans = orphanedLimbo_.size();
+      orphanedLimbo_.insert(orphanedLimbo_.end(), record->limbo.begin(), record->limbo.end());
+      std::inplace_merge(orphanedLimbo_.begin(), orphanedLimbo_.begin() + orphans,
+         orphanedLimbo_.end());
+
+      delete record;
+   }
+
+   ThreadTraceRings::iterator traceIter = threadTraceRings_.find(threadId);
+   trace_ring *trace = traceIter->second;
+   threadTraceRings_.erase(traceIter);
+
+   ThreadScheduleRecords::iterator scheduleIter = threadScheduleRecords_.find(threadId);
+   delete scheduleIter->second;
+   threadScheduleRecords_.erase(scheduleIter);
+
+   ThreadInflightTxes::iterator inflightIter = threadInflightTxes_.find(threadId);
+   delete inflightIter->second;
+   threadInflightTxes_.erase(inflightIter);
+
+#if PERFORMING_LATM
+   //--------------------------------------------------------------------------
+   // take the thread off the latm indexes, a lock it left on its conflicting
+   // or obtained lists must not block or wake a thread id which is reused
+   //--------------------------------------------------------------------------
+   {
+      var_auto_lock<PLOCK> a(&latmIndexMutex_, 0);
+
+      for (MutexThreadSetMap::iterator i = latmConflictingThreads_.begin();
+         i != latmConflictingThreads_.end();)
+      {
+         i->second.erase(threadId);
+         if (i->second.empty()) latmConflictingThreads_.erase(i++);
+         else ++i;
+      }
+
+      ThreadSizetMap::iterator blocksIter = threadLatmBlocks_.find(threadId);
+      delete blocksIter->second;
+      threadLatmBlocks_.erase(blocksIter);
+
+      ThreadLatmHeldRecords::iterator heldIter = threadLatmHeld_.find(threadId);
+      delete heldIter->second;
+      threadLatmHeld_.erase(heldIter);
+
+      ThreadLatmWaitRecords::iterator waitIter = threadLatmWaits_.find(threadId);
+      delete waitIter->second;
+      threadLatmWaits_.erase(waitIter);
+
+#ifdef USE_SINGLE_THREAD_CONTEXT_MAP
+      // the blocked flag outlives the thread, a thread which terminated
+      // blocked would leave the next thread with its id blocked
+      blocked(threadId) = false;
+#endif
+   }
+#endif
+
+   size_t const traceNumber = next_trace_number(trace);
+
 #ifndef MAP_THREAD_BOOL_CONTAINER
    {
    // realign all in-flight transactions so they are accessing the correct mutex
@@ -530,28 +685,299 @@ void transaction::terminate_thread()
    unlock_inflight_access();
    unlock_general_access();
 
-#if CAPTURING_PROFILE_DATA
-   ThreadOstringStream::iterator transactionOstringStreamIter = threadOstringStream_.find(threadId);
+   //--------------------------------------------------------------------------
+   // the trace ring is written out after the locks are released, it is no
+   // longer reachable by any other thread
+   //--------------------------------------------------------------------------
+   write_trace(trace, traceNumber);
+}
+
+//-----------------------------------------------------------------------------
+// trace files are numbered in the order their threads terminate, threads
+// which traced nothing get no file
+//
+// PRE-CONDITION: general_lock() is obtained prior to calling this method.
+//
+//-----------------------------------------------------------------------------
+size_t transaction::next_trace_number(trace_ring const *trace)
+{
+   static size_t traceFiles = 0;
+   return 0 != trace->recorded() ? ++traceFiles : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void transaction::write_trace(trace_ring *trace, size_t traceNumber)
+{
+   if (0 != trace->recorded())
+   {
+      std::ostringstream name;
+      name << traceNumber << ".stmtrace";
+
+      if (!trace->write(name.str().c_str()))
+      {
+         std::cout << "unable to write trace file " << name.str() << std::endl;
+      }
+   }
+
+   delete trace;
+}
+
+//-----------------------------------------------------------------------------
+// registered with atexit() by initialize(). the main thread rarely calls
+// terminate_thread(), so the ring of the thread calling exit() is written
+// here. the rings of other threads still running are left alone, they may
+// still be tracing
+//-----------------------------------------------------------------------------
+void transaction::write_exiting_thread_trace()
+{
+   trace_ring *trace = 0;
+   size_t traceNumber = 0;
+
+   {
+      var_auto_lock<PLOCK> a(general_lock(), inflight_lock(), 0);
+
+      ThreadTraceRings::iterator traceIter = threadTraceRings_.find(THREAD_ID);
+      if (threadTraceRings_.end() == traceIter) return;
+
+      trace = traceIter->second;
+      threadTraceRings_.erase(traceIter);
+      traceNumber = next_trace_number(trace);
+   }
+
+   write_trace(trace, traceNumber);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void transaction::register_site(tx_site *site)
+{
+   var_auto_lock<PLOCK> a(&siteMutex_, 0);
+   sites_.push_back(site);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// an inline function using an atomic macro may still end up with one site per
+// translation unit, so sites are merged by their location. the result is
+// ordered by the time spent in the site, most expensive first
+///////////////////////////////////////////////////////////////////////////////
+static bool more_time_spent(tx_site_profile const &lhs, tx_site_profile const &rhs)
+{
+   return lhs.timeNs_ > rhs.timeNs_;
+}
 
-   static int threadOutput = 1;
-   std::ostringstream name;
-   name << threadOutput++ << ".txt";
+std::vector<tx_site_profile> transaction::site_profile()
+{
+   std::map<TxFileAndNumber, tx_site_profile> merged;
 
-   ofstream out(name.str().c_str());
+   {
+      var_auto_lock<PLOCK> a(&siteMutex_, 0);
 
-   out << transactionOstringStreamIter->second->str().c_str() << endl;
+      for (TxSites::iterator i = sites_.begin(); i != sites_.end(); ++i)
+      {
+         std::map<TxFileAndNumber, tx_site_profile>::iterator j =
+            merged.insert(std::make_pair((*i)->location(),
+            tx_site_profile((*i)->location()))).first;
 
-   // output the transactions and their numbers in monotonically increasing order
-   std::map<TxFileAndNumber, size_t>& txFileAndNumberMap = *threadFileAndNumberMap_.find(threadId)->second;
+         (*i)->add_to(j->second);
+      }
+   }
 
-   out << endl << "Transactions: " << endl;
-   for (std::map<TxFileAndNumber, size_t>::iterator it = txFileAndNumberMap.begin(); 
-      txFileAndNumberMap.end() != it; ++it)
+   std::vector<tx_site_profile> profile;
+   for (std::map<TxFileAndNumber, tx_site_profile>::iterator i = merged.begin();
+      i != merged.end(); ++i)
    {
-      out << it->second << "\t" << it->first.fileName_ << "\t" << it->first.lineNumber_ << endl;
+      profile.push_back(i->second);
    }
 
-   out.close();
+   std::stable_sort(profile.begin(), profile.end(), more_time_spent);
+   return profile;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void transaction::output_site_profile(std::ostream &out, size_t top)
+{
+   std::vector<tx_site_profile> profile = site_profile();
+   if (0 != top && profile.size() > top) profile.erase(profile.begin() + top, profile.end());
+
+   std::streamsize const precision = out.precision();
+
+   out << "########################################" << endl;
+   out << "atomic sites by time spent" << endl;
+   out << setw(12) << "time_ms" << setw(12) << "commits" << setw(12) << "aborts"
+       << setw(12) << "retries" << setw(8) << "abort%" << setw(9) << "mean_r"
+       << setw(9) << "mean_w" << "  site" << endl;
+
+   for (size_t i = 0; i < profile.size(); ++i)
+   {
+      tx_site_profile const &p = profile[i];
+      double abortRate = p.attempts() ? 100.0 * p.aborts_ / p.attempts() : 0;
+
+      out << fixed << setprecision(1)
+          << setw(12) << p.timeNs_ / 1e6 << setw(12) << p.commits_
+          << setw(12) << p.aborts_ << setw(12) << p.retries_
+          << setw(8) << abortRate << setw(9) << p.mean_reads()
+          << setw(9) << p.mean_writes() << "  "
+          << p.location_.fileName_ << ":" << p.location_.lineNumber_ << endl;
+   }
+
+   out.unsetf(std::ios::floatfield);
+   out.precision(precision);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// called by a transaction aborting because a commit forced it to
+///////////////////////////////////////////////////////////////////////////////
+void transaction::record_conflict()
+{
+   var_auto_lock<PLOCK> a(&conflictMutex_, 0);
+   conflictObjects_.add(tx_conflict_object(conflict_.object(), conflict_.type()));
+   conflictPairs_.add(tx_conflict_pair(conflict_.aborter(), origin_));
+}
+
+std::vector<top_counter<tx_conflict_object>::entry> transaction::hot_objects(size_t top)
+{
+   var_auto_lock<PLOCK> a(&conflictMutex_, 0);
+   return conflictObjects_.top(top);
+}
+
+std::vector<top_counter<tx_conflict_pair>::entry> transaction::conflict_pairs(size_t top)
+{
+   var_auto_lock<PLOCK> a(&conflictMutex_, 0);
+   return conflictPairs_.top(top);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static std::string type_name(char const *type)
+{
+   if (0 == type) return "(bloom filter)";
+
+#ifdef __GNUC__
+   int status = 0;
+   char *demangled = abi::__cxa_demangle(type, 0, 0, &status);
+   if (0 != demangled)
+   {
+      std::string name(demangled);
+      free(demangled);
+      return name;
+   }
 #endif
+   return type;
 }
 
+static std::string site_name(tx_site const *site)
+{
+   if (0 == site) return "(no site)";
+
+   std::ostringstream o;
+   o << site->location().fileName_ << ":" << site->location().lineNumber_;
+   return o.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// counts are upper bounds, at most "+/-" above the real number of aborts
+///////////////////////////////////////////////////////////////////////////////
+void transaction::output_conflict_profile(std::ostream &out, size_t top)
+{
+   std::vector<top_counter<tx_conflict_object>::entry> objects = hot_objects(top);
+   std::vector<top_counter<tx_conflict_pair>::entry> pairs = conflict_pairs(top);
+
+   out << "########################################" << endl;
+   out << "hot objects by forced aborts" << endl;
+   out << setw(12) << "aborts" << setw(10) << "+/-" << "  object" << endl;
+
+   for (size_t i = 0; i < objects.size(); ++i)
+   {
+      out << setw(12) << objects[i].count_ << setw(10) << objects[i].error_ << "  "
+          << objects[i].key_.object_ << " " << type_name(objects[i].key_.type_) << endl;
+   }
+
+   out << "conflict pairs by forced aborts" << endl;
+   out << setw(12) << "aborts" << setw(10) << "+/-" << "  aborter -> victim" << endl;
+
+   for (size_t i = 0; i < pairs.size(); ++i)
+   {
+      out << setw(12) << pairs[i].count_ << setw(10) << pairs[i].error_ << "  "
+          << site_name(pairs[i].key_.aborter_) << " -> "
+          << site_name(pairs[i].key_.victim_) << endl;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the serial fallback breaker. its state is only touched by the thread
+// holding serialSampleMutex_
+///////////////////////////////////////////////////////////////////////////////
+static uint64 serialSeenCommits = 0;
+static uint64 serialSeenAborts = 0;
+static size_t serialHold = kSerialFallbackMinHold;  // windows a trip lasts
+static size_t serialWindows = 0;                    // windows since the last switch
+
+void transaction::enable_serial_fallback(double threshold)
+{
+   var_auto_lock<PLOCK> a(&serialSampleMutex_, 0);
+
+   serialSeenCommits = bookkeeping_.allCommits();
+   serialSeenAborts = bookkeeping_.totalAborts();
+   serialHold = kSerialFallbackMinHold;
+   serialWindows = 0;
+
+   serialFallbackThreshold_ = threshold;
+   lastSerialSample_.store(trace_now());
+   serialFallback_ = true;
+}
+
+void transaction::disable_serial_fallback()
+{
+   var_auto_lock<PLOCK> a(&serialSampleMutex_, 0);
+
+   serialFallback_ = false;
+   serialMode_.store(false);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// every commit counts in allCommits(), read only ones too.
+// serial mode is left after serialHold windows; tripping again in the first
+// window after that means the load has not subsided, so the next trip lasts
+// twice as long
+///////////////////////////////////////////////////////////////////////////////
+void transaction::sample_serial_fallback()
+{
+   uint64 const now = trace_now();
+   if (now - lastSerialSample_.load(std::memory_order_relaxed) < kSerialFallbackWindowNs) return;
+
+   if (0 != pthread_mutex_trylock(&serialSampleMutex_)) return;
+
+   if (serialFallback_ &&
+      now - lastSerialSample_.load(std::memory_order_relaxed) >= kSerialFallbackWindowNs)
+   {
+      lastSerialSample_.store(now, std::memory_order_relaxed);
+
+      uint64 const commits = bookkeeping_.allCommits();
+      uint64 const aborts = bookkeeping_.totalAborts();
+      uint64 const windowCommits = commits - serialSeenCommits;
+      uint64 const windowAborts = aborts - serialSeenAborts;
+      serialSeenCommits = commits;
+      serialSeenAborts = aborts;
+      ++serialWindows;
+
+      if (serialMode_.load(std::memory_order_relaxed))
+      {
+         if (serialWindows >= serialHold)
+         {
+            serialMode_.store(false);
+            serialWindows = 0;
+         }
+      }
+      else if (windowCommits + windowAborts >= kSerialFallbackMinAttempts &&
+         double(windowAborts) > serialFallbackThreshold_ * double(windowCommits + windowAborts))
+      {
+         if (serialWindows <= 1 && serialHold < kSerialFallbackMaxHold) serialHold *= 2;
+         else if (serialWindows > 1) serialHold = kSerialFallbackMinHold;
+
+         serialWindows = 0;
+         serialMode_.store(true);
+         bookkeeping_.inc_serial_fallbacks();
+      }
+   }
+
+   pthread_mutex_unlock(&serialSampleMutex_);
+}
@@ -37,6 +37,9 @@ extern bool kDoLookup;
 extern bool kDoMove;
 extern bool kMoveSemantics;
 extern std::string bench;
+extern std::string updateMethod;
+extern std::string latmProtection;
+extern std::string csvFile;
 
 extern int kMaxThreads;
 extern int kMainThreadId;
@@ -35,6 +35,16 @@
 #include "testatom.h"
 #include "testEmbedded.h"
 #include "testBufferedDelete.h"
+#include "testTxHandle.h"
+#include "testMemoryPool.h"
+#include "testLatmBench.h"
+#include "testContentionManager.h"
+#include "testRetryBudget.h"
+#include "testSerialFallback.h"
+#include "testTrylock.h"
+#include "testRwLock.h"
+#include "testObjectLock.h"
+#include "testElidedLock.h"
 #if 0
 #include "testLinkedListWithLocks.h"
 #include "testHashMapAndLinkedListsWithLocks.h"
@@ -74,7 +84,9 @@ bool kDoLookup = false;
 bool kDoMove = false;
 bool kMoveSemantics = false;
 std::string bench = "";
-std::string updateMethod = "deferred";
+std::string updateMethod = "";
+std::string latmProtection = "";
+std::string csvFile = "";
 std::string insertAmount = "50000";
 
 int kMaxThreads = 2;
@@ -96,12 +108,33 @@ void usage()
    cout << "                  'accounts'" << endl;
    cout << "                  'embedded'" << endl;
    cout << "                  'delete'" << endl;
+   cout << "                  'handle'" << endl;
+   cout << "                  'pool' - CachingMemoryPool chunks across threads" << endl;
+   cout << "                  'latm' - LATM contention sweep, one CSV row per cell" << endl;
+   cout << "                  'cm' - contention manager decisions (ignores -cm)" << endl;
+   cout << "                  'retry' - irrevocable promotion out of the retry budget" << endl;
+   cout << "                  'serial' - serial fallback trips and serialized attempts" << endl;
+   cout << "                  'trylock' - busy trylocks, every -def/-dir and -latm (ignores both)" << endl;
+   cout << "                  'rwlock' - reader-writer holds released by aborts, every -def/-dir and -latm" << endl;
+   cout << "                  'objlock' - locks with objects bound, every -def/-dir under tx -latm" << endl;
+   cout << "                  'elision' - elided locks and their fall-back, every -def/-dir and -latm" << endl;
    cout << "  -def          - do deferred updating transactions" << endl;
    cout << "  -dir          - do direct updating transactions" << endl;
    cout << "  -latm <name>  - 'full', 'tm', 'tx'" << endl;
+   cout << "  -cm <name>    - 'iAggr', 'iPrio', 'iFair', 'threadFair', 'iBalanced'," << endl;
+   cout << "                  'aggressive', 'passive', 'karma', 'polka', 'timestamp', 'greedy'," << endl;
+   cout << "                  'serializing', 'adaptive'," << endl;
+   cout << "                  'backoff' - the default CM backing off 5us, doubling 10 times" << endl;
    cout << "  -h            - shows this help (usage) output" << endl;
+   cout << "  -trace        - writes a binary event trace per thread (N.stmtrace)" << endl;
+   cout << "  -sites        - reports commits, aborts and time per atomic site" << endl;
+   cout << "  -conflicts    - reports the objects and site pairs causing aborts" << endl;
+   cout << "  -schedule <#> - serializes threads whose abort intensity is above # (0..1)" << endl;
+   cout << "  -retries <#>  - makes a transaction irrevocable after # aborts in a row" << endl;
+   cout << "  -serial <#>   - runs transactions serially while the abort ratio is above #" << endl;
    cout << "  -inserts <#>  - sets the # of inserts per container per thread" << endl;
    cout << "  -threads <#>  - sets the # of threads" << endl;
+   cout << "  -csv <file>   - writes the CSV rows of the 'latm' bench to file" << endl;
    cout << "  -lookup       - performs individual lookup after inserts" << endl;
    cout << "  -remove       - performs individual remove after inserts/lookup" << endl;
 }
@@ -114,10 +147,33 @@ void setupEnvironment(int argc, char **argv)
    {
       std::string first = argv[i];
 
-      if (first == "-def") transaction::do_deferred_updating();
-      else if (first == "-dir") transaction::do_direct_updating();
+      if (first == "-def")
+      {
+         transaction::do_deferred_updating();
+         updateMethod = "deferred";
+      }
+      else if (first == "-dir")
+      {
+         transaction::do_direct_updating();
+         updateMethod = "direct";
+      }
       else if (first == "-lookup") kDoLookup = true;
       else if (first == "-remove") kDoRemoval = true;
+      else if (first == "-trace") transaction::enable_tracing();
+      else if (first == "-sites") transaction::enable_site_profiling();
+      else if (first == "-conflicts") transaction::enable_conflict_profiling();
+      else if (first == "-serial")
+      {
+         transaction::enable_serial_fallback(atof(argv[++i]));
+      }
+      else if (first == "-retries")
+      {
+         transaction::set_default_retry_budget(atoi(argv[++i]));
+      }
+      else if (first == "-schedule")
+      {
+         transaction::enable_scheduling(atof(argv[++i]));
+      }
       else if (first == "-inserts")
       {
          kMaxInserts = atoi(argv[++i]);
@@ -140,6 +196,7 @@ void setupEnvironment(int argc, char **argv)
          kMaxArrIter = atoi(argv[++i]);
       }
       else if (first == "-bench") bench = argv[++i];
+      else if (first == "-csv") csvFile = argv[++i];
       else if (first == "-cm")
       {
          std::string cmType = argv[++i];
@@ -148,6 +205,15 @@ void setupEnvironment(int argc, char **argv)
          else if (cmType == "iFair") currentCm = iFair;
          else if (cmType == "threadFair") currentCm = threadFair;
          else if (cmType == "iBalanced") currentCm = iBalanced;
+         else if (cmType == "aggressive") transaction::contention_manager(new AggressiveCM);
+         else if (cmType == "passive") transaction::contention_manager(new PassiveCM);
+         else if (cmType == "karma") transaction::contention_manager(new KarmaCM);
+         else if (cmType == "polka") transaction::contention_manager(new PolkaCM);
+         else if (cmType == "timestamp") transaction::contention_manager(new TimestampCM);
+         else if (cmType == "greedy") transaction::contention_manager(new GreedyCM);
+         else if (cmType == "serializing") transaction::contention_manager(new SerializingCM);
+         else if (cmType == "adaptive") transaction::contention_manager(new AdaptiveCM);
+         else if (cmType == "backoff") transaction::contention_manager(new ExceptAndBackOffOnAbortNoticeCM(5, 2, 10));
          else 
          {
             cout << "invalid CM, exiting: " << endl;
@@ -169,6 +235,7 @@ void setupEnvironment(int argc, char **argv)
             cout << first << latmType << endl;
             exit(0);
          }
+         latmProtection = latmType;
 #endif
       }
       else
@@ -188,7 +255,7 @@ int main(int argc, char **argv)
 
    setupEnvironment(argc, argv);
 
-   cout << "Current CM: " << currentCm << "\t";
+   cout << "Current CM: " << transaction::get_contention_manager()->name() << "\t";
 
    for (int i = 0; i < kMaxIterations; ++i)
    {
@@ -206,6 +273,16 @@ int main(int argc, char **argv)
       else if ("accounts" == bench) testAccounts();
       else if ("embedded" == bench) testEmbedded();
       else if ("delete" == bench) testBufferedDelete();
+      else if ("handle" == bench) testTxHandle();
+      else if ("pool" == bench) testMemoryPool();
+      else if ("latm" == bench) testLatmBench();
+      else if ("cm" == bench) testContentionManager();
+      else if ("retry" == bench) testRetryBudget();
+      else if ("serial" == bench) testSerialFallback();
+      else if ("trylock" == bench) testTrylock();
+      else if ("rwlock" == bench) testRwLock();
+      else if ("objlock" == bench) testObjectLock();
+      else if ("elision" == bench) testElidedLock();
 #if 0
       else if ("linkedlist_w_locks" == bench) TestLinkedListWithLocks();
       else if ("hashmap_w_locks" == bench) TestHashMapWithLocks();
@@ -222,6 +299,9 @@ int main(int argc, char **argv)
       else { usage(); return 0; }
    }
 
+   if (transaction::site_profiling()) transaction::output_site_profile(cout);
+   if (transaction::conflict_profiling()) transaction::output_conflict_profile(cout);
+
    return 0;
 }
 
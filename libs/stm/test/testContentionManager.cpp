@@ -0,0 +1,343 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <boost/stm.hpp>
+#include <boost/stm/contention_manager.hpp>
+#include <atomic>
+#include <string>
+#include "testContentionManager.h"
+#include "main.h"
+
+using namespace boost::stm;
+using namespace nMain;
+
+static int failures = 0;
+
+static native_trans<int> counter;
+static SerializingCM *serializing = NULL;
+static std::atomic<int> exclusiveBodies;
+static std::atomic<int> overlaps;
+static std::atomic<bool> scheduledRetryDone;
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void check(bool ok, char const *what)
+{
+   if (ok) return;
+
+   std::cout << "failed: " << what << std::endl;
+   ++failures;
+}
+
+static bool policy_is(AdaptiveCM const &cm, char const *name)
+{
+   return std::string(name) == cm.current().name();
+}
+
+//-----------------------------------------------------------------------------
+// feeds the same window n times
+//-----------------------------------------------------------------------------
+static void feed(AdaptiveCM &cm, int n, uint64 commits, uint64 aborts,
+   uint64 committedWork, uint64 abortedWork)
+{
+   for (int i = 0; i < n; ++i) cm.add_sample(commits, aborts, committedWork, abortedWork);
+}
+
+//-----------------------------------------------------------------------------
+// the decisions of the adaptive manager, fed windows of known contention.
+// it escalates one policy per kAdaptiveConfirm (3) windows above 0.25, stays
+// put between 0.05 and 0.25 and relaxes one policy per 3 windows below 0.05
+//-----------------------------------------------------------------------------
+static void testAdaptiveDecisions()
+{
+   AdaptiveCM cm;
+   check(policy_is(cm, "aggressive"), "adaptive starts with the aggressive policy");
+
+   //--------------------------------------------------------------------------
+   // half of the attempts abort: escalate only on the third window in a row
+   //--------------------------------------------------------------------------
+   feed(cm, 2, 10, 10, 10, 10);
+   check(policy_is(cm, "aggressive") && 0 == cm.switches(), "adaptive escalates unconfirmed");
+   feed(cm, 1, 10, 10, 10, 10);
+   check(policy_is(cm, "polka") && 1 == cm.switches(), "adaptive escalates to polka");
+   feed(cm, 3, 10, 10, 10, 10);
+   check(policy_is(cm, "greedy") && 2 == cm.switches(), "adaptive escalates to greedy");
+   feed(cm, 3, 10, 10, 10, 10);
+   check(policy_is(cm, "serializing") && 3 == cm.switches(), "adaptive escalates to serializing");
+   feed(cm, 6, 10, 10, 10, 10);
+   check(policy_is(cm, "serializing") && 3 == cm.switches(), "adaptive escalates past the last policy");
+
+   //--------------------------------------------------------------------------
+   // one attempt in ten aborts, between the thresholds: no switch
+   //--------------------------------------------------------------------------
+   feed(cm, 16, 90, 10, 90, 10);
+   check(policy_is(cm, "serializing") && 3 == cm.switches(), "adaptive switches between the thresholds");
+
+   //--------------------------------------------------------------------------
+   // no aborts: once the aborting windows have left the last 8 the manager
+   // relaxes one policy per 3 windows, down to the first one and no further
+   //--------------------------------------------------------------------------
+   feed(cm, 40, 100, 0, 100, 0);
+   check(policy_is(cm, "aggressive") && 6 == cm.switches(), "adaptive relaxes to aggressive");
+
+   //--------------------------------------------------------------------------
+   // few aborts, but they waste most of the work: the wasted work escalates
+   //--------------------------------------------------------------------------
+   AdaptiveCM wasteful;
+   feed(wasteful, 3, 100, 10, 100, 900);
+   check(policy_is(wasteful, "polka"), "adaptive escalates on wasted work");
+
+   std::cout << "ADAPTIVE: " << "SWITCHES: " << cm.switches() << "   ";
+   std::cout << "POLICY: " << cm.current().name() << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// counts the bodies of attempts which should run alone while they overlap
+//-----------------------------------------------------------------------------
+class exclusive_body
+{
+public:
+   explicit exclusive_body(bool exclusive) : exclusive_(exclusive)
+   {
+      if (exclusive_ && 1 != ++exclusiveBodies) ++overlaps;
+   }
+   ~exclusive_body() { if (exclusive_) --exclusiveBodies; }
+
+private:
+   bool exclusive_;
+};
+
+//-----------------------------------------------------------------------------
+// the first attempt of every transaction is forced to abort after its write,
+// so every transaction aborts at least once and then retries holding the
+// token. a token kept past the abort hangs the other threads; two attempts
+// holding it at once show up as overlaps
+//-----------------------------------------------------------------------------
+static void* SerializingEntry(void *threadId)
+{
+   transaction::initialize_thread();
+   int start = *(int*)threadId;
+
+   idleUntilAllThreadsHaveReached(start);
+
+   for (int i = 0; i < kMaxInserts; ++i)
+   {
+      atomic(t)
+      {
+         exclusive_body body(0 != t.consecutive_aborts());
+         ++t.w(counter).value();
+         if (0 == t.consecutive_aborts()) t.force_to_abort();
+      } end_atom
+   }
+
+   finishThread(start);
+
+   if (*(int*)threadId != kMainThreadId)
+   {
+      transaction::terminate_thread();
+      pthread_exit(threadId);
+   }
+
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// with a threshold of 0 a thread is scheduled from its first abort on, its
+// intensity decays but never reaches 0 again
+//-----------------------------------------------------------------------------
+static void* SchedulingEntry(void *threadId)
+{
+   transaction::initialize_thread();
+   int start = *(int*)threadId;
+
+   idleUntilAllThreadsHaveReached(start);
+
+   for (int i = 0; i < kMaxInserts; ++i)
+   {
+      atomic(t)
+      {
+         exclusive_body body(t.contention_intensity() > transaction::schedule_threshold());
+         ++t.w(counter).value();
+         if (0 == t.consecutive_aborts()) t.force_to_abort();
+      } end_atom
+   }
+
+   finishThread(start);
+
+   if (*(int*)threadId != kMainThreadId)
+   {
+      transaction::terminate_thread();
+      pthread_exit(threadId);
+   }
+
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// aborts once, so its retry is scheduled and needs the scheduler token
+//-----------------------------------------------------------------------------
+static void* ScheduledRetryEntry(void *)
+{
+   transaction::initialize_thread();
+
+   atomic(t)
+   {
+      ++t.w(counter).value();
+      if (0 == t.consecutive_aborts()) t.force_to_abort();
+   } end_atom
+
+   scheduledRetryDone = true;
+   transaction::terminate_thread();
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// a retry which aborts and is then given up must leave the token free; the
+// retries of the threaded runs all commit in the end, which frees it anyway
+//-----------------------------------------------------------------------------
+static void abandonRetry()
+{
+   transaction t;
+   t.force_to_abort();
+   t.no_throw_end();
+
+   t.restart();
+   if (0 != serializing)
+   {
+      check(&t == serializing->owner(), "serializing retry runs without the token");
+   }
+
+   t.force_to_abort();
+   t.no_throw_end();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void runThreads(void* (*entry)(void*))
+{
+   counter.value() = 0;
+   exclusiveBodies = 0;
+   overlaps = 0;
+
+   pthread_t *threads = new pthread_t[kMaxThreads];
+   int *threadId = new int[kMaxThreads];
+
+   //--------------------------------------------------------------------------
+   // Reset barrier variables before creating any threads. Otherwise, it is
+   // possible for the first thread
+   //--------------------------------------------------------------------------
+   threadsFinished.value() = 0;
+   threadsStarted.value() = 0;
+   startTimer = kStartingTime;
+   endTimer = 0;
+
+   for (int j = 0; j < kMaxThreads - 1; ++j)
+   {
+      threadId[j] = j;
+      pthread_create(&threads[j], NULL, entry, (void *)&threadId[j]);
+   }
+
+   int mainThreadId = kMaxThreads-1;
+   kMainThreadId = kMaxThreads-1;
+
+   entry((void*)&mainThreadId);
+
+   for (int j = 0; j < kMaxThreads - 1; ++j) pthread_join(threads[j], NULL);
+
+   delete [] threads;
+   delete [] threadId;
+}
+
+//-----------------------------------------------------------------------------
+// the serializing token and the scheduler token are both handed back when the
+// attempt holding them aborts
+//-----------------------------------------------------------------------------
+static void testTokenHandBack()
+{
+   int const expected = kMaxThreads * kMaxInserts;
+
+   serializing = new SerializingCM;
+   transaction::contention_manager(serializing);
+
+   runThreads(SerializingEntry);
+
+   check(expected == counter.value(), "serializing loses updates");
+   check(0 == overlaps, "serializing retries overlap");
+   check(0 == serializing->owner(), "serializing token kept after the run");
+
+   abandonRetry();
+   check(0 == serializing->owner(), "serializing token kept after an abort");
+
+   std::cout << "SERIALIZING: " << "THRD: " << kMaxThreads << "   ";
+   std::cout << "VALUE: " << counter.value() << "   ";
+   std::cout << "OVERLAPS: " << overlaps << std::endl;
+
+   transaction::contention_manager(new ExceptAndBackOffOnAbortNoticeCM(0, 0, 0));
+   serializing = NULL;
+
+   uint64 const scheduledBefore = transaction::bookkeeping().scheduled();
+   transaction::enable_scheduling(0.0);
+
+   runThreads(SchedulingEntry);
+
+   //--------------------------------------------------------------------------
+   // another thread's scheduled retry waits for the token forever if the
+   // abandoned retry of this thread kept it
+   //--------------------------------------------------------------------------
+   abandonRetry();
+
+   scheduledRetryDone = false;
+   pthread_t retrier;
+   pthread_create(&retrier, NULL, ScheduledRetryEntry, NULL);
+
+   for (int i = 0; i < 500 && !scheduledRetryDone; ++i) SLEEP(10);
+   check(scheduledRetryDone, "scheduler token kept after an abort");
+   if (scheduledRetryDone) pthread_join(retrier, NULL);
+   else pthread_detach(retrier);
+
+   transaction::disable_scheduling();
+   uint64 const scheduled = transaction::bookkeeping().scheduled() - scheduledBefore;
+
+   check(expected + 1 == counter.value() || !scheduledRetryDone, "scheduling loses updates");
+   check(0 == overlaps, "scheduled attempts overlap");
+   check(0 != scheduled, "scheduling never scheduled an attempt");
+
+   std::cout << "SCHEDULING: " << "THRD: " << kMaxThreads << "   ";
+   std::cout << "VALUE: " << counter.value() << "   ";
+   std::cout << "SCHEDULED: " << scheduled << "   ";
+   std::cout << "OVERLAPS: " << overlaps << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int testContentionManager()
+{
+   transaction::initialize();
+   transaction::initialize_thread();
+
+   failures = 0;
+
+   testAdaptiveDecisions();
+   testTokenHandBack();
+
+   if (0 != failures)
+   {
+      std::cout << failures << " contention manager checks failed!" << std::endl;
+   }
+   else
+   {
+      std::cout << "All fine." << std::endl;
+   }
+
+   return 0;
+}
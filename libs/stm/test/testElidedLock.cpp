@@ -0,0 +1,304 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <boost/stm.hpp>
+#include <atomic>
+#include <thread>
+#include "testElidedLock.h"
+#include "main.h"
+
+using namespace boost::stm;
+using namespace nMain;
+
+static int failures = 0;
+
+static Mutex L = PTHREAD_MUTEX_INITIALIZER;
+
+static native_trans<int> counter;
+
+static size_t const kElisionRetries = 2;
+static int const kLockerLocks = 20;
+
+static std::atomic<bool> lockerDone;
+static std::atomic<int> commits;
+static std::atomic<int> fallbacks;
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void check(bool ok, char const *what)
+{
+   if (ok) return;
+
+   std::cout << "failed: DSTM_" << transaction::update_policy_string() << " "
+      << transaction::latm_protection_str() << ": " << what << std::endl;
+   ++failures;
+}
+
+//-----------------------------------------------------------------------------
+// true if nobody holds L, pthread_mutex_trylock fails on a held mutex even
+// in the thread holding it
+//-----------------------------------------------------------------------------
+static bool lock_is_free()
+{
+   if (0 != pthread_mutex_trylock(&L)) return false;
+   pthread_mutex_unlock(&L);
+   return true;
+}
+
+//-----------------------------------------------------------------------------
+// an uncontended section commits on its first attempt without the lock
+//-----------------------------------------------------------------------------
+static void testElidedCommit()
+{
+   int const before = counter.value();
+   int attempts = 0;
+   bool heldInside = true;
+
+   use_elided_lock(t, L)
+   {
+      ++attempts;
+      heldInside = !lock_is_free();
+      ++t.w(counter).value();
+   } end_elided_lock
+
+   check(1 == attempts, "elided section retried");
+   check(!heldInside, "elided section took the lock");
+   check(before + 1 == counter.value(), "elided section lost its update");
+   check(lock_is_free(), "lock kept after the elided section");
+}
+
+//-----------------------------------------------------------------------------
+// a section forced to abort is elided lock_elision_retries() times, then its
+// attempt takes the lock inside the transaction and commits
+//-----------------------------------------------------------------------------
+static void testFallBack(size_t retries)
+{
+   transaction::set_lock_elision_retries(retries);
+
+   int const before = counter.value();
+   size_t attempts = 0, elided = 0, locked = 0;
+
+   use_elided_lock(t, L)
+   {
+      ++attempts;
+      if (lock_is_free()) ++elided;
+      else ++locked;
+
+      ++t.w(counter).value();
+      if (t.consecutive_aborts() < retries) t.force_to_abort();
+   } end_elided_lock
+
+   check(retries + 1 == attempts, "fall-back after the wrong number of attempts");
+   check(retries == elided, "elided attempts took the lock");
+   check(1 == locked, "last attempt did not take the lock");
+   check(before + 1 == counter.value(), "fallen back section lost its update");
+   check(lock_is_free(), "lock kept after the fallen back section");
+}
+
+//-----------------------------------------------------------------------------
+// an attempt which took the lock and aborts hands it back, its retry must
+// take it again rather than find it still recorded as its own
+//-----------------------------------------------------------------------------
+static void testAbortedFallBack()
+{
+   transaction::set_lock_elision_retries(0);
+
+   int const before = counter.value();
+   int attempts = 0, locked = 0;
+
+   use_elided_lock(t, L)
+   {
+      ++attempts;
+      if (!lock_is_free()) ++locked;
+
+      ++t.w(counter).value();
+      if (1 == attempts) t.lock_and_abort();
+   } end_elided_lock
+
+   check(2 == attempts && 2 == locked, "retry of an aborted locked attempt runs without the lock");
+   check(before + 1 == counter.value(), "aborted locked attempt lost its retry's update");
+   check(lock_is_free(), "lock kept after an aborted locked attempt");
+}
+
+//-----------------------------------------------------------------------------
+// the other threads run elided sections, every eighth of them forced to fall
+// back to the lock, for as long as the main thread increments the counter
+// under the real lock. a section a locker overlooks loses updates
+//-----------------------------------------------------------------------------
+static void* ElidedLockEntry(void *threadId)
+{
+   transaction::initialize_thread();
+   int start = *(int*)threadId;
+
+   idleUntilAllThreadsHaveReached(start);
+
+   if (*(int*)threadId == kMainThreadId)
+   {
+      for (int i = 0; i < kLockerLocks; ++i)
+      {
+         transaction::pthread_lock(&L);
+         int const value = counter.value();
+         SLEEP(1);
+         counter.value() = value + 1;
+         transaction::pthread_unlock(&L);
+         SLEEP(1);
+      }
+
+      lockerDone = true;
+   }
+   else
+   {
+      for (int i = 0; i < kMaxInserts || !lockerDone; ++i)
+      {
+         bool fellBack = false;
+
+         use_elided_lock(t, L)
+         {
+            if (t.consecutive_aborts() >= kElisionRetries) fellBack = true;
+
+            ++t.w(counter).value();
+            std::this_thread::yield();
+
+            if (0 == i % 8 && t.consecutive_aborts() < kElisionRetries) t.force_to_abort();
+         } end_elided_lock
+
+         ++commits;
+         if (fellBack) ++fallbacks;
+      }
+   }
+
+   finishThread(start);
+
+   if (*(int*)threadId != kMainThreadId)
+   {
+      transaction::terminate_thread();
+      pthread_exit(threadId);
+   }
+
+   return NULL;
+}
+
+static void testBesideLocker()
+{
+   transaction::set_lock_elision_retries(kElisionRetries);
+
+   counter.value() = 0;
+   lockerDone = false;
+   commits = 0;
+   fallbacks = 0;
+
+   pthread_t *threads = new pthread_t[kMaxThreads];
+   int *threadId = new int[kMaxThreads];
+
+   //--------------------------------------------------------------------------
+   // Reset barrier variables before creating any threads. Otherwise, it is
+   // possible for the first thread
+   //--------------------------------------------------------------------------
+   threadsFinished.value() = 0;
+   threadsStarted.value() = 0;
+   startTimer = kStartingTime;
+   endTimer = 0;
+
+   for (int j = 0; j < kMaxThreads - 1; ++j)
+   {
+      threadId[j] = j;
+      pthread_create(&threads[j], NULL, ElidedLockEntry, (void *)&threadId[j]);
+   }
+
+   int mainThreadId = kMaxThreads-1;
+   kMainThreadId = kMaxThreads-1;
+
+   ElidedLockEntry((void*)&mainThreadId);
+
+   for (int j = 0; j < kMaxThreads - 1; ++j) pthread_join(threads[j], NULL);
+
+   check(commits + kLockerLocks == counter.value(), "sections and locker lose updates");
+   check(kMaxThreads < 2 || 0 != fallbacks, "no section fell back to the lock");
+   check(lock_is_free(), "lock kept after the threaded run");
+
+   delete [] threads;
+   delete [] threadId;
+}
+
+//-----------------------------------------------------------------------------
+// every update policy with every protection mode, whatever the command line
+// chose is restored afterwards
+//-----------------------------------------------------------------------------
+int testElidedLock()
+{
+   transaction::initialize();
+   transaction::initialize_thread();
+
+   failures = 0;
+
+   bool const direct = transaction::direct_updating();
+   LatmType const latm = transaction::latm_protection();
+   size_t const retries = transaction::lock_elision_retries();
+
+   for (int policy = 0; policy < 2; ++policy)
+   {
+      if (0 == policy) transaction::do_deferred_updating();
+      else transaction::do_direct_updating();
+
+      for (int mode = kMinLatmType; mode < kMaxLatmType; ++mode)
+      {
+         switch (mode)
+         {
+         case eFullLatmProtection: transaction::do_full_lock_protection(); break;
+         case eTmConflictingLockLatmProtection:
+            transaction::do_tm_lock_protection();
+            transaction::tm_lock_conflict(&L);
+            break;
+         default: transaction::do_tx_lock_protection(); break;
+         }
+
+         testElidedCommit();
+         testFallBack(kElisionRetries);
+         testFallBack(0);
+         testAbortedFallBack();
+         testBesideLocker();
+
+         transaction::clear_tm_conflicting_locks();
+
+         std::cout << "ELISION: DSTM_" << transaction::update_policy_string() << "   ";
+         std::cout << "LATM: " << transaction::latm_protection_str() << "   ";
+         std::cout << "THRD: " << kMaxThreads << "   ";
+         std::cout << "VALUE: " << counter.value() << "   ";
+         std::cout << "FELL BACK: " << fallbacks << "   ";
+         std::cout << "FAILED: " << failures << std::endl;
+      }
+   }
+
+   transaction::set_lock_elision_retries(retries);
+
+   if (direct) transaction::do_direct_updating();
+   else transaction::do_deferred_updating();
+
+   switch (latm)
+   {
+   case eFullLatmProtection: transaction::do_full_lock_protection(); break;
+   case eTmConflictingLockLatmProtection: transaction::do_tm_lock_protection(); break;
+   default: transaction::do_tx_lock_protection(); break;
+   }
+
+   if (0 != failures)
+   {
+      std::cout << failures << " elided lock checks failed!" << std::endl;
+   }
+   else
+   {
+      std::cout << "All fine." << std::endl;
+   }
+
+   return 0;
+}
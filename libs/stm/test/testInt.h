@@ -29,8 +29,12 @@ public:
    //--------------------------------------------------
    // move semantics
    //--------------------------------------------------
+   Integer(Integer const &rhs) : value_(rhs.value_) {}
+   Integer& operator=(Integer const &rhs)
+   { value_ = rhs.value_; return *this; }
+
    Integer(Integer &&rhs) { value_ = rhs.value_;}
-   Integer& operator=(Integer &&rhs)
+   Integer& operator=(Integer &&rhs) noexcept
    { value_ = rhs.value_; return *this; }
 #endif
 
@@ -0,0 +1,427 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009. 
+// (C) Copyright Vicente J. Botet Escriba 2009. 
+// Distributed under the Boost
+// Software License, Version 1.0. 
+// (See accompanying file LICENSE_1_0.txt or 
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <boost/stm.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include "testLatmBench.h"
+#include "main.h"
+
+using namespace boost::stm;
+using namespace nMain;
+
+//-----------------------------------------------------------------------------
+// the LATM contention sweep. every thread does kMaxInserts operations, each
+// either a critical section of the lock or a transaction. the sections and
+// the transactions which touch the data the lock protects move one unit
+// between the two protected slots, the other transactions bump a slot of
+// their own thread, so they only conflict with the lock through LATM. one
+// CSV row is written per cell of
+//
+//    LATM protection x update policy x lock kind x threads x hold time
+//                    x lock frequency x fraction of transactions touching
+//                      protected data
+//
+// the lock kinds:
+//    lock    - latmLock is locked
+//    trylock - latmLock is tried until it is taken
+//    elided  - the section runs as an elided lock of latmLock
+//    rwlock  - latmRwLock is taken exclusive, or shared by every other
+//              section, which then only checks that the slots add up
+//    object  - latmLock is locked with the protected slots bound to it, so
+//              only the transactions touching them conflict with it (tx
+//              protection only)
+//
+// -latm, -def and -dir restrict the sweep to the given protection or policy,
+// -threads is the most threads swept and -csv <file> writes the rows to the
+// file rather than to cout.
+//-----------------------------------------------------------------------------
+static int const kHoldTimesUs[] = { 0, 10, 100 };
+static double const kLockFrequencies[] = { 0.01, 0.1, 0.5 };
+static double const kProtectedFractions[] = { 0.0, 0.5, 1.0 };
+
+static char const * const kLatmModes[] = { "full", "tm", "tx" };
+static char const * const kUpdateModes[] = { "deferred", "direct" };
+
+enum { kBenchLock, kBenchTrylock, kBenchElided, kBenchRwLock, kBenchObject };
+static char const * const kLockKinds[] = { "lock", "trylock", "elided", "rwlock", "object" };
+
+static int const kMaxBenchThreads = 128;
+
+#ifndef BOOST_STM_USE_BOOST_MUTEX
+static Mutex latmLock = PTHREAD_MUTEX_INITIALIZER;
+#else
+static Mutex latmLock;
+#endif
+
+static RwMutex latmRwLock = PTHREAD_RWLOCK_INITIALIZER;
+
+static native_trans<int> protectedData[2];
+static native_trans<int> freeData[kMaxBenchThreads];
+
+//-----------------------------------------------------------------------------
+// one cell of the sweep and what each of its threads measured
+//-----------------------------------------------------------------------------
+struct latm_bench_cell
+{
+   int lockKind;
+   int threads;
+   int holdUs;
+   double lockFrequency;
+   double protectedFraction;
+};
+
+struct latm_bench_thread
+{
+   int id;
+   latm_bench_cell const *cell;
+
+   int lockSections;
+   int sharedSections;
+   int badReads;
+   int protectedTxs;
+   int freeTxs;
+   std::vector<uint64> lockWaits;
+};
+
+static std::atomic<int> threadsReady(0);
+static std::atomic<bool> go(false);
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void holdFor(int us)
+{
+   if (0 == us) return;
+
+   uint64 const until = trace_now() + uint64(us) * 1000;
+   while (trace_now() < until) {}
+}
+
+//-----------------------------------------------------------------------------
+// the lock the transactions touching the protected slots conflict with
+//-----------------------------------------------------------------------------
+static void conflict_with_lock(transaction &t, latm_bench_cell const &cell)
+{
+   if (!transaction::doing_tx_lock_protection()) return;
+
+   if (kBenchRwLock == cell.lockKind) t.lock_conflict(&latmRwLock);
+   else t.lock_conflict(&latmLock);
+}
+
+//-----------------------------------------------------------------------------
+// one critical section of the cell's lock kind. the wait recorded is the
+// time until the section got the lock, for an elided section the time until
+// the attempt which committed began
+//-----------------------------------------------------------------------------
+static void lockSection(latm_bench_thread &me, bool shared)
+{
+   latm_bench_cell const &cell = *me.cell;
+   uint64 const start = trace_now();
+
+   switch (cell.lockKind)
+   {
+   case kBenchTrylock:
+      while (0 != transaction::trylock_(&latmLock)) std::this_thread::yield();
+      break;
+   case kBenchElided:
+   {
+      uint64 entered = start;
+
+      use_elided_lock(t, latmLock)
+      {
+         entered = trace_now();
+         ++t.w(protectedData[0]).value();
+         --t.w(protectedData[1]).value();
+         holdFor(cell.holdUs);
+      } end_elided_lock
+
+      me.lockWaits.push_back(entered - start);
+      ++me.lockSections;
+      return;
+   }
+   case kBenchRwLock:
+      if (shared) transaction::pthread_rdlock(&latmRwLock);
+      else transaction::pthread_wrlock(&latmRwLock);
+      break;
+   default:
+      transaction::lock_(&latmLock);
+      break;
+   }
+
+   me.lockWaits.push_back(trace_now() - start);
+
+   if (shared)
+   {
+      if (0 != protectedData[0].value() + protectedData[1].value()) ++me.badReads;
+      holdFor(cell.holdUs);
+
+      transaction::pthread_rwunlock(&latmRwLock);
+      ++me.sharedSections;
+      return;
+   }
+
+   ++protectedData[0].value();
+   --protectedData[1].value();
+   holdFor(cell.holdUs);
+
+   if (kBenchRwLock == cell.lockKind) transaction::pthread_rwunlock(&latmRwLock);
+   else transaction::unlock_(&latmLock);
+   ++me.lockSections;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void* LatmBenchEntry(void *arg)
+{
+   latm_bench_thread &me = *(latm_bench_thread*)arg;
+   latm_bench_cell const &cell = *me.cell;
+
+   transaction::initialize_thread();
+
+   unsigned int seed = me.id + 1;
+
+   ++threadsReady;
+   while (!go) SLEEP(1);
+
+   for (int i = 0; i < kMaxInserts; ++i)
+   {
+      double const roll = double(rand_r(&seed)) / RAND_MAX;
+
+      if (roll < cell.lockFrequency)
+      {
+         lockSection(me, kBenchRwLock == cell.lockKind && 0 != (rand_r(&seed) & 1));
+      }
+      else if (double(rand_r(&seed)) / RAND_MAX < cell.protectedFraction)
+      {
+         atomic(t)
+         {
+            conflict_with_lock(t, cell);
+
+            ++t.w(protectedData[0]).value();
+            --t.w(protectedData[1]).value();
+         } end_atom
+         ++me.protectedTxs;
+      }
+      else
+      {
+         atomic(t)
+         {
+            // the lock does not stop them, the objects bound to it are others
+            if (kBenchObject == cell.lockKind) t.lock_conflict(&latmLock);
+
+            ++t.w(freeData[me.id]).value();
+         } end_atom
+         ++me.freeTxs;
+      }
+   }
+
+   transaction::terminate_thread();
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// the smallest sample at least the fraction p of the samples are not above
+//-----------------------------------------------------------------------------
+static uint64 percentile(std::vector<uint64> const &sorted, double p)
+{
+   if (sorted.empty()) return 0;
+
+   size_t rank = size_t(p * sorted.size() + 0.5);
+   if (rank < 1) rank = 1;
+   if (rank > sorted.size()) rank = sorted.size();
+
+   return sorted[rank - 1];
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void runLatmBenchCell(std::ostream &out, latm_bench_cell const &cell,
+   char const *latmMode, char const *updateMode)
+{
+   protectedData[0].value() = 0;
+   protectedData[1].value() = 0;
+   for (int i = 0; i < cell.threads; ++i) freeData[i].value() = 0;
+
+   std::vector<latm_bench_thread> threads(cell.threads);
+   std::vector<pthread_t> handles(cell.threads);
+
+   bookkeeping_snapshot const before = transaction::bookkeeping().aggregate();
+
+   threadsReady = 0;
+   go = false;
+
+   for (int i = 0; i < cell.threads; ++i)
+   {
+      threads[i].id = i;
+      threads[i].cell = &cell;
+      threads[i].lockSections = threads[i].sharedSections = threads[i].badReads = 0;
+      threads[i].protectedTxs = threads[i].freeTxs = 0;
+      pthread_create(&handles[i], NULL, LatmBenchEntry, (void *)&threads[i]);
+   }
+
+   while (threadsReady != cell.threads) SLEEP(1);
+
+   uint64 const start = trace_now();
+   go = true;
+
+   for (int i = 0; i < cell.threads; ++i) pthread_join(handles[i], NULL);
+
+   double const seconds = double(trace_now() - start) / 1e9;
+
+   bookkeeping_snapshot const after = transaction::bookkeeping().aggregate();
+
+   //--------------------------------------------------------------------------
+   // the protected slots must have moved once per exclusive lock section and
+   // protected tx, the free slots once per free tx. the shared sections must
+   // have found the protected slots adding up
+   //--------------------------------------------------------------------------
+   std::vector<uint64> lockWaits;
+   int lockSections = 0, protectedTxs = 0;
+   bool ok = true;
+
+   for (int i = 0; i < cell.threads; ++i)
+   {
+      lockSections += threads[i].lockSections;
+      protectedTxs += threads[i].protectedTxs;
+      if (freeData[i].value() != threads[i].freeTxs || 0 != threads[i].badReads) ok = false;
+      lockWaits.insert(lockWaits.end(), threads[i].lockWaits.begin(), threads[i].lockWaits.end());
+   }
+
+   if (protectedData[0].value() != lockSections + protectedTxs ||
+      protectedData[0].value() + protectedData[1].value() != 0) ok = false;
+
+   std::sort(lockWaits.begin(), lockWaits.end());
+
+   uint64 lockWaitTotal = 0;
+   for (size_t i = 0; i < lockWaits.size(); ++i) lockWaitTotal += lockWaits[i];
+
+   uint64 const ops = uint64(cell.threads) * kMaxInserts;
+   uint64 const commits = after.commits() - before.commits();
+   uint64 const aborts = after.totalAborts() - before.totalAborts();
+   uint64 const blocks = after.latmWaits() - before.latmWaits();
+   uint64 const blockTotal = after.latmWaitNs() - before.latmWaitNs();
+
+   out << latmMode << ","
+       << updateMode << ","
+       << kLockKinds[cell.lockKind] << ","
+       << cell.threads << ","
+       << cell.holdUs << ","
+       << cell.lockFrequency << ","
+       << cell.protectedFraction << ","
+       << ops << ","
+       << seconds << ","
+       << (seconds > 0 ? ops / seconds : 0) << ","
+       << commits << ","
+       << aborts << ","
+       << (0 == commits + aborts ? 0.0 : double(aborts) / double(commits + aborts)) << ","
+       << lockWaits.size() << ","
+       << (lockWaits.empty() ? 0 : lockWaitTotal / lockWaits.size()) << ","
+       << percentile(lockWaits, 0.5) << ","
+       << percentile(lockWaits, 0.99) << ","
+       << blocks << ","
+       << (0 == blocks ? 0 : blockTotal / blocks) << ","
+       << (ok ? "ok" : "BAD") << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int testLatmBench()
+{
+#if PERFORMING_LATM
+   transaction::initialize();
+   transaction::initialize_thread();
+
+   int const maxThreads = std::min(kMaxThreads, kMaxBenchThreads);
+
+   std::ofstream file;
+   if (!csvFile.empty()) file.open(csvFile.c_str());
+   std::ostream &out = csvFile.empty() ? std::cout : file;
+
+   if (csvFile.empty()) out << std::endl;
+
+   out << "latm,update,lock,threads,hold_us,lock_freq,tx_protected,ops,seconds,ops_per_sec,"
+       << "commits,aborts,abort_rate,lock_waits,lock_wait_mean_ns,lock_wait_p50_ns,"
+       << "lock_wait_p99_ns,tx_blocks,tx_block_mean_ns,check" << std::endl;
+
+   for (size_t m = 0; m < sizeof(kLatmModes) / sizeof(kLatmModes[0]); ++m)
+   {
+      if (!latmProtection.empty() && latmProtection != kLatmModes[m]) continue;
+
+      if (0 == m) transaction::do_full_lock_protection();
+      else if (1 == m) transaction::do_tm_lock_protection();
+      else transaction::do_tx_lock_protection();
+
+      // only tm lock protection looks at the tm conflicting locks
+      transaction::clear_tm_conflicting_locks();
+      if (transaction::doing_tm_lock_protection())
+      {
+         transaction::tm_lock_conflict(&latmLock);
+         transaction::tm_lock_conflict(&latmRwLock);
+      }
+
+      for (size_t u = 0; u < sizeof(kUpdateModes) / sizeof(kUpdateModes[0]); ++u)
+      {
+         if (!updateMethod.empty() && updateMethod != kUpdateModes[u]) continue;
+
+         if (0 == u) transaction::do_deferred_updating();
+         else transaction::do_direct_updating();
+
+         for (int k = kBenchLock; k <= kBenchObject; ++k)
+         {
+            // objects are only bound to locks under tx protection
+            if (kBenchObject == k)
+            {
+               if (!transaction::doing_tx_lock_protection()) continue;
+
+               transaction::add_lock_protected_object(&latmLock, protectedData[0]);
+               transaction::add_lock_protected_object(&latmLock, protectedData[1]);
+            }
+
+            for (int threads = 1; threads <= maxThreads;
+               threads = (threads < maxThreads && threads * 2 > maxThreads) ? maxThreads : threads * 2)
+            {
+               for (size_t h = 0; h < sizeof(kHoldTimesUs) / sizeof(kHoldTimesUs[0]); ++h)
+               {
+                  for (size_t f = 0; f < sizeof(kLockFrequencies) / sizeof(kLockFrequencies[0]); ++f)
+                  {
+                     for (size_t p = 0; p < sizeof(kProtectedFractions) / sizeof(kProtectedFractions[0]); ++p)
+                     {
+                        latm_bench_cell cell;
+                        cell.lockKind = k;
+                        cell.threads = threads;
+                        cell.holdUs = kHoldTimesUs[h];
+                        cell.lockFrequency = kLockFrequencies[f];
+                        cell.protectedFraction = kProtectedFractions[p];
+
+                        runLatmBenchCell(out, cell, kLatmModes[m], kUpdateModes[u]);
+                     }
+                  }
+               }
+            }
+
+            if (kBenchObject == k) transaction::clear_lock_protected_objects(&latmLock);
+         }
+      }
+   }
+
+   transaction::clear_tm_conflicting_locks();
+#else
+   std::cout << "the LATM bench needs PERFORMING_LATM" << std::endl;
+#endif
+
+   return 0;
+}
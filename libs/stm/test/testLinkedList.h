@@ -59,12 +59,15 @@ public:
       return *this;
    }
 
-   list_node(list_node &&rhs) : next_(rhs.next_), value_(boost::stm::draco_move(rhs.value_))
+   list_node(list_node const &rhs) : value_(rhs.value_), next_(rhs.next_) {}
+
+   list_node(list_node &&rhs) : value_(std::move(rhs.value_)), next_(rhs.next_)
    { rhs.next_ = 0; }
 
    list_node& operator=(list_node&& rhs)
+      noexcept(std::is_nothrow_move_assignable<T>::value)
    {
-      value_ = boost::stm::draco_move(rhs.value_);
+      value_ = std::move(rhs.value_);
       std::swap(next_, rhs.next_);
       return *this;
    }
@@ -0,0 +1,207 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <boost/stm.hpp>
+#include <vector>
+#include "testMemoryPool.h"
+#include "main.h"
+
+using namespace boost::stm;
+using namespace nMain;
+
+//-----------------------------------------------------------------------------
+// each thread takes chunks of every size class (and some too large to be
+// cached), stamps every byte of each with its own id, checks the stamps once
+// it holds them all and then frees half of them and hands the other half to
+// the next thread to free. a chunk handed out twice, or a free list linked
+// through live memory, shows up as a wrong stamp. the small magazines make
+// the threads refill from and flush to the central lists all the time, and
+// the worker threads exiting give their magazines back
+//-----------------------------------------------------------------------------
+static size_t const kPoolMagazineSize = 4;
+static size_t const kPoolSizes[] = { 1, 8, 16, 17, 48, 100, 512, 1024, 1025, 4000 };
+static size_t const kPoolSizeCount = sizeof(kPoolSizes) / sizeof(kPoolSizes[0]);
+static int const kPoolChunksPerSize = 32;
+
+struct pool_chunk
+{
+   pool_chunk() : mem_(0), size_(0) {}
+   pool_chunk(void *mem, size_t size) : mem_(mem), size_(size) {}
+
+   void *mem_;
+   size_t size_;
+};
+
+typedef std::vector<pool_chunk> PoolChunks;
+
+static CachingMemoryPool<int> *pool = NULL;
+static PoolChunks *handedOff = NULL;
+static Mutex *handedOffMutex = NULL;
+static int *badStamps = NULL;
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static bool stamped(pool_chunk const &c, unsigned char stamp)
+{
+   unsigned char const *p = static_cast<unsigned char const*>(c.mem_);
+   for (size_t i = 0; i < c.size_; ++i) if (p[i] != stamp) return false;
+   return true;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void* MemoryPoolEntry(void *threadId)
+{
+   int start = *(int*)threadId;
+   unsigned char const stamp = (unsigned char)(start + 1);
+
+   idleUntilAllThreadsHaveReached(start);
+
+   for (int i = 0; i < kMaxInserts; ++i)
+   {
+      PoolChunks mine;
+
+      for (size_t s = 0; s < kPoolSizeCount; ++s)
+      {
+         for (int j = 0; j < kPoolChunksPerSize; ++j)
+         {
+            pool_chunk c(pool->retrieveChunk(kPoolSizes[s]), kPoolSizes[s]);
+            memset(c.mem_, stamp, c.size_);
+            mine.push_back(c);
+         }
+      }
+
+      int bad = 0;
+      for (size_t j = 0; j < mine.size(); ++j) if (!stamped(mine[j], stamp)) ++bad;
+
+      //-----------------------------------------------------------------------
+      // free the chunks handed off to this thread, then hand off every
+      // second one of its own to the next thread
+      //-----------------------------------------------------------------------
+      PoolChunks theirs;
+      lock(&handedOffMutex[start]);
+      theirs.swap(handedOff[start]);
+      unlock(&handedOffMutex[start]);
+
+      for (size_t j = 0; j < theirs.size(); ++j)
+      {
+         pool->returnChunk(theirs[j].mem_, theirs[j].size_);
+      }
+
+      int const next = (start + 1) % kMaxThreads;
+      PoolChunks passed;
+
+      for (size_t j = 0; j < mine.size(); ++j)
+      {
+         if (j % 2) passed.push_back(mine[j]);
+         else pool->returnChunk(mine[j].mem_, mine[j].size_);
+      }
+
+      lock(&handedOffMutex[next]);
+      handedOff[next].insert(handedOff[next].end(), passed.begin(), passed.end());
+      unlock(&handedOffMutex[next]);
+
+      badStamps[start] += bad;
+   }
+
+   finishThread(start);
+
+   if (*(int*)threadId != kMainThreadId)
+   {
+      pthread_exit(threadId);
+   }
+
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int testMemoryPool()
+{
+   pool = new CachingMemoryPool<int>(kPoolMagazineSize);
+   handedOff = new PoolChunks[kMaxThreads];
+   handedOffMutex = new Mutex[kMaxThreads];
+   badStamps = new int[kMaxThreads];
+   for (int j = 0; j < kMaxThreads; ++j)
+   {
+      pthread_mutex_init(&handedOffMutex[j], 0);
+      badStamps[j] = 0;
+   }
+
+   pthread_t *threads = new pthread_t[kMaxThreads];
+   int *threadId = new int[kMaxThreads];
+
+   //--------------------------------------------------------------------------
+   // Reset barrier variables before creating any threads. Otherwise, it is
+   // possible for the first thread
+   //--------------------------------------------------------------------------
+   threadsFinished.value() = 0;
+   threadsStarted.value() = 0;
+   startTimer = kStartingTime;
+   endTimer = 0;
+
+   for (int j = 0; j < kMaxThreads - 1; ++j)
+   {
+      threadId[j] = j;
+      pthread_create(&threads[j], NULL, MemoryPoolEntry, (void *)&threadId[j]);
+   }
+
+   int mainThreadId = kMaxThreads-1;
+   kMainThreadId = kMaxThreads-1;
+
+   MemoryPoolEntry((void*)&mainThreadId);
+
+   for (int j = 0; j < kMaxThreads - 1; ++j) pthread_join(threads[j], NULL);
+
+   int bad = 0;
+   for (int j = 0; j < kMaxThreads; ++j) bad += badStamps[j];
+
+   //--------------------------------------------------------------------------
+   // the chunks still handed off were taken by threads which have exited;
+   // they must still carry their stamps
+   //--------------------------------------------------------------------------
+   for (int j = 0; j < kMaxThreads; ++j)
+   {
+      unsigned char const stamp = (unsigned char)((j + kMaxThreads - 1) % kMaxThreads + 1);
+
+      for (size_t k = 0; k < handedOff[j].size(); ++k)
+      {
+         if (!stamped(handedOff[j][k], stamp)) ++bad;
+         pool->returnChunk(handedOff[j][k].mem_, handedOff[j][k].size_);
+      }
+   }
+
+   std::cout << "POOL: " << "THRD: " << kMaxThreads << "   ";
+   std::cout << "ROUNDS: " << kMaxInserts << "   ";
+   std::cout << "MAGAZINE: " << kPoolMagazineSize << "   ";
+   std::cout << "BAD: " << bad << std::endl;
+
+   if (0 != bad)
+   {
+      std::cout << "pool chunks shared or overwritten!" << std::endl;
+   }
+   else
+   {
+      std::cout << "All fine." << std::endl;
+   }
+
+   for (int j = 0; j < kMaxThreads; ++j) pthread_mutex_destroy(&handedOffMutex[j]);
+   delete [] handedOffMutex;
+   delete [] badStamps;
+   delete [] handedOff;
+   delete pool;
+   delete [] threads;
+   delete [] threadId;
+
+   return 0;
+}
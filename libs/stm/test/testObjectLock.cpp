@@ -0,0 +1,346 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <boost/stm.hpp>
+#include <atomic>
+#include <thread>
+#include "testObjectLock.h"
+#include "main.h"
+
+using namespace boost::stm;
+using namespace nMain;
+
+static int failures = 0;
+
+//-----------------------------------------------------------------------------
+// bound is bound to L, unbound is not. objects are only bound under tx
+// protection, so every tx here adds L to its conflicting set
+//-----------------------------------------------------------------------------
+static Mutex L = PTHREAD_MUTEX_INITIALIZER;
+
+static native_trans<int> bound;
+static native_trans<int> unbound;
+
+static int const kLockerLocks = 20;
+
+//-----------------------------------------------------------------------------
+// the state of the tx running on the helper thread
+//-----------------------------------------------------------------------------
+enum { kIdle, kInFlight, kEnd, kEnded };
+
+static std::atomic<int> otherState;
+static std::atomic<bool> otherCommitted;
+static std::atomic<bool> touchDone;
+static std::atomic<int> touchAttempts;
+static std::atomic<bool> lockerDone;
+static std::atomic<int> commits;
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void check(bool ok, char const *what)
+{
+   if (ok) return;
+
+   std::cout << "failed: DSTM_" << transaction::update_policy_string() << ": "
+      << what << std::endl;
+   ++failures;
+}
+
+//-----------------------------------------------------------------------------
+// an in-flight tx which wrote the object it is given and waits to be ended.
+// it also ends once it is forced to abort: a direct updating locker waits
+// for the txs it aborted to leave
+//-----------------------------------------------------------------------------
+static void* WriterTxEntry(void *obj)
+{
+   transaction::initialize_thread();
+
+   {
+      transaction t;
+      t.lock_conflict(&L);
+      ++t.w(*(native_trans<int>*)obj).value();
+
+      otherState = kInFlight;
+      while (kEnd != otherState && !t.forced_to_abort()) SLEEP(1);
+
+      t.no_throw_end();
+      otherCommitted = t.committed();
+   }
+
+   transaction::terminate_thread();
+   otherState = kEnded;
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// runs a writer tx on another thread until end() is called
+//-----------------------------------------------------------------------------
+class writer_tx
+{
+public:
+   explicit writer_tx(native_trans<int> &obj)
+   {
+      otherState = kIdle;
+      otherCommitted = false;
+      pthread_create(&thread_, NULL, WriterTxEntry, &obj);
+      while (kInFlight != otherState) SLEEP(1);
+   }
+
+   bool end()
+   {
+      otherState = kEnd;
+      pthread_join(thread_, NULL);
+      return otherCommitted;
+   }
+
+private:
+   pthread_t thread_;
+};
+
+//-----------------------------------------------------------------------------
+// a whole tx touching the object it is given, retried until it commits
+//-----------------------------------------------------------------------------
+static void* TouchEntry(void *obj)
+{
+   transaction::initialize_thread();
+
+   atomic(t)
+   {
+      ++touchAttempts;
+      t.lock_conflict(&L);
+      ++t.w(*(native_trans<int>*)obj).value();
+   } end_atom
+
+   touchDone = true;
+   transaction::terminate_thread();
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// true if a tx touching obj on another thread commits within waitMs
+//-----------------------------------------------------------------------------
+static bool touch_commits(pthread_t &thread, native_trans<int> &obj, int waitMs)
+{
+   touchDone = false;
+   touchAttempts = 0;
+   pthread_create(&thread, NULL, TouchEntry, &obj);
+
+   for (int i = 0; i < waitMs / 10 && !touchDone; ++i) SLEEP(10);
+   return touchDone;
+}
+
+static void join_touch(pthread_t &thread)
+{
+   for (int i = 0; i < 500 && !touchDone; ++i) SLEEP(10);
+   if (touchDone) pthread_join(thread, NULL);
+   else pthread_detach(thread);
+}
+
+//-----------------------------------------------------------------------------
+// the lock aborts the in-flight txs which wrote the bound object and leaves
+// the others running
+//-----------------------------------------------------------------------------
+static void testLockAbortsTouchers()
+{
+   {
+      writer_tx other(unbound);
+      transaction::pthread_lock(&L);
+      check(kInFlight == otherState, "lock disturbs a tx which left the objects alone");
+      transaction::pthread_unlock(&L);
+      check(other.end(), "lock aborts a tx which left the objects alone");
+   }
+
+   {
+      writer_tx other(bound);
+      transaction::pthread_lock(&L);
+      transaction::pthread_unlock(&L);
+      check(!other.end(), "lock leaves a tx which wrote a bound object running");
+   }
+}
+
+//-----------------------------------------------------------------------------
+// while the lock is held a tx touching a bound object waits for the unlock,
+// one touching only the other object does not
+//-----------------------------------------------------------------------------
+static void testHeldLockBlocksTouchers()
+{
+   int const boundBefore = bound.value();
+   int const unboundBefore = unbound.value();
+
+   transaction::pthread_lock(&L);
+
+   pthread_t toucher;
+   check(touch_commits(toucher, unbound, 5000), "held lock blocks a tx touching an unbound object");
+   join_touch(toucher);
+   check(1 == touchAttempts, "held lock aborts a tx touching an unbound object");
+
+   check(!touch_commits(toucher, bound, 100), "held lock lets a tx touch a bound object");
+
+   transaction::pthread_unlock(&L);
+   join_touch(toucher);
+
+   check(touchDone, "tx touching a bound object never commits after the unlock");
+   check(boundBefore + 1 == bound.value() && unboundBefore + 1 == unbound.value(),
+      "blocked txs lose their updates");
+}
+
+//-----------------------------------------------------------------------------
+// the other threads increment both objects in txs, for as long as the main
+// thread increments the bound one under the lock. an in-flight tx overlooked
+// by a locker, or one which touches the object while the lock is held, loses
+// updates
+//-----------------------------------------------------------------------------
+static void* ObjectLockEntry(void *threadId)
+{
+   transaction::initialize_thread();
+   int start = *(int*)threadId;
+
+   idleUntilAllThreadsHaveReached(start);
+
+   if (*(int*)threadId == kMainThreadId)
+   {
+      for (int i = 0; i < kLockerLocks; ++i)
+      {
+         transaction::pthread_lock(&L);
+         int const value = bound.value();
+         SLEEP(1);
+         bound.value() = value + 1;
+         transaction::pthread_unlock(&L);
+         SLEEP(1);
+      }
+
+      lockerDone = true;
+   }
+   else
+   {
+      for (int i = 0; i < kMaxInserts || !lockerDone; ++i)
+      {
+         atomic(t)
+         {
+            t.lock_conflict(&L);
+            ++t.w(unbound).value();
+            ++t.w(bound).value();
+            std::this_thread::yield();
+         } end_atom
+
+         ++commits;
+      }
+   }
+
+   finishThread(start);
+
+   if (*(int*)threadId != kMainThreadId)
+   {
+      transaction::terminate_thread();
+      pthread_exit(threadId);
+   }
+
+   return NULL;
+}
+
+static void testConcurrentLocker()
+{
+   bound.value() = 0;
+   unbound.value() = 0;
+   lockerDone = false;
+   commits = 0;
+
+   pthread_t *threads = new pthread_t[kMaxThreads];
+   int *threadId = new int[kMaxThreads];
+
+   //--------------------------------------------------------------------------
+   // Reset barrier variables before creating any threads. Otherwise, it is
+   // possible for the first thread
+   //--------------------------------------------------------------------------
+   threadsFinished.value() = 0;
+   threadsStarted.value() = 0;
+   startTimer = kStartingTime;
+   endTimer = 0;
+
+   for (int j = 0; j < kMaxThreads - 1; ++j)
+   {
+      threadId[j] = j;
+      pthread_create(&threads[j], NULL, ObjectLockEntry, (void *)&threadId[j]);
+   }
+
+   int mainThreadId = kMaxThreads-1;
+   kMainThreadId = kMaxThreads-1;
+
+   ObjectLockEntry((void*)&mainThreadId);
+
+   for (int j = 0; j < kMaxThreads - 1; ++j) pthread_join(threads[j], NULL);
+
+   int const txs = commits;
+   check(txs == unbound.value(), "txs lose updates of the unbound object");
+   check(txs + kLockerLocks == bound.value(), "locker and txs lose updates of the bound object");
+
+   delete [] threads;
+   delete [] threadId;
+}
+
+//-----------------------------------------------------------------------------
+// both update policies under tx protection, whatever the command line chose
+// is restored afterwards
+//-----------------------------------------------------------------------------
+int testObjectLock()
+{
+   transaction::initialize();
+   transaction::initialize_thread();
+
+   failures = 0;
+
+   bool const direct = transaction::direct_updating();
+   LatmType const latm = transaction::latm_protection();
+
+   transaction::do_tx_lock_protection();
+   transaction::add_lock_protected_object(&L, bound);
+
+   for (int policy = 0; policy < 2; ++policy)
+   {
+      if (0 == policy) transaction::do_deferred_updating();
+      else transaction::do_direct_updating();
+
+      testLockAbortsTouchers();
+      testHeldLockBlocksTouchers();
+      testConcurrentLocker();
+
+      std::cout << "OBJLOCK: DSTM_" << transaction::update_policy_string() << "   ";
+      std::cout << "THRD: " << kMaxThreads << "   ";
+      std::cout << "BOUND: " << bound.value() << "   ";
+      std::cout << "UNBOUND: " << unbound.value() << "   ";
+      std::cout << "FAILED: " << failures << std::endl;
+   }
+
+   transaction::clear_lock_protected_objects(&L);
+
+   if (direct) transaction::do_direct_updating();
+   else transaction::do_deferred_updating();
+
+   switch (latm)
+   {
+   case eFullLatmProtection: transaction::do_full_lock_protection(); break;
+   case eTmConflictingLockLatmProtection: transaction::do_tm_lock_protection(); break;
+   default: transaction::do_tx_lock_protection(); break;
+   }
+
+   if (0 != failures)
+   {
+      std::cout << failures << " object lock checks failed!" << std::endl;
+   }
+   else
+   {
+      std::cout << "All fine." << std::endl;
+   }
+
+   return 0;
+}
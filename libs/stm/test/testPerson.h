@@ -108,7 +108,7 @@ public:
       rhs.size_ = 0;
    }
 
-   named_array& operator=(named_array &&rhs)
+   named_array& operator=(named_array &&rhs) noexcept
    {
       using namespace std;
       //cout << "m=";
@@ -0,0 +1,166 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <boost/stm.hpp>
+#include <atomic>
+#include <thread>
+#include "testRetryBudget.h"
+#include "main.h"
+
+using namespace boost::stm;
+using namespace nMain;
+
+//-----------------------------------------------------------------------------
+// every transaction forces itself to abort until it is promoted, so it runs
+// out of its retry budget. its first irrevocable attempt then aborts too, and
+// the next restart must make it revocable and promote it again, waiting for
+// the other irrevocable transactions like the first time
+//-----------------------------------------------------------------------------
+static size_t const kRetryBudget = 3;
+
+static native_trans<int> counter;
+static std::atomic<int> irrevocableBodies;
+static std::atomic<int> overlaps;
+static std::atomic<int> earlyPromotions;
+
+//-----------------------------------------------------------------------------
+// counts the irrevocable attempts which overlap. it must not span anything
+// which may abort the attempt, the attempt would leave before it is counted
+// out
+//-----------------------------------------------------------------------------
+class irrevocable_body
+{
+public:
+   irrevocable_body() { if (1 != ++irrevocableBodies) ++overlaps; }
+   ~irrevocable_body() { --irrevocableBodies; }
+};
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void* RetryBudgetEntry(void *threadId)
+{
+   transaction::initialize_thread();
+   int start = *(int*)threadId;
+
+   idleUntilAllThreadsHaveReached(start);
+
+   for (int i = 0; i < kMaxInserts; ++i)
+   {
+      bool abortedIrrevocable = false;
+
+      atomic(t)
+      {
+         ++t.w(counter).value();
+
+         if (t.irrevocable())
+         {
+            irrevocable_body body;
+            if (t.consecutive_aborts() < kRetryBudget) ++earlyPromotions;
+            std::this_thread::yield();
+         }
+
+         if (!t.irrevocable()) t.force_to_abort();
+         else if (!abortedIrrevocable)
+         {
+            abortedIrrevocable = true;
+            t.lock_and_abort();
+         }
+      } end_atom
+   }
+
+   finishThread(start);
+
+   if (*(int*)threadId != kMainThreadId)
+   {
+      transaction::terminate_thread();
+      pthread_exit(threadId);
+   }
+
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int testRetryBudget()
+{
+   transaction::initialize();
+   transaction::initialize_thread();
+
+   size_t const budget = transaction::default_retry_budget();
+   transaction::set_default_retry_budget(kRetryBudget);
+
+   counter.value() = 0;
+   irrevocableBodies = 0;
+   overlaps = 0;
+   earlyPromotions = 0;
+
+   uint64 const promotionsBefore = transaction::bookkeeping().irrevocablePromotions();
+
+   pthread_t *threads = new pthread_t[kMaxThreads];
+   int *threadId = new int[kMaxThreads];
+
+   //--------------------------------------------------------------------------
+   // Reset barrier variables before creating any threads. Otherwise, it is
+   // possible for the first thread
+   //--------------------------------------------------------------------------
+   threadsFinished.value() = 0;
+   threadsStarted.value() = 0;
+   startTimer = kStartingTime;
+   endTimer = 0;
+
+   for (int j = 0; j < kMaxThreads - 1; ++j)
+   {
+      threadId[j] = j;
+      pthread_create(&threads[j], NULL, RetryBudgetEntry, (void *)&threadId[j]);
+   }
+
+   int mainThreadId = kMaxThreads-1;
+   kMainThreadId = kMaxThreads-1;
+
+   RetryBudgetEntry((void*)&mainThreadId);
+
+   for (int j = 0; j < kMaxThreads - 1; ++j) pthread_join(threads[j], NULL);
+
+   transaction::set_default_retry_budget(budget);
+
+   //--------------------------------------------------------------------------
+   // every transaction is promoted at least twice: once out of its budget and
+   // once after its irrevocable attempt aborted. a direct updating one is
+   // promoted again whenever its irrevocable attempt finds another writer
+   //--------------------------------------------------------------------------
+   int const expected = kMaxThreads * kMaxInserts;
+   uint64 const promotions = transaction::bookkeeping().irrevocablePromotions() - promotionsBefore;
+
+   std::cout << "RETRY: DSTM_" << transaction::update_policy_string() << "   ";
+   std::cout << "THRD: " << kMaxThreads << "   ";
+   std::cout << "BUDGET: " << kRetryBudget << "   ";
+   std::cout << "VALUE: " << counter.value() << "   ";
+   std::cout << "PROMOTED: " << promotions << "   ";
+   std::cout << "OVERLAPS: " << overlaps << std::endl;
+
+   if (expected != counter.value() || uint64(2 * expected) > promotions ||
+      0 != overlaps || 0 != earlyPromotions)
+   {
+      std::cout << "retry budget promotions wrong! expected " << expected
+         << " commits and " << 2 * expected << " promotions or more" << std::endl;
+   }
+   else
+   {
+      std::cout << "All fine." << std::endl;
+   }
+
+   delete [] threads;
+   delete [] threadId;
+
+   return 0;
+}
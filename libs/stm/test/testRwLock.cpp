@@ -0,0 +1,318 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <boost/stm.hpp>
+#include <atomic>
+#include "testRwLock.h"
+#include "main.h"
+
+using namespace boost::stm;
+using namespace nMain;
+
+static int failures = 0;
+
+static RwMutex rw = PTHREAD_RWLOCK_INITIALIZER;
+static native_trans<int> counter;
+static int guarded = 0;
+static std::atomic<bool> writerDone;
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void check(bool ok, char const *what)
+{
+   if (ok) return;
+
+   std::cout << "failed: DSTM_" << transaction::update_policy_string() << " "
+      << transaction::latm_protection_str() << ": " << what << std::endl;
+   ++failures;
+}
+
+//-----------------------------------------------------------------------------
+// true if nobody holds rw
+//-----------------------------------------------------------------------------
+static bool lock_is_free()
+{
+   if (0 != pthread_rwlock_trywrlock(&rw)) return false;
+   pthread_rwlock_unlock(&rw);
+   return true;
+}
+
+//-----------------------------------------------------------------------------
+// a tx of this thread which may take rw in every protection mode, and which
+// conflicts with its holds
+//-----------------------------------------------------------------------------
+static void conflict_with_lock(transaction &t)
+{
+   if (transaction::doing_tx_lock_protection()) t.lock_conflict(&rw);
+}
+
+//-----------------------------------------------------------------------------
+// a writing tx conflicting with rw, held up by any hold of rw left behind
+//-----------------------------------------------------------------------------
+static void* ConflictingWriterEntry(void *)
+{
+   transaction::initialize_thread();
+
+   atomic(t)
+   {
+      conflict_with_lock(t);
+      ++t.w(counter).value();
+   } end_atom
+
+   transaction::terminate_thread();
+   writerDone = true;
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// true if a conflicting writer on another thread commits within 5 seconds
+//-----------------------------------------------------------------------------
+static bool conflicting_writer_commits()
+{
+   writerDone = false;
+   pthread_t writer;
+   pthread_create(&writer, NULL, ConflictingWriterEntry, NULL);
+
+   for (int i = 0; i < 500 && !writerDone; ++i) SLEEP(10);
+
+   if (writerDone) pthread_join(writer, NULL);
+   else pthread_detach(writer);
+
+   return writerDone;
+}
+
+//-----------------------------------------------------------------------------
+// the first attempt of the tx aborts while it holds rw. the retry leaves rw
+// alone, an unlock there would hide a hold the abort kept
+//-----------------------------------------------------------------------------
+static void testAbortReleasesHold(bool shared, bool forced)
+{
+   int attempts = 0;
+
+   atomic(t)
+   {
+      conflict_with_lock(t);
+      ++t.w(counter).value();
+
+      if (1 == ++attempts)
+      {
+         if (shared) transaction::pthread_rdlock(&rw);
+         else transaction::pthread_wrlock(&rw);
+
+         if (forced) t.force_to_abort();
+         else t.lock_and_abort();
+      }
+   } end_atom
+
+   check(2 == attempts, "the tx holding the lock did not abort once");
+   check(lock_is_free(), shared ? "abort keeps the shared hold" : "abort keeps the exclusive hold");
+
+   //--------------------------------------------------------------------------
+   // the LATM state of the lock is gone too: the lock is taken again outside
+   // of a tx and the conflicting writers are not held up
+   //--------------------------------------------------------------------------
+   bool const locked = 0 == transaction::pthread_trywrlock(&rw);
+   check(locked, "lock busy after the abort");
+   if (locked) transaction::pthread_rwunlock(&rw);
+   check(conflicting_writer_commits(), "conflicting writer held up after the abort");
+}
+
+//-----------------------------------------------------------------------------
+// a hold unlocked inside the tx is not released again by the abort, which
+// would drop the read hold this thread took outside of the tx
+//-----------------------------------------------------------------------------
+static void testUnlockedHoldKept()
+{
+   int attempts = 0;
+
+   pthread_rwlock_rdlock(&rw);
+
+   atomic(t)
+   {
+      transaction::pthread_rdlock(&rw);
+      transaction::pthread_rwunlock(&rw);
+      ++t.w(counter).value();
+      if (1 == ++attempts) t.force_to_abort();
+   } end_atom
+
+   check(0 != pthread_rwlock_trywrlock(&rw), "abort releases a hold unlocked inside the tx");
+   pthread_rwlock_unlock(&rw);
+
+   check(lock_is_free(), "lock kept after the unlock");
+}
+
+//-----------------------------------------------------------------------------
+// readers take rw in txs whose first attempts are forced to abort while a
+// writer takes it outside of a tx, the writer gets through once per insert
+//-----------------------------------------------------------------------------
+static void* ReaderEntry(void *threadId)
+{
+   transaction::initialize_thread();
+   int start = *(int*)threadId;
+
+   idleUntilAllThreadsHaveReached(start);
+
+   for (int i = 0; i < kMaxInserts; ++i)
+   {
+      atomic(t)
+      {
+         conflict_with_lock(t);
+         transaction::pthread_rdlock(&rw);
+         t.read(counter);
+
+         if (0 == t.consecutive_aborts()) t.force_to_abort();
+         else transaction::pthread_rwunlock(&rw);
+      } end_atom
+   }
+
+   finishThread(start);
+
+   if (*(int*)threadId != kMainThreadId)
+   {
+      transaction::terminate_thread();
+      pthread_exit(threadId);
+   }
+
+   return NULL;
+}
+
+static void* LockWriterEntry(void *)
+{
+   transaction::initialize_thread();
+
+   for (int i = 0; i < kMaxInserts; ++i)
+   {
+      transaction::pthread_wrlock(&rw);
+      ++guarded;
+      transaction::pthread_rwunlock(&rw);
+   }
+
+   transaction::terminate_thread();
+   writerDone = true;
+   return NULL;
+}
+
+static void testReadersAbortingBesideWriter()
+{
+   guarded = 0;
+   writerDone = false;
+
+   pthread_t writer;
+   pthread_create(&writer, NULL, LockWriterEntry, NULL);
+
+   pthread_t *threads = new pthread_t[kMaxThreads];
+   int *threadId = new int[kMaxThreads];
+
+   //--------------------------------------------------------------------------
+   // Reset barrier variables before creating any threads. Otherwise, it is
+   // possible for the first thread
+   //--------------------------------------------------------------------------
+   threadsFinished.value() = 0;
+   threadsStarted.value() = 0;
+   startTimer = kStartingTime;
+   endTimer = 0;
+
+   for (int j = 0; j < kMaxThreads - 1; ++j)
+   {
+      threadId[j] = j;
+      pthread_create(&threads[j], NULL, ReaderEntry, (void *)&threadId[j]);
+   }
+
+   int mainThreadId = kMaxThreads-1;
+   kMainThreadId = kMaxThreads-1;
+
+   ReaderEntry((void*)&mainThreadId);
+
+   for (int j = 0; j < kMaxThreads - 1; ++j) pthread_join(threads[j], NULL);
+
+   for (int i = 0; i < 500 && !writerDone; ++i) SLEEP(10);
+   check(writerDone, "writer held up by the aborted readers");
+
+   if (writerDone) pthread_join(writer, NULL);
+   else pthread_detach(writer);
+
+   check(!writerDone || kMaxInserts == guarded, "writer lost updates");
+   check(!writerDone || lock_is_free(), "lock kept after the readers");
+
+   delete [] threads;
+   delete [] threadId;
+}
+
+//-----------------------------------------------------------------------------
+// every update policy with every protection mode, whatever the command line
+// chose is restored afterwards
+//-----------------------------------------------------------------------------
+int testRwLock()
+{
+   transaction::initialize();
+   transaction::initialize_thread();
+
+   failures = 0;
+   counter.value() = 0;
+
+   bool const direct = transaction::direct_updating();
+   LatmType const latm = transaction::latm_protection();
+
+   for (int policy = 0; policy < 2; ++policy)
+   {
+      if (0 == policy) transaction::do_deferred_updating();
+      else transaction::do_direct_updating();
+
+      for (int mode = kMinLatmType; mode < kMaxLatmType; ++mode)
+      {
+         switch (mode)
+         {
+         case eFullLatmProtection: transaction::do_full_lock_protection(); break;
+         case eTmConflictingLockLatmProtection:
+            transaction::do_tm_lock_protection();
+            transaction::tm_lock_conflict(&rw);
+            break;
+         default: transaction::do_tx_lock_protection(); break;
+         }
+
+         testAbortReleasesHold(true, true);
+         testAbortReleasesHold(true, false);
+         testAbortReleasesHold(false, false);
+         testUnlockedHoldKept();
+         if (0 == failures) testReadersAbortingBesideWriter();
+
+         transaction::clear_tm_conflicting_locks();
+
+         std::cout << "RWLOCK: DSTM_" << transaction::update_policy_string() << "   ";
+         std::cout << "LATM: " << transaction::latm_protection_str() << "   ";
+         std::cout << "THRD: " << kMaxThreads << "   ";
+         std::cout << "FAILED: " << failures << std::endl;
+      }
+   }
+
+   if (direct) transaction::do_direct_updating();
+   else transaction::do_deferred_updating();
+
+   switch (latm)
+   {
+   case eFullLatmProtection: transaction::do_full_lock_protection(); break;
+   case eTmConflictingLockLatmProtection: transaction::do_tm_lock_protection(); break;
+   default: transaction::do_tx_lock_protection(); break;
+   }
+
+   if (0 != failures)
+   {
+      std::cout << failures << " reader-writer lock checks failed!" << std::endl;
+   }
+   else
+   {
+      std::cout << "All fine." << std::endl;
+   }
+
+   return 0;
+}
@@ -0,0 +1,192 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <boost/stm.hpp>
+#include <atomic>
+#include <thread>
+#include "testSerialFallback.h"
+#include "main.h"
+
+using namespace boost::stm;
+using namespace nMain;
+
+//-----------------------------------------------------------------------------
+// the first attempt of every transaction forces itself to abort, so half of
+// the attempts abort and the fallback trips into serial mode as soon as it
+// samples. a switcher thread turns the fallback off a little after each trip
+// and on again, so serial mode ends many times while a serialized attempt is
+// in flight; the threads run for kSerialRunNs at least
+//-----------------------------------------------------------------------------
+static double const kSerialThreshold = 0.3;
+static uint64 const kSerialRunNs = 300 * 1000 * 1000;
+
+static std::atomic<bool> switching;
+static native_trans<int> counter;
+static std::atomic<int> commits;
+static std::atomic<int> bodies;
+static std::atomic<int> serialBodies;
+static std::atomic<int> overlaps;
+
+//-----------------------------------------------------------------------------
+// counts the attempts which overlap a serialized one. it must not span
+// anything which may abort the attempt, the attempt would leave before it
+// is counted out
+//-----------------------------------------------------------------------------
+class attempt_body
+{
+public:
+   explicit attempt_body(transaction const &t) : serialized_(t.serialized())
+   {
+      int const others = bodies++;
+      if (serialized_) ++serialBodies;
+
+      if (serialized_ ? 0 != others : 0 != serialBodies) ++overlaps;
+   }
+
+   ~attempt_body()
+   {
+      if (serialized_) --serialBodies;
+      --bodies;
+   }
+
+private:
+   bool serialized_;
+};
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void* SerialFallbackEntry(void *threadId)
+{
+   transaction::initialize_thread();
+   int start = *(int*)threadId;
+
+   idleUntilAllThreadsHaveReached(start);
+
+   uint64 const begin = trace_now();
+
+   for (int i = 0; i < kMaxInserts || trace_now() - begin < kSerialRunNs; ++i)
+   {
+      atomic(t)
+      {
+         ++t.w(counter).value();
+
+         {
+            attempt_body body(t);
+            std::this_thread::yield();
+         }
+
+         if (0 == t.consecutive_aborts()) t.force_to_abort();
+      } end_atom
+
+      ++commits;
+   }
+
+   finishThread(start);
+
+   if (*(int*)threadId != kMainThreadId)
+   {
+      transaction::terminate_thread();
+      pthread_exit(threadId);
+   }
+
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void* SerialSwitcherEntry(void *)
+{
+   while (switching)
+   {
+      transaction::enable_serial_fallback(kSerialThreshold);
+      while (switching && !transaction::serial_mode()) SLEEP(1);
+      SLEEP(5);
+      transaction::disable_serial_fallback();
+   }
+
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int testSerialFallback()
+{
+   transaction::initialize();
+   transaction::initialize_thread();
+
+   counter.value() = 0;
+   commits = 0;
+   bodies = 0;
+   serialBodies = 0;
+   overlaps = 0;
+
+   uint64 const tripsBefore = transaction::bookkeeping().serialFallbacks();
+   uint64 const serializedBefore = transaction::bookkeeping().serialized();
+
+   switching = true;
+   pthread_t switcher;
+   pthread_create(&switcher, NULL, SerialSwitcherEntry, NULL);
+
+   pthread_t *threads = new pthread_t[kMaxThreads];
+   int *threadId = new int[kMaxThreads];
+
+   //--------------------------------------------------------------------------
+   // Reset barrier variables before creating any threads. Otherwise, it is
+   // possible for the first thread
+   //--------------------------------------------------------------------------
+   threadsFinished.value() = 0;
+   threadsStarted.value() = 0;
+   startTimer = kStartingTime;
+   endTimer = 0;
+
+   for (int j = 0; j < kMaxThreads - 1; ++j)
+   {
+      threadId[j] = j;
+      pthread_create(&threads[j], NULL, SerialFallbackEntry, (void *)&threadId[j]);
+   }
+
+   int mainThreadId = kMaxThreads-1;
+   kMainThreadId = kMaxThreads-1;
+
+   SerialFallbackEntry((void*)&mainThreadId);
+
+   for (int j = 0; j < kMaxThreads - 1; ++j) pthread_join(threads[j], NULL);
+
+   switching = false;
+   pthread_join(switcher, NULL);
+
+   uint64 const trips = transaction::bookkeeping().serialFallbacks() - tripsBefore;
+   uint64 const serialized = transaction::bookkeeping().serialized() - serializedBefore;
+
+   std::cout << "SERIAL: DSTM_" << transaction::update_policy_string() << "   ";
+   std::cout << "THRD: " << kMaxThreads << "   ";
+   std::cout << "VALUE: " << counter.value() << "   ";
+   std::cout << "TRIPS: " << trips << "   ";
+   std::cout << "SERIALIZED: " << serialized << "   ";
+   std::cout << "OVERLAPS: " << overlaps << std::endl;
+
+   if (commits != counter.value() || 0 == trips || 0 == serialized || 0 != overlaps)
+   {
+      std::cout << "serial fallback wrong! expected " << commits
+         << " commits, serialized attempts and no overlaps" << std::endl;
+   }
+   else
+   {
+      std::cout << "All fine." << std::endl;
+   }
+
+   delete [] threads;
+   delete [] threadId;
+
+   return 0;
+}
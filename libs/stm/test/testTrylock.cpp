@@ -0,0 +1,276 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <boost/stm.hpp>
+#include <atomic>
+#include <errno.h>
+#include "testTrylock.h"
+#include "main.h"
+
+using namespace boost::stm;
+using namespace nMain;
+
+static int failures = 0;
+
+static Mutex L = PTHREAD_MUTEX_INITIALIZER;
+
+//-----------------------------------------------------------------------------
+// the state of the conflicting tx running on the helper thread
+//-----------------------------------------------------------------------------
+enum { kIdle, kInFlight, kEnd, kEnded };
+
+static std::atomic<int> otherState;
+static std::atomic<bool> otherCommitted;
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void check(bool ok, char const *what)
+{
+   if (ok) return;
+
+   std::cout << "failed: DSTM_" << transaction::update_policy_string() << " "
+      << transaction::latm_protection_str() << ": " << what << std::endl;
+   ++failures;
+}
+
+//-----------------------------------------------------------------------------
+// true if nobody holds L, pthread_mutex_trylock fails on a held mutex even
+// in the thread holding it
+//-----------------------------------------------------------------------------
+static bool lock_is_free()
+{
+   if (0 != pthread_mutex_trylock(&L)) return false;
+   pthread_mutex_unlock(&L);
+   return true;
+}
+
+//-----------------------------------------------------------------------------
+// a tx which conflicts with L in every protection mode: full protection
+// conflicts with every tx, L is a tm conflicting lock under tm protection
+// and the tx adds it to its own conflicting set under tx protection
+//-----------------------------------------------------------------------------
+static void* ConflictingTxEntry(void *irrevocable)
+{
+   transaction::initialize_thread();
+
+   {
+      transaction t;
+      if (transaction::doing_tx_lock_protection()) t.lock_conflict(&L);
+      if (0 != irrevocable) t.make_irrevocable();
+
+      otherState = kInFlight;
+      while (kEnd != otherState) SLEEP(1);
+
+      t.no_throw_end();
+      otherCommitted = t.committed();
+   }
+
+   transaction::terminate_thread();
+   otherState = kEnded;
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// runs a conflicting tx on another thread until end() is called
+//-----------------------------------------------------------------------------
+class conflicting_tx
+{
+public:
+   explicit conflicting_tx(bool irrevocable)
+   {
+      otherState = kIdle;
+      otherCommitted = false;
+      pthread_create(&thread_, NULL, ConflictingTxEntry, irrevocable ? (void*)1 : NULL);
+      while (kInFlight != otherState) SLEEP(1);
+   }
+
+   bool end()
+   {
+      otherState = kEnd;
+      pthread_join(thread_, NULL);
+      return otherCommitted;
+   }
+
+private:
+   pthread_t thread_;
+};
+
+//-----------------------------------------------------------------------------
+// a tx of this thread which may take L in every protection mode
+//-----------------------------------------------------------------------------
+static void allow_lock(transaction &t)
+{
+   if (transaction::doing_tx_lock_protection()) t.lock_conflict(&L);
+}
+
+//-----------------------------------------------------------------------------
+// trylock outside of a tx: busy if the lock is held or if a conflicting tx
+// may not be aborted, and a busy result leaves the lock and the txs alone.
+// a lock which has not waited may not abort a revocable tx either (see
+// allow_lock_to_abort_tx), so any conflicting tx keeps the trylock out
+//-----------------------------------------------------------------------------
+static void testOutsideTx()
+{
+   check(0 == transaction::pthread_trylock(&L), "trylock of a free lock");
+   check(!lock_is_free(), "trylock leaves the lock free");
+   transaction::pthread_unlock(&L);
+   check(lock_is_free(), "lock kept after the unlock");
+
+   pthread_mutex_lock(&L);
+   check(EBUSY == transaction::pthread_trylock(&L), "trylock of a held lock");
+   pthread_mutex_unlock(&L);
+
+   for (int irrevocable = 0; irrevocable < 2; ++irrevocable)
+   {
+      conflicting_tx other(0 != irrevocable);
+      check(EBUSY == transaction::pthread_trylock(&L), "trylock beside a conflicting tx");
+      check(lock_is_free(), "busy trylock keeps the lock");
+      check(other.end(), "busy trylock aborts the conflicting tx");
+   }
+}
+
+//-----------------------------------------------------------------------------
+// trylock inside of a tx: as outside, and a busy result leaves the tx of
+// this thread revocable so it still commits
+//-----------------------------------------------------------------------------
+static void testInsideTx()
+{
+   {
+      transaction t;
+      allow_lock(t);
+
+      pthread_mutex_lock(&L);
+      check(EBUSY == transaction::pthread_trylock(&L), "in-tx trylock of a held lock");
+      pthread_mutex_unlock(&L);
+
+      check(!t.irrevocable(), "busy in-tx trylock promotes the tx");
+      t.no_throw_end();
+      check(t.committed(), "tx aborted after a busy in-tx trylock");
+   }
+
+   {
+      conflicting_tx other(true);
+      transaction t;
+      allow_lock(t);
+
+      check(!t.try_make_irrevocable(), "try_make_irrevocable beside an irrevocable tx");
+      check(!t.try_make_isolated(), "try_make_isolated beside an irrevocable tx");
+      check(EBUSY == transaction::pthread_trylock(&L), "in-tx trylock beside an irrevocable tx");
+      check(!t.irrevocable(), "busy in-tx trylock promotes the tx");
+      check(lock_is_free(), "busy in-tx trylock keeps the lock");
+
+      check(other.end(), "busy in-tx trylock aborts the irrevocable tx");
+      t.no_throw_end();
+      check(t.committed(), "tx aborted after a busy in-tx trylock");
+   }
+
+   {
+      conflicting_tx other(false);
+      transaction t;
+      allow_lock(t);
+
+      check(0 == transaction::pthread_trylock(&L), "in-tx trylock beside a revocable tx");
+      check(transaction::doing_tx_lock_protection() ? t.irrevocable() : t.isolated(),
+         "in-tx trylock does not promote the tx");
+      transaction::pthread_unlock(&L);
+
+      t.no_throw_end();
+      check(t.committed(), "tx aborted after an in-tx trylock");
+      check(!other.end(), "in-tx trylock leaves the conflicting tx running");
+   }
+
+   check(lock_is_free(), "lock kept after the in-tx unlock");
+}
+
+//-----------------------------------------------------------------------------
+// try_make_irrevocable and try_make_isolated beside a revocable tx, beside an
+// irrevocable one they fail (see testInsideTx)
+//-----------------------------------------------------------------------------
+static void testTryMake()
+{
+   conflicting_tx other(false);
+   transaction t;
+
+   check(t.try_make_irrevocable() && t.irrevocable() && !t.isolated(),
+      "try_make_irrevocable beside a revocable tx");
+   check(t.try_make_isolated() && t.isolated(), "try_make_isolated beside a revocable tx");
+
+   t.no_throw_end();
+   check(t.committed(), "isolated tx aborted");
+   check(!other.end(), "try_make_isolated leaves the other tx running");
+}
+
+//-----------------------------------------------------------------------------
+// every update policy with every protection mode, whatever the command line
+// chose is restored afterwards
+//-----------------------------------------------------------------------------
+int testTrylock()
+{
+   transaction::initialize();
+   transaction::initialize_thread();
+
+   failures = 0;
+
+   bool const direct = transaction::direct_updating();
+   LatmType const latm = transaction::latm_protection();
+
+   for (int policy = 0; policy < 2; ++policy)
+   {
+      if (0 == policy) transaction::do_deferred_updating();
+      else transaction::do_direct_updating();
+
+      for (int mode = kMinLatmType; mode < kMaxLatmType; ++mode)
+      {
+         switch (mode)
+         {
+         case eFullLatmProtection: transaction::do_full_lock_protection(); break;
+         case eTmConflictingLockLatmProtection:
+            transaction::do_tm_lock_protection();
+            transaction::tm_lock_conflict(&L);
+            break;
+         default: transaction::do_tx_lock_protection(); break;
+         }
+
+         testOutsideTx();
+         testInsideTx();
+         testTryMake();
+
+         transaction::clear_tm_conflicting_locks();
+
+         std::cout << "TRYLOCK: DSTM_" << transaction::update_policy_string() << "   ";
+         std::cout << "LATM: " << transaction::latm_protection_str() << "   ";
+         std::cout << "FAILED: " << failures << std::endl;
+      }
+   }
+
+   if (direct) transaction::do_direct_updating();
+   else transaction::do_deferred_updating();
+
+   switch (latm)
+   {
+   case eFullLatmProtection: transaction::do_full_lock_protection(); break;
+   case eTmConflictingLockLatmProtection: transaction::do_tm_lock_protection(); break;
+   default: transaction::do_tx_lock_protection(); break;
+   }
+
+   if (0 != failures)
+   {
+      std::cout << failures << " trylock checks failed!" << std::endl;
+   }
+   else
+   {
+      std::cout << "All fine." << std::endl;
+   }
+
+   return 0;
+}
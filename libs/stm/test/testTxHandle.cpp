@@ -0,0 +1,144 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009. 
+// (C) Copyright Vicente J. Botet Escriba 2009. 
+// Distributed under the Boost
+// Software License, Version 1.0. 
+// (See accompanying file LICENSE_1_0.txt or 
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <boost/stm.hpp>
+#include <vector>
+#include "testTxHandle.h"
+#include "main.h"
+
+using namespace boost::stm;
+using namespace nMain;
+
+//-----------------------------------------------------------------------------
+// every cell of the matrix is incremented by each writer, so any reader which
+// sees cells that differ has seen a torn version
+//-----------------------------------------------------------------------------
+static int const kMatrixCells = 4096;
+
+typedef std::vector<int> Matrix;
+
+static tx_handle<Matrix> *matrix = NULL;
+static native_trans<int> tornReads;
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void* TxHandleEntry(void *threadId)
+{
+   transaction::initialize_thread();
+   int start = *(int*)threadId;
+
+   idleUntilAllThreadsHaveReached(start);
+
+   for (int i = 0; i < kMaxInserts; ++i)
+   {
+      atomic(t)
+      {
+         Matrix &m = matrix->write(t);
+         for (int j = 0; j < kMatrixCells; ++j) ++m[j];
+      } end_atom
+
+      atomic(t)
+      {
+         Matrix const &m = matrix->read(t);
+         for (int j = 1; j < kMatrixCells; ++j)
+         {
+            if (m[j] != m[0])
+            {
+               ++t.w(tornReads).value();
+               break;
+            }
+         }
+      } end_atom
+   }
+
+   finishThread(start);
+
+   if (*(int*)threadId != kMainThreadId)
+   {
+      transaction::terminate_thread();
+      pthread_exit(threadId);
+   }
+
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int testTxHandle()
+{
+   transaction::initialize();
+   transaction::initialize_thread();
+
+   matrix = new tx_handle<Matrix>(Matrix(kMatrixCells, 0));
+   tornReads.value() = 0;
+
+   pthread_t *threads = new pthread_t[kMaxThreads];
+   int *threadId = new int[kMaxThreads];
+
+   //--------------------------------------------------------------------------
+   // Reset barrier variables before creating any threads. Otherwise, it is
+   // possible for the first thread 
+   //--------------------------------------------------------------------------
+   threadsFinished.value() = 0;
+   threadsStarted.value() = 0;
+   startTimer = kStartingTime;
+   endTimer = 0;
+
+   for (int j = 0; j < kMaxThreads - 1; ++j)
+   {
+      threadId[j] = j;
+      pthread_create(&threads[j], NULL, TxHandleEntry, (void *)&threadId[j]);
+   }
+
+   int mainThreadId = kMaxThreads-1;
+   kMainThreadId = kMaxThreads-1;
+
+   TxHandleEntry((void*)&mainThreadId);
+
+   while (true)
+   {
+      if (threadsFinished.value() == kMaxThreads) break;
+      SLEEP(10);
+   }
+
+   int const expected = kMaxThreads * kMaxInserts;
+   Matrix const &m = matrix->unsafe_get();
+
+   bool lost = false;
+   for (int j = 0; j < kMatrixCells; ++j)
+   {
+      if (m[j] != expected) { lost = true; break; }
+   }
+
+   std::cout << "HANDLE: DSTM_" << transaction::update_policy_string() << "   ";
+   std::cout << "THRD: " << kMaxThreads << "   ";
+   std::cout << "CELLS: " << kMatrixCells << "   ";
+   std::cout << "VALUE: " << m[0] << "   ";
+   std::cout << "TORN: " << tornReads.value() << std::endl;
+   std::cout << transaction::bookkeeping() << std::endl;
+
+   if (lost || 0 != tornReads.value())
+   {
+      std::cout << "tx_handle updates lost or torn! expected " << expected << std::endl;
+   }
+   else
+   {
+      std::cout << "All fine." << std::endl;
+   }
+
+   delete matrix;
+   delete [] threads;
+   delete [] threadId;
+
+   return 0;
+}
@@ -0,0 +1,197 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// (C) Copyright Justin E. Gottchlich 2009.
+// (C) Copyright Vicente J. Botet Escriba 2009.
+// Distributed under the Boost
+// Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or
+// copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://www.boost.org/libs/synchro for documentation.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+//-----------------------------------------------------------------------------
+// stm_trace_decode - turns the binary N.stmtrace files written by threads
+// running with transaction::enable_tracing() into text or CSV.
+//
+//    stm_trace_decode [-csv] <file.stmtrace> ...
+//
+// times are printed in nanoseconds relative to the earliest event of all the
+// files given, so traces of the threads of one run line up.
+//-----------------------------------------------------------------------------
+#include <boost/stm/detail/tx_trace.hpp>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace boost::stm;
+
+//-----------------------------------------------------------------------------
+struct trace_file
+{
+   string name_;
+   trace_file_header header_;
+   vector<trace_record> records_;
+};
+
+//-----------------------------------------------------------------------------
+static char const * event_name(uint8_t event)
+{
+   switch (event)
+   {
+   case eTraceBegin: return "begin";
+   case eTraceCommit: return "commit";
+   case eTraceAbort: return "abort";
+   default: return "unknown";
+   }
+}
+
+//-----------------------------------------------------------------------------
+static char const * reason_name(uint8_t reason)
+{
+   switch (reason)
+   {
+   case eTraceNoReason: return "";
+   case eTraceAbortSelf: return "self";
+   case eTraceAbortForced: return "forced";
+   case eTraceAbortInvalidRead: return "invalid_read";
+   case eTraceAbortInvalidWrite: return "invalid_write";
+   case eTraceAbortCmDenied: return "cm_denied";
+   default: return "unknown";
+   }
+}
+
+//-----------------------------------------------------------------------------
+static bool read_trace(char const *name, trace_file &file)
+{
+   FILE *in = fopen(name, "rb");
+   if (0 == in)
+   {
+      cerr << name << ": cannot open" << endl;
+      return false;
+   }
+
+   file.name_ = name;
+
+   bool ok = 1 == fread(&file.header_, sizeof(file.header_), 1, in)
+      && 0 == memcmp(file.header_.magic_, kTraceFileMagic, sizeof(kTraceFileMagic));
+
+   if (!ok) cerr << name << ": not a trace file" << endl;
+   else if (kTraceFileVersion != file.header_.version_ ||
+      sizeof(trace_record) != file.header_.recordSize_)
+   {
+      cerr << name << ": unsupported trace version " << file.header_.version_ << endl;
+      ok = false;
+   }
+
+   if (ok)
+   {
+      file.records_.resize((size_t)file.header_.kept_);
+
+      if (!file.records_.empty() && file.records_.size() !=
+         fread(&file.records_[0], sizeof(trace_record), file.records_.size(), in))
+      {
+         cerr << name << ": truncated trace" << endl;
+         ok = false;
+      }
+   }
+
+   fclose(in);
+   return ok;
+}
+
+//-----------------------------------------------------------------------------
+static void output_text(trace_file const &file, uint64_t origin)
+{
+   size_t begins = 0, commits = 0, aborts = 0;
+
+   cout << "thread " << file.header_.threadId_ << " (" << file.name_ << "): "
+        << file.header_.recorded_ << " events, " << file.header_.kept_ << " kept" << endl;
+
+   for (size_t i = 0; i < file.records_.size(); ++i)
+   {
+      trace_record const &r = file.records_[i];
+
+      cout << setw(14) << r.time_ - origin << "  " << setw(6) << left
+           << event_name(r.event_) << right;
+
+      if (eTraceBegin != r.event_)
+      {
+         cout << "  R " << setw(6) << r.reads_ << "  W " << setw(6) << r.writes_;
+      }
+      if (eTraceAbort == r.event_) cout << "  " << reason_name(r.reason_);
+      cout << endl;
+
+      if (eTraceBegin == r.event_) ++begins;
+      else if (eTraceCommit == r.event_) ++commits;
+      else if (eTraceAbort == r.event_) ++aborts;
+   }
+
+   cout << "begins: " << begins << "  commits: " << commits
+        << "  aborts: " << aborts << endl << endl;
+}
+
+//-----------------------------------------------------------------------------
+static void output_csv(trace_file const &file, uint64_t origin)
+{
+   for (size_t i = 0; i < file.records_.size(); ++i)
+   {
+      trace_record const &r = file.records_[i];
+
+      cout << file.header_.threadId_ << "," << i << "," << r.time_ - origin << ","
+           << event_name(r.event_) << "," << r.reads_ << "," << r.writes_ << ","
+           << reason_name(r.reason_) << endl;
+   }
+}
+
+//-----------------------------------------------------------------------------
+static void usage()
+{
+   cout << "usage: stm_trace_decode [-csv] <file.stmtrace> ..." << endl;
+}
+
+//-----------------------------------------------------------------------------
+// main
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+   bool csv = false;
+   vector<trace_file> files;
+
+   for (int i = 1; i < argc; ++i)
+   {
+      string arg = argv[i];
+
+      if (arg == "-csv") csv = true;
+      else if (arg == "-h") { usage(); return 0; }
+      else
+      {
+         files.push_back(trace_file());
+         if (!read_trace(argv[i], files.back())) return 1;
+      }
+   }
+
+   if (files.empty()) { usage(); return 1; }
+
+   uint64_t origin = ~uint64_t(0);
+   for (size_t i = 0; i < files.size(); ++i)
+   {
+      if (!files[i].records_.empty() && files[i].records_[0].time_ < origin)
+      {
+         origin = files[i].records_[0].time_;
+      }
+   }
+
+   if (csv) cout << "thread,seq,time_ns,event,reads,writes,abort_reason" << endl;
+
+   for (size_t i = 0; i < files.size(); ++i)
+   {
+      if (csv) output_csv(files[i], origin);
+      else output_text(files[i], origin);
+   }
+
+   return 0;
+}